@@ -1,19 +1,39 @@
 #include <Arduino.h>
-#include <Wire.h>
+#include "hardware/sync.h"
+
+#include "i2c_bus.hpp"
 #include "cap1206.hpp"
 
 const int CAP1206_TRANSFER_FAIL = -1;
 const int CAP1206_TRANSFER_SUCCESS = 0;
 
-uint8_t defaultThresholds[] = {50, 50, 50, 50, 10, 10};
+uint8_t defaultThresholds[] = {50, 50, 50, 50, 10, 10}; // Starting point, the pads in use are tuned from their noise once running
+
+const uint32_t CAP1206_MAX_CLOCK = 400000; // Fastest bus clock supported (fast mode)
+const uint8_t CAP1206_PRODUCT_ID = 0x67;
+
+Cap1206* Cap1206::alertOwner = nullptr;
 
 /**
  * \brief Construct a new CAP1206 object
  * 
- * \param bus I2C bus to find the sensor on
+ * \param i2c Manager of the I2C bus to find the sensor on
+ * \param alert Pin connected to the ALERT output of the sensor, negative if not connected (sensor is polled)
  */
-Cap1206::Cap1206(TwoWire* bus) {
-    interface = bus;
+Cap1206::Cap1206(I2CBusManager* i2c, int alert) {
+    bus = i2c;
+    alertPin = alert;
+
+    // Configuration registers that hold what is written to them
+    // Main control and calibration activation are left out since the chip changes them
+    shadow.track(RegistersCap1206::SENS_CTRL, RegistersCap1206::AVE_SAMP_CONF);
+    shadow.track(RegistersCap1206::INT_EN, RegistersCap1206::REPEAT_RATE_EN);
+    shadow.track(RegistersCap1206::MUL_TOUCH_CONF, RegistersCap1206::MUL_TOUCH_PATT_CONF);
+    shadow.track(RegistersCap1206::MUL_TOUCH_PATT, RegistersCap1206::MUL_TOUCH_PATT);
+    shadow.track(RegistersCap1206::RECAL_CONF, RegistersCap1206::SENS_THRS_6);
+    shadow.track(RegistersCap1206::SENS_NOISE_THRS, RegistersCap1206::SENS_NOISE_THRS);
+    shadow.track(RegistersCap1206::STBY_CHL, RegistersCap1206::CONFIG_2);
+    shadow.track(RegistersCap1206::PWR_BUT, RegistersCap1206::PWR_BUT_CONF);
 }
 
 /**
@@ -24,14 +44,16 @@ Cap1206::Cap1206(TwoWire* bus) {
  * \return Return status of the transfer 
  */
 int Cap1206::writeSingleReg(RegistersCap1206 reg, uint8_t val) {
-    uint8_t count = 0;
+    // Configuration goes through the shadow to skip writes that wouldn't change anything
+    if (shadow.tracks(reg)) {
+        shadow.stage(reg, val);
+        if (batchConfig) return CAP1206_TRANSFER_SUCCESS;
+        return flushConfig();
+    }
 
-    interface->beginTransmission(ADDRESS_CAP); 
-    count = interface->write(reg);
-    count = count + interface->write(val);
+    uint8_t data[] = {reg, val};
 
-    // Check if both fields were communicated correctly
-    if ((count == 2) && (interface->endTransmission() == 0)) return CAP1206_TRANSFER_SUCCESS;
+    if (bus->write(busDevice, data, 2, PriorityI2C::PRIO_INTERACTIVE) == I2C_BUS_SUCCESS) return CAP1206_TRANSFER_SUCCESS;
     return CAP1206_TRANSFER_FAIL;
 }
 
@@ -59,23 +81,12 @@ int Cap1206::readSingleReg(RegistersCap1206 reg, uint8_t* tar) {
  * \return Return status of the transfer 
  */
 int Cap1206::readManyRegs(RegistersCap1206 reg, uint8_t num, uint8_t* tar) {
-    uint8_t count = 0;
-
-    // Send address, then draw data
-    interface->beginTransmission(ADDRESS_CAP); 
-    count = interface->write(reg);
-    if ((interface->endTransmission(false) != 0) || (count != 1)) return CAP1206_TRANSFER_FAIL; 
-    // End message but not with stop
+    uint8_t addr = reg;
 
-    interface->beginTransmission(ADDRESS_CAP); 
-    count = interface->requestFrom(ADDRESS_CAP, num);
-    if ((interface->endTransmission() != 0) || (count != num)) return CAP1206_TRANSFER_FAIL;
-
-    // Copy if all data was communicated correctly
-    for (uint_fast8_t i = 0; i < num; i++) {
-        tar[i] = interface->read();
-    }
-    return CAP1206_TRANSFER_SUCCESS;
+    // Send address, then draw data after a repeated start
+    if (bus->writeRead(busDevice, &addr, 1, tar, num, PriorityI2C::PRIO_INTERACTIVE) == I2C_BUS_SUCCESS) 
+        return CAP1206_TRANSFER_SUCCESS;
+    return CAP1206_TRANSFER_FAIL;
 }
 
 /**
@@ -207,25 +218,205 @@ int Cap1206::readSensors(bool target[]) {
  * \return Return status of the transfer 
  */
 int Cap1206::readSensors(uint8_t* target) {
+    uint8_t status[4]; // Main control through sensor input
 
-    // Checks if an interrupt for input was raised
-    bool interruptFound = false;
-    if (checkInterrupt(&interruptFound) != CAP1206_TRANSFER_SUCCESS) return CAP1206_TRANSFER_FAIL;
+    // Get the interrupt flag and the inputs together in one burst
+    if (readManyRegs(RegistersCap1206::MAIN_CTRL, 4, status) != CAP1206_TRANSFER_SUCCESS) return CAP1206_TRANSFER_FAIL;
     
-    // If there's no interrupt then no input to process
-    if (interruptFound == false) *target = 0;
-    else {
-        if(readSingleReg(RegistersCap1206::SENSOR_INPUT, target) != CAP1206_TRANSFER_SUCCESS) 
-            return CAP1206_TRANSFER_FAIL;
-    }
+    // Inputs stay set while held, they are only updated for a release once the interrupt is cleared
+    *target = status[RegistersCap1206::SENSOR_INPUT - RegistersCap1206::MAIN_CTRL];
 
     // if (*target != 0) SerialUSB.println(*target, BIN); // Output which button is pressed
 
+    // If there's no interrupt then nothing changed, and nothing to clear
+    if ((status[0] & 0x01) == 0) return CAP1206_TRANSFER_SUCCESS;
+
     // Need to clear interrupt to reset button states for next check
     // Needed to not register releases
     return clearInterrupt();
 }
 
+/**
+ * \brief Queues the asynchronous transaction for the next step of reading the sensors
+ * 
+ * \param step Step of the sensor read to perform
+ * \return Return status of the queuing
+ */
+int Cap1206::submitSensorStep(AsyncStepCap1206 step) {
+    asyncStep = step;
+
+    asyncTransaction.device = busDevice;
+    asyncTransaction.writeData = asyncTx;
+    asyncTransaction.callback = asyncSensorStep;
+    asyncTransaction.context = this;
+
+    switch (step) {
+    case AsyncStepCap1206::READ_STATUS:
+        // Interrupt flag and inputs in one burst
+        asyncTx[0] = RegistersCap1206::MAIN_CTRL;
+        asyncTransaction.readData = asyncStatusRegs;
+        asyncTransaction.writeLength = 1;
+        asyncTransaction.readLength = 4;
+        break;
+    default: // Clearing the interrupt, respecting the sleep states like `clearInterrupt`
+        asyncTx[0] = RegistersCap1206::MAIN_CTRL;
+        asyncTx[1] = 0;
+        if (standbyEn == true) asyncTx[1] |= 0x20;
+        if (deepSleepEn == true) asyncTx[1] |= 0x10;
+        asyncTransaction.writeLength = 2;
+        asyncTransaction.readLength = 0;
+        break;
+    }
+
+    if (bus->submit(&asyncTransaction, PriorityI2C::PRIO_INTERACTIVE) == I2C_BUS_SUCCESS) return CAP1206_TRANSFER_SUCCESS;
+    return CAP1206_TRANSFER_FAIL;
+}
+
+/**
+ * \brief Advances the asynchronous sensor read once a step completes
+ * 
+ * \param trans Completed transaction, context is the sensor
+ * 
+ * \note Run from interrupt
+ */
+void Cap1206::asyncSensorStep(I2CTransaction* trans) {
+    Cap1206* sensor = (Cap1206*)trans->context;
+    AsyncStepCap1206 next = AsyncStepCap1206::CLEAR_INTERRUPT;
+
+    if (trans->status != I2C_TRANSPORT_SUCCESS) {
+        *(sensor->asyncTarget) = 0;
+        sensor->asyncResult = CAP1206_TRANSFER_FAIL;
+        sensor->asyncActive = false;
+        return;
+    }
+
+    switch (sensor->asyncStep) {
+    case AsyncStepCap1206::READ_STATUS:
+        *(sensor->asyncTarget) = sensor->asyncStatusRegs[RegistersCap1206::SENSOR_INPUT - RegistersCap1206::MAIN_CTRL];
+
+        // If there's no interrupt then nothing changed, and nothing to clear
+        if ((sensor->asyncStatusRegs[0] & 0x01) == 0) {
+            sensor->asyncResult = CAP1206_TRANSFER_SUCCESS;
+            sensor->asyncActive = false;
+            return;
+        }
+        break;
+    default: // Interrupt cleared, done
+        sensor->asyncResult = CAP1206_TRANSFER_SUCCESS;
+        sensor->asyncActive = false;
+        return;
+    }
+
+    if (sensor->submitSensorStep(next) == CAP1206_TRANSFER_FAIL) {
+        *(sensor->asyncTarget) = 0;
+        sensor->asyncResult = CAP1206_TRANSFER_FAIL;
+        sensor->asyncActive = false;
+    }
+}
+
+/**
+ * \brief Starts reading the sensor state register value without waiting for it
+ * 
+ * \param target Location to record state to, must remain valid until the read is complete
+ * 
+ * \note Performs the same transfers as the blocking `readSensors`
+ * \note Fails if a previous asynchronous read is still in progress, including one started by the ALERT pin
+ * \return Return status of the queuing, use `asyncBusy` and `asyncStatus` to follow the transfer
+ */
+int Cap1206::readSensorsAsync(uint8_t* target) {
+    // Can be called from the ALERT interrupt as well, claim the read with interrupts off
+    uint32_t interruptState = save_and_disable_interrupts();
+    if (asyncActive) {
+        restore_interrupts(interruptState);
+        return CAP1206_TRANSFER_FAIL;
+    }
+    asyncActive = true;
+    restore_interrupts(interruptState);
+
+    asyncTarget = target;
+    if (submitSensorStep(AsyncStepCap1206::READ_STATUS) == CAP1206_TRANSFER_SUCCESS) return CAP1206_TRANSFER_SUCCESS;
+
+    asyncActive = false;
+    return CAP1206_TRANSFER_FAIL;
+}
+
+/**
+ * \brief Checks if an asynchronous read is still in progress
+ */
+bool Cap1206::asyncBusy() {
+    return asyncActive;
+}
+
+/**
+ * \brief Result of the last asynchronous read
+ * 
+ * \note Only meaningful once `asyncBusy` returns false
+ * \return Return status of the transfers 
+ */
+int Cap1206::asyncStatus() {
+    return asyncResult;
+}
+
+/**
+ * \brief Starts reading the sensors whenever the ALERT pin is asserted
+ * 
+ * \note The ALERT output is active low and open drain by default
+ * \return Return status of the set up, fails if there's no pin
+ */
+int Cap1206::enableAlert() {
+    if (alertPin < 0) return CAP1206_TRANSFER_FAIL;
+
+    alertOwner = this;
+    pinMode(alertPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(alertPin), alertHandler, FALLING);
+    alertAttached = true;
+
+    return CAP1206_TRANSFER_SUCCESS;
+}
+
+/**
+ * \brief Queues a sensor read when the ALERT pin is asserted
+ * 
+ * \note Run from interrupt
+ */
+void Cap1206::alertHandler() {
+    Cap1206* sensor = alertOwner;
+    if (sensor == nullptr) return;
+
+    // A read already in progress will see the interrupt flag, `serviceAlert` catches any still left
+    if (sensor->readSensorsAsync(&(sensor->alertPads)) == CAP1206_TRANSFER_SUCCESS) sensor->alertReading = true;
+}
+
+/**
+ * \brief Checks if touches are read on the ALERT pin rather than by polling
+ */
+bool Cap1206::alertEnabled() {
+    return alertAttached;
+}
+
+/**
+ * \brief Collects a sensor read started by the ALERT pin
+ * 
+ * \param target Location to record the touched sensors to
+ * 
+ * \note Restarts a read if the pin is still asserted without one in progress, as an edge can be missed 
+ * \note (asserted before the interrupt was attached, or a failed read leaving the interrupt flagged)
+ * \return True if a read completed successfully since the last call
+ */
+bool Cap1206::serviceAlert(uint8_t* target) {
+    if (!alertAttached) return false;
+
+    if (alertReading && !asyncActive) {
+        alertReading = false;
+        if (asyncResult != CAP1206_TRANSFER_SUCCESS) return false;
+        *target = alertPads;
+        return true;
+    }
+
+    if (!asyncActive && (digitalRead(alertPin) == LOW)) alertHandler();
+    return false;
+}
+
 /**
  * \brief Reads noise flag states to an array
  * 
@@ -593,6 +784,16 @@ int Cap1206::readDelta(int8_t* target, uint8_t but) {
     }
 }
 
+/**
+ * \brief Reads the delta counts of all buttons in one burst
+ * 
+ * \param target Array of six to record the deltas in
+ * \return Return status of the transfer 
+ */
+int Cap1206::readDeltas(int8_t target[]) {
+    return readManyRegs(RegistersCap1206::DELTA_1, 6, (uint8_t*) target);
+}
+
 /**
  * \brief Set the multiple touch detection configuration
  * 
@@ -631,23 +832,81 @@ int Cap1206::setMultiTouchConfig(bool en, uint8_t blockNum) {
  * \return Return status of the transfer 
  */
 int Cap1206::setButtonThresholds(uint8_t thres[]) {
-    uint8_t count = 0;
-
-    interface->beginTransmission(ADDRESS_CAP);
-    // Use a sequential (block) write to update them quickly starting at button 1
-    count = interface->write(RegistersCap1206::SENS_THRS_1);
-
+    // Changed thresholds are sent with a sequential (block) write
     for (uint_fast8_t i = 0; i < 6; i++) {
         if (thres[i] > 127) thres[i] = 127;
-        count = count + interface->write(thres[i]);
+        shadow.stage(RegistersCap1206::SENS_THRS_1 + i, thres[i]);
     }
-    interface->endTransmission();
 
-    // Check if all the data was communicated correctly
-    if ((count == 7) && (interface->endTransmission() == 0)) return CAP1206_TRANSFER_SUCCESS;
+    if (batchConfig) return CAP1206_TRANSFER_SUCCESS;
+    return flushConfig();
+}
+
+/**
+ * \brief Returns the threshold last set for a button
+ * 
+ * \param but Button index of interest
+ * \note Buttons are indexed from 0 in this code but the data sheet starts at 1
+ * \return Threshold of the button, taken from the record of the configuration so no transfer is made
+ */
+uint8_t Cap1206::getButtonThreshold(uint8_t but) {
+    if (but > 5) but = 0; // Default to button 1, like setting a threshold
+    return shadow.get(RegistersCap1206::SENS_THRS_1 + but);
+}
+
+/**
+ * \brief Holds configuration writes so changes from several calls are sent together by `endConfigBatch`
+ * 
+ * \note Configuration calls return success while held, the result of sending them comes from `endConfigBatch`
+ * \note Writes that trigger actions (main control, calibration) are not held
+ */
+void Cap1206::beginConfigBatch() {
+    batchConfig = true;
+}
+
+/**
+ * \brief Sends all configuration changes held since `beginConfigBatch`
+ * 
+ * \return Return status of the transfers 
+ */
+int Cap1206::endConfigBatch() {
+    batchConfig = false;
+    return flushConfig();
+}
+
+/**
+ * \brief Writes the changed configuration registers
+ * 
+ * \return Return status of the transfers 
+ */
+int Cap1206::flushConfig() {
+    if (shadow.flush(bus, busDevice, PriorityI2C::PRIO_INTERACTIVE) == SHADOW_TRANSFER_SUCCESS) return CAP1206_TRANSFER_SUCCESS;
     return CAP1206_TRANSFER_FAIL;
 }
 
+/**
+ * \brief Rebuilds the record of the configuration registers by reading them from the chip
+ * 
+ * \note Use after the chip may have been reset, otherwise all configuration is sent again on the next change
+ * \return Return status of the transfers 
+ */
+int Cap1206::resyncShadow() {
+    uint8_t block[RegistersCap1206::CONFIG_2 - RegistersCap1206::SENS_CTRL + 1];
+    uint8_t power[2];
+
+    shadow.invalidate();
+
+    // Untracked registers in the blocks are ignored by the shadow
+    if (readManyRegs(RegistersCap1206::SENS_CTRL, sizeof(block), block) == CAP1206_TRANSFER_FAIL) 
+        return CAP1206_TRANSFER_FAIL;
+    for (uint_fast8_t i = 0; i < sizeof(block); i++) shadow.setKnown(RegistersCap1206::SENS_CTRL + i, block[i]);
+
+    if (readManyRegs(RegistersCap1206::PWR_BUT, 2, power) == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
+    for (uint_fast8_t i = 0; i < 2; i++) shadow.setKnown(RegistersCap1206::PWR_BUT + i, power[i]);
+
+    return CAP1206_TRANSFER_SUCCESS;
+}
+
 /**
  * \brief Reads the ID from the CAP1206 chip
  * 
@@ -678,6 +937,26 @@ int Cap1206::readRevision(uint8_t* rev) {
     return readSingleReg(RegistersCap1206::REV, rev);
 }
 
+/**
+ * \brief Finds the fastest bus clock the sensor reliably works at
+ * 
+ * \note Probes by reading back the product ID
+ * \return Return status of the negotiation
+ */
+int Cap1206::negotiateClock() {
+    uint8_t reg = RegistersCap1206::PROD_ID;
+    uint8_t id = 0;
+    I2CTransaction probe;
+
+    probe.writeData = &reg;
+    probe.writeLength = 1;
+    probe.readData = &id;
+    probe.readLength = 1;
+
+    if (bus->negotiateClock(busDevice, &probe, &CAP1206_PRODUCT_ID) == I2C_BUS_SUCCESS) return CAP1206_TRANSFER_SUCCESS;
+    return CAP1206_TRANSFER_FAIL;
+}
+
 /**
  * \brief Initializes the CAP1206 sensor
  * 
@@ -685,8 +964,13 @@ int Cap1206::readRevision(uint8_t* rev) {
  */
 int Cap1206::initialize() {
 
-    interface->begin(); // Begin I2C bus
-    interface->setClock(400000);
+    // Bus itself is started by its manager
+    busDevice = bus->registerDevice(ADDRESS_CAP, "CAP1206", CAP1206_MAX_CLOCK);
+    if (busDevice == I2CBusManager::NO_DEVICE) return CAP1206_TRANSFER_FAIL;
+    if (negotiateClock() == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
+
+    // Start from what's in the chip so settings that survived a reboot of the microcontroller aren't resent
+    if (resyncShadow() == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
 
     // The initial configuration is largely chip defaults
 
@@ -694,6 +978,9 @@ int Cap1206::initialize() {
                        false,   // Put chip into deep sleep
                        true)    // Clear interrupt flag
                        == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
+
+    // Configuration is collected and sent in as few writes as possible
+    beginConfigBatch();
     if (setSensitivity(DeltaSensitivityCap1206::MUL_002, 
                        BaseShiftCap1206::SCALE_256) 
                        == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
@@ -708,7 +995,7 @@ int Cap1206::initialize() {
                    false,   // Show noise flag only for RF noise
                    false,   // Disable RF noise detection
                    false,   // Analog calibration failure interrupt
-                   false)   // Interupt on button release
+                   true)    // Interupt on button release, so held inputs are updated once released
                    == CAP1206_TRANSFER_FAIL)
         return CAP1206_TRANSFER_FAIL;
     
@@ -727,9 +1014,6 @@ int Cap1206::initialize() {
                               == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
     if (setSensorInputNoiseThreshold(SensNoiseThrsCap1206::PER_375) == CAP1206_TRANSFER_FAIL)
         return CAP1206_TRANSFER_FAIL;
-    
-    // Calibrate all sensors on start
-    if (setCalibrations((uint8_t)(0x0F)) == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL; 
     if (enableInterrupt((uint8_t)(0x0F)) == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
     if (setRecalConfig(false,   // Set all threshold by writing to sensor one threshold
                        false,   // Clear intermediate data if noise detected
@@ -741,6 +1025,16 @@ int Cap1206::initialize() {
     
     // Currently disabling multiple touch detection and blocking
     if (setMultiTouchConfig(true, 1) == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
+
+    if (endConfigBatch() == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
+
+    // Calibrate all sensors on start, once configured
+    if (setCalibrations((uint8_t)(0x0F)) == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL; 
+
+    // Stops the need to poll if the ALERT pin is connected
+    if (alertPin >= 0) {
+        if (enableAlert() == CAP1206_TRANSFER_FAIL) return CAP1206_TRANSFER_FAIL;
+    }
     
     return CAP1206_TRANSFER_SUCCESS;
 }
\ No newline at end of file
@@ -2,7 +2,9 @@
 #define CAP1206_HEADER
 
 #include <Arduino.h>
-#include <Wire.h>
+
+#include "i2c_bus.hpp"
+#include "register_shadow.hpp"
 
 /* Bare-bones library for the CAP1206 sensor
     Definitely needs some work to polish up and complete to cover all the 
@@ -14,7 +16,13 @@
     - Standby
     - Power Button
     - Reading back some values related to configuration/calibration
-    - Interrupt stuff
+
+    The touched pads are reported for as long as they are held, the chip
+    also flags an interrupt on both touch and release. If the ALERT pin
+    is connected, reads are started from its interrupt so the status
+    doesn't need polling while the pads are untouched. Anything else read
+    from the chip while idle, like the deltas sampled to follow baseline
+    drift, still puts traffic on the bus.
 */
 
 extern const int CAP1206_TRANSFER_FAIL;
@@ -212,23 +220,64 @@ enum SensNoiseThrsCap1206 : uint8_t {
     PER_625             = 0x03
 };
 
+/**
+ * \brief Steps of an asynchronous sensor read
+ * 
+ */
+enum AsyncStepCap1206 : uint8_t {
+    READ_STATUS         = 0x00,
+    CLEAR_INTERRUPT     = 0x01
+};
+
 class Cap1206 {
 private:
     const uint8_t ADDRESS_CAP = 0x28;
-    TwoWire* interface;
+    I2CBusManager* bus;
+    uint8_t busDevice = I2CBusManager::NO_DEVICE;
 
     bool standbyEn = false;
     bool deepSleepEn = false;
 
     bool sensors[6] = {false};
 
+    // Last known state of the configuration registers
+    RegisterShadow shadow;
+    bool batchConfig = false; // Configuration writes are held until `endConfigBatch`
+
+    // Asynchronous transfer resources
+    I2CTransaction asyncTransaction;
+    uint8_t asyncTx[2];
+    uint8_t asyncStatusRegs[4]; // Main control through sensor input
+    uint8_t* asyncTarget = nullptr;
+    volatile AsyncStepCap1206 asyncStep = AsyncStepCap1206::READ_STATUS;
+    volatile bool asyncActive = false;
+    volatile int asyncResult = 0;
+
+    int submitSensorStep(AsyncStepCap1206 step);
+    static void asyncSensorStep(I2CTransaction* trans);
+
+    // ALERT pin, reads it starts are recorded here until collected by `serviceAlert`
+    int alertPin = -1;
+    bool alertAttached = false;
+    uint8_t alertPads = 0;
+    volatile bool alertReading = false;
+
+    static Cap1206* alertOwner;
+    static void alertHandler();
+    int enableAlert();
+
     int writeSingleReg(RegistersCap1206 reg, uint8_t val);
     int readSingleReg(RegistersCap1206 reg, uint8_t* tar);
     int readManyRegs(RegistersCap1206 reg, uint8_t num, uint8_t* tar);
+    int negotiateClock();
+    int flushConfig();
 public:
-    Cap1206(TwoWire* bus);
+    Cap1206(I2CBusManager* i2c, int alert = -1);
 
     int initialize();
+    void beginConfigBatch();
+    int endConfigBatch();
+    int resyncShadow();
     int setMainControl(bool stby, bool dslp, bool clrInt);
     int checkMainControl(uint8_t* tar);
     int checkGenStatus(uint8_t* tar);
@@ -237,6 +286,14 @@ public:
     int clearInterrupt();
     int readSensors(bool target[]);
     int readSensors(uint8_t* target);
+
+    int readSensorsAsync(uint8_t* target);
+    bool asyncBusy();
+    int asyncStatus();
+
+    bool alertEnabled();
+    bool serviceAlert(uint8_t* target);
+
     int readNoiseFlags(bool target[]);
     int readNoiseFlags(uint8_t* target);
     int setSensitivity(DeltaSensitivityCap1206 sens, BaseShiftCap1206 shift);
@@ -260,8 +317,10 @@ public:
     int setRecalConfig(bool ldth, bool clrint, bool clrneg, NegDeltaCountCap1206 negcnt, CalConfigCap1206 cal);
     int setButtonThreshold(uint8_t but, uint8_t thres);
     int setButtonThresholds(uint8_t thres[]);
+    uint8_t getButtonThreshold(uint8_t but);
 
     int readDelta(int8_t* target, uint8_t but);
+    int readDeltas(int8_t target[]);
     int setMultiTouchConfig(bool en, uint8_t blockNum);
 
     int readProductID(uint8_t* id);
@@ -0,0 +1,255 @@
+#include <Arduino.h>
+
+#include "gesture.hpp"
+
+// Read periods without a report before a pad is considered released
+// Held pads are reported on every read of the sensor, so this is how many reads in a row can fail or be late
+const uint_fast8_t GESTURE_RELEASE_READS = 6;
+
+// Gesture timing (us)
+const unsigned long GESTURE_TAP_MAX_US     = 400000UL; // Longest touch that still counts as a tap
+const unsigned long GESTURE_DOUBLE_TAP_US  = 250000UL; // Longest gap between the taps of a double tap
+const unsigned long GESTURE_LONG_PRESS_US  = 600000UL; // Hold time for a long press
+const unsigned long GESTURE_REPEAT_US      = 150000UL; // Period of repeats while held after a long press
+const unsigned long GESTURE_SWIPE_MAX_US   = 800000UL; // Longest time a swipe can take
+
+// Distance the touch has to move along the pads for a swipe (Q8 pad spacings)
+const int16_t GESTURE_SWIPE_SPAN = 384;
+
+const char* GESTURE_NAMES[] = {"TAP", "DOUBLE TAP", "LONG PRESS", "HOLD REPEAT", "SWIPE"};
+
+/**
+ * \brief Construct a new GestureEngine object
+ * 
+ * \param positions Position of each pad along the LEDs (like `LEDbutton`), used to find their physical order
+ * \param readPeriodUS Period the sensor is read at while pads are held (us), sets how quickly a release is seen
+ */
+GestureEngine::GestureEngine(const int8_t positions[], unsigned long readPeriodUS) {
+    releaseUS = GESTURE_RELEASE_READS * readPeriodUS;
+
+    for (uint_fast8_t i = 0; i < NUM_PADS; i++) {
+        uint_fast8_t order = 0;
+        for (uint_fast8_t j = 0; j < NUM_PADS; j++) {
+            if ((positions[j] < positions[i]) || ((positions[j] == positions[i]) && (j < i))) order++;
+        }
+        rank[i] = order << 8;
+        lastSeenUS[i] = 0;
+    }
+}
+
+/**
+ * \brief Sets if double taps are recognized
+ * 
+ * \param enable Recognize double taps, only worth it if they have an action of their own
+ * 
+ * \note While enabled every single tap is held back for the double tap window before it is queued
+ */
+void GestureEngine::enableDoubleTap(bool enable) {
+    doubleTapEnabled = enable;
+    if (!enable && tapPending) {
+        emit(GestureType::TAP, tapPad, 0, tapTouchUS, micros());
+        tapPending = false;
+    }
+}
+
+/**
+ * \brief Finds the position of the touch along the pads
+ * 
+ * \param deltas Delta counts of each pad, null to weigh the touched pads equally
+ * \return Centroid of the touched pads (Q8 pad spacings)
+ */
+int16_t GestureEngine::position(const int8_t deltas[]) {
+    int32_t sum = 0;
+    int32_t weights = 0;
+
+    for (uint_fast8_t i = 0; i < NUM_PADS; i++) {
+        if ((down & (1 << i)) == 0) continue;
+
+        int32_t weight = 1;
+        if ((deltas != nullptr) && (deltas[i] > 1)) weight = deltas[i];
+        sum = sum + (weight * rank[i]);
+        weights = weights + weight;
+    }
+
+    if (weights == 0) return 0;
+    return sum / weights;
+}
+
+/**
+ * \brief Queues a recognized gesture
+ * 
+ * \param type Kind of gesture
+ * \param pad Pad the gesture started on
+ * \param direction Direction of a swipe
+ * \param touchUS When the touch making the gesture was first seen
+ * \param now Current time
+ */
+void GestureEngine::emit(GestureType type, uint8_t pad, int8_t direction, unsigned long touchUS, unsigned long now) {
+    unsigned long latency = now - touchUS;
+    latencyCount[type]++;
+    latencySumUS[type] = latencySumUS[type] + latency;
+    if (latency > latencyMaxUS[type]) latencyMaxUS[type] = latency;
+
+    uint_fast8_t nextTail = (tail + 1) % QUEUE_SIZE;
+    if (nextTail == head) {
+        dropped++; // Keep the older events, they happened first
+        return;
+    }
+
+    queue[tail].type = type;
+    queue[tail].pad = pad;
+    queue[tail].direction = direction;
+    queue[tail].touchUS = touchUS;
+    queue[tail].eventUS = now;
+    tail = nextTail;
+}
+
+/**
+ * \brief Processes the latest touch sensor reading
+ * 
+ * \param pads Bit mask of the pads reported as touched
+ * \param deltas Delta counts of each pad to refine the touch position, can be null
+ * 
+ * \note Call on every poll of the sensor, including when nothing is touched, to keep the timing right
+ */
+void GestureEngine::update(uint8_t pads, const int8_t deltas[]) {
+    unsigned long now = micros();
+
+    // Work out which pads are still held
+    for (uint_fast8_t i = 0; i < NUM_PADS; i++) {
+        uint8_t bit = 1 << i;
+        if ((pads & bit) != 0) {
+            lastSeenUS[i] = now;
+            down |= bit;
+        }
+        else if (((down & bit) != 0) && ((now - lastSeenUS[i]) > releaseUS)) down &= ~bit;
+    }
+
+    // A tap that wasn't followed up in time is just a tap
+    if (tapPending && !sessionActive && ((now - tapReleaseUS) > GESTURE_DOUBLE_TAP_US)) {
+        emit(GestureType::TAP, tapPad, 0, tapTouchUS, now);
+        tapPending = false;
+    }
+
+    if (down != 0) {
+        int16_t pos = position(deltas);
+
+        if (!sessionActive) {
+            sessionActive = true;
+            sessionPad = 0;
+            while ((down & (1 << sessionPad)) == 0) sessionPad++;
+            sessionStartUS = now;
+            startPosition = pos;
+            swiped = false;
+            longPressed = false;
+
+            // Touching a different pad ends any chance of a double tap
+            if (tapPending && (tapPad != sessionPad)) {
+                emit(GestureType::TAP, tapPad, 0, tapTouchUS, now);
+                tapPending = false;
+            }
+        }
+
+        int16_t travel = pos - startPosition;
+        if (!swiped && !longPressed && ((now - sessionStartUS) <= GESTURE_SWIPE_MAX_US) && 
+                ((travel >= GESTURE_SWIPE_SPAN) || (travel <= -GESTURE_SWIPE_SPAN))) {
+            if (tapPending) {
+                emit(GestureType::TAP, tapPad, 0, tapTouchUS, now);
+                tapPending = false;
+            }
+            emit(GestureType::SWIPE, sessionPad, (travel > 0) ? 1 : -1, sessionStartUS, now);
+            swiped = true;
+        }
+
+        if (!swiped && !longPressed && (down == (1 << sessionPad)) && ((now - sessionStartUS) >= GESTURE_LONG_PRESS_US)) {
+            if (tapPending) {
+                emit(GestureType::TAP, tapPad, 0, tapTouchUS, now);
+                tapPending = false;
+            }
+            emit(GestureType::LONG_PRESS, sessionPad, 0, sessionStartUS, now);
+            longPressed = true;
+            lastRepeatUS = now;
+        }
+        else if (longPressed && ((down & (1 << sessionPad)) != 0) && ((now - lastRepeatUS) >= GESTURE_REPEAT_US)) {
+            emit(GestureType::HOLD_REPEAT, sessionPad, 0, lastRepeatUS + GESTURE_REPEAT_US, now);
+            lastRepeatUS = now;
+        }
+    }
+    else if (sessionActive) {
+        // Everything released, the touch ended when the pad was last seen
+        sessionActive = false;
+        unsigned long touchEndUS = lastSeenUS[sessionPad];
+
+        if (!swiped && !longPressed && ((touchEndUS - sessionStartUS) <= GESTURE_TAP_MAX_US)) {
+            if (!doubleTapEnabled) emit(GestureType::TAP, sessionPad, 0, sessionStartUS, now);
+            else if (tapPending) {
+                emit(GestureType::DOUBLE_TAP, sessionPad, 0, tapTouchUS, now);
+                tapPending = false;
+            }
+            else {
+                tapPending = true;
+                tapPad = sessionPad;
+                tapTouchUS = sessionStartUS;
+                tapReleaseUS = touchEndUS;
+            }
+        }
+    }
+}
+
+/**
+ * \brief Checks if there are gestures waiting
+ */
+bool GestureEngine::available() {
+    return head != tail;
+}
+
+/**
+ * \brief Takes the oldest gesture waiting
+ * 
+ * \param event Location to record the gesture
+ * \return If there was a gesture
+ */
+bool GestureEngine::pop(GestureEvent* event) {
+    if (head == tail) return false;
+
+    *event = queue[head];
+    head = (head + 1) % QUEUE_SIZE;
+    return true;
+}
+
+/**
+ * \brief Returns the number of gestures lost to a full queue
+ */
+unsigned long GestureEngine::getDropped() {
+    return dropped;
+}
+
+/**
+ * \brief Prints the latency from touch to gesture for each kind of gesture
+ */
+void GestureEngine::printLatency() {
+    SerialUSB.println("GESTURE LATENCY (gesture, count, average us, max us)");
+    for (uint_fast8_t i = 0; i < GestureType::NUM_GESTURES; i++) {
+        SerialUSB.print(GESTURE_NAMES[i]);
+        SerialUSB.print("\t");
+        SerialUSB.print(latencyCount[i]);
+        SerialUSB.print("\t");
+        if (latencyCount[i] > 0) SerialUSB.print(latencySumUS[i] / latencyCount[i]);
+        else SerialUSB.print(0);
+        SerialUSB.print("\t");
+        SerialUSB.println(latencyMaxUS[i]);
+    }
+    SerialUSB.print("DROPPED\t");
+    SerialUSB.println(dropped);
+}
+
+/**
+ * \brief Clears the latency statistics
+ */
+void GestureEngine::resetLatency() {
+    for (uint_fast8_t i = 0; i < GestureType::NUM_GESTURES; i++) {
+        latencyCount[i] = 0;
+        latencySumUS[i] = 0;
+        latencyMaxUS[i] = 0;
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef GESTURE_HEADER
+#define GESTURE_HEADER
+
+#include <Arduino.h>
+
+/* Touch gesture recognition for the tab pads
+
+    Turns the touched pad bit masks from the CAP1206 into taps, double
+    taps, long presses (with repeats while held) and swipes along the
+    pads. Events are timestamped and held in a small queue until used.
+
+    A held pad is reported on every read of the CAP1206 (the sensor
+    input bits stay set while held, whether or not an interrupt is
+    flagged, the chip's repeat rate plays no part). A pad is considered
+    released once it hasn't been seen for a few read periods, so a
+    single failed or late read doesn't split a touch in two. The period
+    the sensor is read at is given when the engine is made.
+
+    The touch position used for swipes is the centroid of the touched
+    pads in their physical order. If the pad deltas are provided it is
+    weighted by them, otherwise each touched pad counts equally.
+
+    Double taps are only looked for once enabled with `enableDoubleTap`,
+    since telling them apart means holding every single tap back for the
+    double tap window. Until then a tap is queued as soon as the pad is
+    released.
+
+    Latency is measured from the poll that first saw the touch to the
+    event being queued, this includes the release timeout for taps and
+    waiting out the double tap window when double taps are enabled.
+*/
+
+enum GestureType : uint8_t {
+    TAP = 0,        // Short touch and release of a pad
+    DOUBLE_TAP,     // Two taps of the same pad in quick succession
+    LONG_PRESS,     // Pad held down
+    HOLD_REPEAT,    // Pad still held down after a long press, repeats regularly
+    SWIPE,          // Touch moved along the pads
+    NUM_GESTURES
+};
+
+struct GestureEvent {
+    GestureType type = GestureType::TAP;
+    uint8_t pad = 0;            // Pad the gesture started on (bit in the pad mask)
+    int8_t direction = 0;       // Swipes only, positive is towards pads at higher LED positions
+    unsigned long touchUS = 0;  // When the touch was first seen (`micros()`)
+    unsigned long eventUS = 0;  // When the gesture was recognized (`micros()`)
+};
+
+class GestureEngine {
+public:
+    static const uint_fast8_t NUM_PADS = 4;
+
+private:
+    static const uint_fast8_t QUEUE_SIZE = 8;
+
+    int16_t rank[NUM_PADS];                 // Physical order of each pad (Q8)
+    unsigned long lastSeenUS[NUM_PADS];     // Last time each pad was reported touched
+    uint8_t down = 0;                       // Pads considered touched
+    unsigned long releaseUS;                // Time without a report before a pad is considered released
+
+    // Current touch, from the first pad touched until all are released
+    bool sessionActive = false;
+    uint8_t sessionPad = 0;
+    unsigned long sessionStartUS = 0;
+    int16_t startPosition = 0;
+    bool swiped = false;
+    bool longPressed = false;
+    unsigned long lastRepeatUS = 0;
+
+    // Tap waiting to see if it becomes a double tap
+    bool doubleTapEnabled = false;
+    bool tapPending = false;
+    uint8_t tapPad = 0;
+    unsigned long tapTouchUS = 0;
+    unsigned long tapReleaseUS = 0;
+
+    GestureEvent queue[QUEUE_SIZE];
+    uint_fast8_t head = 0;
+    uint_fast8_t tail = 0;
+    unsigned long dropped = 0;
+
+    unsigned long latencyCount[NUM_GESTURES] = {0};
+    unsigned long latencySumUS[NUM_GESTURES] = {0};
+    unsigned long latencyMaxUS[NUM_GESTURES] = {0};
+
+    int16_t position(const int8_t deltas[]);
+    void emit(GestureType type, uint8_t pad, int8_t direction, unsigned long touchUS, unsigned long now);
+
+public:
+    GestureEngine(const int8_t positions[], unsigned long readPeriodUS);
+
+    void enableDoubleTap(bool enable);
+    void update(uint8_t pads, const int8_t deltas[] = nullptr);
+    bool available();
+    bool pop(GestureEvent* event);
+    unsigned long getDropped();
+
+    void printLatency();
+    void resetLatency();
+};
+
+#endif
@@ -0,0 +1,576 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "hardware/sync.h"
+
+#include "i2c_transport.hpp"
+#include "i2c_bus.hpp"
+
+const int I2C_BUS_FAIL = -1;
+const int I2C_BUS_SUCCESS = 0;
+
+// Standard mode, fast mode, and fast mode plus
+const uint32_t I2CBusManager::CLOCKS[I2CBusManager::NUM_CLOCKS] = {100000, 400000, 1000000};
+
+/**
+ * \brief Construct a new I2CBusManager object
+ *
+ * \param bus I2C bus to manage
+ * \param inst RP2040 I2C peripheral used by the bus (given the bus' pins)
+ */
+I2CBusManager::I2CBusManager(TwoWire* bus, i2c_inst_t* inst) : transport(inst) {
+    wire = bus;
+}
+
+/**
+ * \brief Starts the I2C bus and the non-blocking transport on it
+ *
+ * \param clock Bus clock frequency (Hz), used for devices until their clock is negotiated
+ * \param keepAliveCallback Run between the blocking probes of clock negotiation, such as to kick a watchdog
+ * \return Return status of the set up
+ */
+int I2CBusManager::initialize(uint32_t clock, void (*keepAliveCallback)()) {
+    wire->begin(); // Sets up the pins and peripheral
+    wire->setClock(clock);
+    baseClock = clock;
+    keepAlive = keepAliveCallback;
+
+    statsStartUS = micros();
+
+    if (transport.initialize(completionHandler, this) == I2C_TRANSPORT_FAIL) return I2C_BUS_FAIL;
+    return I2C_BUS_SUCCESS;
+}
+
+/**
+ * \brief Registers a device on the bus for its traffic to be tracked
+ *
+ * \param address Seven bit address of the device
+ * \param name Name to report statistics with
+ * \param maxClock Fastest bus clock the device supports (Hz)
+ * \return Index of the device to use in transactions, `NO_DEVICE` if there's no space for it
+ */
+uint8_t I2CBusManager::registerDevice(uint8_t address, const char* name, uint32_t maxClock) {
+    // Return the existing index if already registered
+    for (uint_fast8_t i = 0; i < numDevices; i++) {
+        if (devices[i].address == address) return i;
+    }
+    if (numDevices >= MAX_DEVICES) return NO_DEVICE;
+
+    devices[numDevices].address = address;
+    devices[numDevices].name = name;
+    devices[numDevices].maxClock = maxClock;
+    devices[numDevices].clock = (baseClock < maxClock) ? baseClock : maxClock;
+    numDevices++;
+    return numDevices - 1;
+}
+
+/**
+ * \brief Finds the fastest reliable clock for a device by probing it from its fastest rate down
+ *
+ * \param device Index of the device
+ * \param probe Transaction to test the device with, it should be short and harmless to repeat
+ * \param expected Data the probe is expected to read back, if null only acknowledgement is checked
+ *
+ * \note Prints the measured time of the probe at each rate tried
+ * \note Blocks while probing, call during set up, the keep alive callback is run between probes
+ * \return Return status of the negotiation, fails if the device isn't reliable at any rate
+ */
+int I2CBusManager::negotiateClock(uint8_t device, I2CTransaction* probe, const uint8_t* expected) {
+    if (device >= numDevices) return I2C_BUS_FAIL;
+    DeviceStatsI2C* dev = &devices[device];
+
+    uint32_t best = 0;
+    probe->device = device;
+    probe->retries = 0; // A rate needing retries isn't reliable
+
+    // A device normally works at the rate it supports, so that is tried first to keep start up short
+    for (int c = NUM_CLOCKS - 1; c >= 0; c--) {
+        if (CLOCKS[c] > dev->maxClock) continue;
+        dev->clock = CLOCKS[c];
+
+        bool reliable = true;
+        unsigned long elapsed = 0;
+        for (uint_fast8_t i = 0; (i < PROBE_ATTEMPTS) && reliable; i++) {
+            if (keepAlive != nullptr) keepAlive();
+
+            unsigned long start = micros();
+            if (transfer(probe, PriorityI2C::PRIO_BACKGROUND) == I2C_BUS_FAIL) reliable = false;
+            else if ((expected != nullptr) && (memcmp(probe->readData, expected, probe->readLength) != 0)) 
+                reliable = false;
+            elapsed = elapsed + (micros() - start);
+        }
+        elapsed = elapsed / PROBE_ATTEMPTS;
+
+        SerialUSB.print("I2C ");
+        SerialUSB.print(dev->name);
+        SerialUSB.print(" AT ");
+        SerialUSB.print(CLOCKS[c]);
+        if (reliable) {
+            SerialUSB.print(" HZ PROBED IN ");
+            SerialUSB.print(elapsed);
+            SerialUSB.println(" US");
+        }
+        else SerialUSB.println(" HZ FAILED");
+
+        // Slower rates are only better for signal integrity, stop at the first that works
+        if (reliable) {
+            best = CLOCKS[c];
+            break;
+        }
+    }
+
+    // Clear out errors from probing so they don't count towards lowering the clock
+    dev->windowTransactions = 0;
+    dev->windowErrors = 0;
+
+    if (best == 0) {
+        dev->clock = CLOCKS[0];
+        return I2C_BUS_FAIL;
+    }
+    dev->clock = best;
+    return I2C_BUS_SUCCESS;
+}
+
+#ifdef DEBUG
+/**
+ * \brief Times a transaction at each standard rate up to the one negotiated for its device, and prints them
+ *
+ * \param trans Transaction to time, such as a device's largest regular transfer
+ *
+ * \note Blocks while timing, the keep alive callback is run between rates
+ * \note The device is left at its negotiated clock
+ */
+void I2CBusManager::printTransferTimes(I2CTransaction* trans) {
+    if (trans->device >= numDevices) return;
+    DeviceStatsI2C* dev = &devices[trans->device];
+    uint32_t negotiated = dev->clock;
+
+    uint8_t retries = trans->retries;
+    trans->retries = 0;
+    for (uint_fast8_t c = 0; (c < NUM_CLOCKS) && (CLOCKS[c] <= negotiated); c++) {
+        if (keepAlive != nullptr) keepAlive();
+        dev->clock = CLOCKS[c];
+
+        unsigned long start = micros();
+        int result = transfer(trans, PriorityI2C::PRIO_BACKGROUND);
+        unsigned long elapsed = micros() - start;
+
+        SerialUSB.print("I2C ");
+        SerialUSB.print(dev->name);
+        SerialUSB.print(" AT ");
+        SerialUSB.print(CLOCKS[c]);
+        if (result == I2C_BUS_SUCCESS) {
+            SerialUSB.print(" HZ ");
+            SerialUSB.print(trans->writeLength + trans->readLength);
+            SerialUSB.print(" BYTES IN ");
+            SerialUSB.print(elapsed);
+            SerialUSB.println(" US");
+        }
+        else SerialUSB.println(" HZ FAILED");
+    }
+    trans->retries = retries;
+
+    // Errors from timing don't count towards lowering the clock either
+    dev->clock = negotiated;
+    dev->windowTransactions = 0;
+    dev->windowErrors = 0;
+}
+#endif
+
+/**
+ * \brief Queues a transaction without waiting for it
+ *
+ * \param trans Transaction to perform, must remain valid until no longer pending
+ * \param priority Priority of the transaction
+ *
+ * \note The address is taken from the device the transaction is for
+ * \note Safe to call from interrupts (including transaction callbacks)
+ * \return Return status of the queuing, fails if the queue is full or the device is unknown
+ */
+int I2CBusManager::submit(I2CTransaction* trans, PriorityI2C priority) {
+    return submitChain(&trans, 1, priority);
+}
+
+/**
+ * \brief Queues transactions to run back to back, without waiting for them
+ *
+ * \param trans Transactions to perform in order, each must remain valid until no longer pending
+ * \param num Number of transactions
+ * \param priority Priority of the chain, it is scheduled as a single transaction
+ *
+ * \note Once the first starts no other traffic is put on the bus until the last is done
+ * \note Safe to call from interrupts (including transaction callbacks)
+ * \return Return status of the queuing, fails if the queue is full or a device is unknown
+ */
+int I2CBusManager::submitChain(I2CTransaction* trans[], uint8_t num, PriorityI2C priority) {
+    if (num == 0) return I2C_BUS_FAIL;
+    for (uint_fast8_t i = 0; i < num; i++) {
+        if (trans[i]->device >= numDevices) return I2C_BUS_FAIL;
+    }
+
+    uint32_t interruptState = save_and_disable_interrupts();
+
+    queue_t* q = &queues[priority];
+    uint_fast8_t nextTail = (q->tail + 1) % QUEUE_SIZE;
+    if (nextTail == q->head) {
+        restore_interrupts(interruptState);
+        return I2C_BUS_FAIL; // Queue full
+    }
+
+    unsigned long now = micros();
+    for (uint_fast8_t i = 0; i < num; i++) {
+        trans[i]->address = devices[trans[i]->device].address;
+        trans[i]->priority = priority;
+        trans[i]->bypassed = 0;
+        trans[i]->queuedUS = now;
+        trans[i]->pending = true;
+        trans[i]->status = I2C_TRANSPORT_SUCCESS;
+        trans[i]->attempts = 0;
+        trans[i]->chained = (i + 1 < num) ? trans[i + 1] : nullptr;
+    }
+
+    // Only the first of a chain is queued, the rest follow it directly
+    q->entries[q->tail] = trans[0];
+    q->tail = nextTail;
+
+    if (!transport.busy()) startNext();
+
+    restore_interrupts(interruptState);
+    return I2C_BUS_SUCCESS;
+}
+
+/**
+ * \brief Performs a transaction, waiting for it to complete
+ *
+ * \param trans Transaction to perform
+ * \param priority Priority of the transaction
+ * \return Return status of the transfer
+ */
+int I2CBusManager::transfer(I2CTransaction* trans, PriorityI2C priority) {
+    uint8_t retries = trans->retries;
+    int result = I2C_BUS_FAIL;
+
+    // Retries are handled here to back off between them, not by requeuing
+    trans->retries = 0;
+    for (uint_fast8_t attempt = 0; attempt <= retries; attempt++) {
+        if (attempt > 0) delayMicroseconds(RETRY_BACKOFF_US << (attempt - 1));
+
+        if (submit(trans, priority) == I2C_BUS_FAIL) continue;
+        while (trans->pending) service();
+
+        if (trans->status == I2C_TRANSPORT_SUCCESS) {
+            result = I2C_BUS_SUCCESS;
+            break;
+        }
+    }
+
+    trans->retries = retries;
+    return result;
+}
+
+/**
+ * \brief Writes data to a device, waiting for it to complete
+ *
+ * \param device Index of the device
+ * \param data Data to write
+ * \param len Number of bytes to write
+ * \param priority Priority of the transaction
+ * \return Return status of the transfer
+ */
+int I2CBusManager::write(uint8_t device, const uint8_t* data, uint8_t len, PriorityI2C priority) {
+    I2CTransaction trans;
+    trans.device = device;
+    trans.writeData = data;
+    trans.writeLength = len;
+
+    return transfer(&trans, priority);
+}
+
+/**
+ * \brief Writes data to a device and then reads from it, waiting for it to complete
+ *
+ * \param device Index of the device
+ * \param data Data to write (typically the register address)
+ * \param len Number of bytes to write
+ * \param tar Location to record read data
+ * \param num Number of bytes to read
+ * \param priority Priority of the transaction
+ * \return Return status of the transfer
+ */
+int I2CBusManager::writeRead(uint8_t device, const uint8_t* data, uint8_t len, uint8_t* tar, uint8_t num,
+        PriorityI2C priority) {
+    I2CTransaction trans;
+    trans.device = device;
+    trans.writeData = data;
+    trans.writeLength = len;
+    trans.readData = tar;
+    trans.readLength = num;
+
+    return transfer(&trans, priority);
+}
+
+/**
+ * \brief Removes the next transaction to run from the queues
+ *
+ * \note Must be called with interrupts disabled
+ * \return Transaction to run, null if there's none
+ */
+I2CTransaction* I2CBusManager::popNext() {
+    int chosen = -1;
+
+    // Lower priority transactions that have waited through enough others go first
+    for (uint_fast8_t p = 1; p < NUM_PRIORITIES; p++) {
+        if (queues[p].head == queues[p].tail) continue;
+        if (queues[p].entries[queues[p].head]->bypassed >= MAX_BYPASS) {
+            chosen = p;
+            break;
+        }
+    }
+
+    // Otherwise highest priority first
+    if (chosen < 0) {
+        for (uint_fast8_t p = 0; p < NUM_PRIORITIES; p++) {
+            if (queues[p].head == queues[p].tail) continue;
+            chosen = p;
+            break;
+        }
+    }
+    if (chosen < 0) return nullptr;
+
+    // Record lower priority transactions being passed over
+    for (uint_fast8_t p = chosen + 1; p < NUM_PRIORITIES; p++) {
+        if (queues[p].head == queues[p].tail) continue;
+        queues[p].entries[queues[p].head]->bypassed++;
+    }
+
+    queue_t* q = &queues[chosen];
+    I2CTransaction* trans = q->entries[q->head];
+    q->head = (q->head + 1) % QUEUE_SIZE;
+    return trans;
+}
+
+/**
+ * \brief Puts the next transaction on the bus
+ *
+ * \note Must be called with interrupts disabled
+ */
+void I2CBusManager::startNext() {
+    I2CTransaction* trans = popNext();
+    while (trans != nullptr) {
+        trans->startedUS = micros();
+        if (transport.start(trans, devices[trans->device].clock) == I2C_TRANSPORT_SUCCESS) return;
+
+        // Could not be started (invalid), report it and move on
+        complete(trans, I2C_TRANSPORT_FAIL);
+        if (transport.busy()) return;
+        trans = popNext();
+    }
+}
+
+/**
+ * \brief Puts the next transaction of a chain on the bus, ahead of anything queued
+ *
+ * \param trans Transaction to start
+ *
+ * \note Must be called with interrupts disabled
+ */
+void I2CBusManager::startChained(I2CTransaction* trans) {
+    trans->startedUS = micros();
+    if (transport.start(trans, devices[trans->device].clock) == I2C_TRANSPORT_SUCCESS) return;
+
+    // Could not be started (invalid), report it and move on with the rest of the chain
+    complete(trans, I2C_TRANSPORT_FAIL);
+}
+
+/**
+ * \brief Records a finished transaction, continues its chain and notifies its submitter
+ *
+ * \param trans Finished transaction
+ * \param status Result of the transaction
+ *
+ * \note Must be called with interrupts disabled
+ */
+void I2CBusManager::complete(I2CTransaction* trans, int status) {
+    unsigned long now = micros();
+    DeviceStatsI2C* stats = &devices[trans->device];
+
+    unsigned long waited = trans->startedUS - trans->queuedUS;
+    stats->transactions++;
+    stats->bytes = stats->bytes + trans->writeLength + trans->readLength + 1;
+    if ((trans->writeLength > 0) && (trans->readLength > 0)) stats->bytes++; // Repeated address
+    stats->busyUS = stats->busyUS + (now - trans->startedUS);
+    stats->waitUS = stats->waitUS + waited;
+    if (waited > stats->maxWaitUS) stats->maxWaitUS = waited;
+    if (status != I2C_TRANSPORT_SUCCESS) stats->errors++;
+    trackErrorRate(stats, status);
+
+    // A retried transaction holds back the rest of its chain so they still run in order
+    if ((status != I2C_TRANSPORT_SUCCESS) && retry(trans)) return;
+
+    // Continue a chain before notifying anyone so nothing else can get on the bus in between
+    if (trans->chained != nullptr) startChained(trans->chained);
+
+    trans->status = status;
+    trans->pending = false;
+    if (trans->callback != nullptr) trans->callback(trans);
+}
+
+/**
+ * \brief Queues a failed transaction again if it has retries left
+ *
+ * \param trans Failed transaction
+ *
+ * \note Must be called with interrupts disabled
+ * \return If the transaction was queued again
+ */
+bool I2CBusManager::retry(I2CTransaction* trans) {
+    if (trans->attempts >= trans->retries) return false;
+
+    queue_t* q = &queues[trans->priority];
+    uint_fast8_t nextHead = (q->head + QUEUE_SIZE - 1) % QUEUE_SIZE;
+    if (nextHead == q->tail) return false; // Queue full
+
+    // Going to the front of the queue keeps it ahead of everything submitted after it, and what it's
+    // chained to stays behind it, so the order transactions were submitted in is kept
+    trans->attempts++;
+    trans->bypassed = 0;
+    devices[trans->device].retries++;
+
+    q->head = nextHead;
+    q->entries[q->head] = trans;
+    return true;
+}
+
+/**
+ * \brief Lowers the clock of a device if too many of its recent transactions failed
+ *
+ * \param dev Device the transaction was for
+ * \param status Result of the transaction
+ *
+ * \note Must be called with interrupts disabled
+ */
+void I2CBusManager::trackErrorRate(DeviceStatsI2C* dev, int status) {
+    dev->windowTransactions++;
+    if (status != I2C_TRANSPORT_SUCCESS) dev->windowErrors++;
+
+    if (dev->windowErrors >= MAX_WINDOW_ERRORS) {
+        // Step down to the next slower rate if there is one
+        for (int c = NUM_CLOCKS - 1; c >= 0; c--) {
+            if (CLOCKS[c] < dev->clock) {
+                dev->clock = CLOCKS[c];
+                dev->fallbacks++;
+                break;
+            }
+        }
+        dev->windowTransactions = 0;
+        dev->windowErrors = 0;
+    }
+    else if (dev->windowTransactions >= ERROR_WINDOW) {
+        dev->windowTransactions = 0;
+        dev->windowErrors = 0;
+    }
+}
+
+/**
+ * \brief Handles the transport reporting a transaction is complete
+ *
+ * \note Run from interrupt
+ */
+void I2CBusManager::completionHandler(void* owner, I2CTransaction* trans, int status) {
+    I2CBusManager* manager = (I2CBusManager*)owner;
+    manager->complete(trans, status);
+
+    // Callback may have started something already through `submit`
+    if (!manager->transport.busy()) manager->startNext();
+}
+
+/**
+ * \brief Checks on the bus, progressing the queue if the active transaction is done
+ *
+ * \note This is normally handled by interrupt, polling is only needed while waiting on a transfer
+ */
+void I2CBusManager::service() {
+    transport.service();
+}
+
+/**
+ * \brief Checks if there are transactions queued or in progress
+ */
+bool I2CBusManager::busy() {
+    if (transport.busy()) return true;
+    for (uint_fast8_t p = 0; p < NUM_PRIORITIES; p++) {
+        if (queues[p].head != queues[p].tail) return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Blocks until all queued transactions are complete
+ */
+void I2CBusManager::waitIdle() {
+    while (busy()) service();
+}
+
+/**
+ * \brief Retrieves the bus usage statistics for a device
+ *
+ * \param device Index of the device
+ * \return Pointer to the statistics, null if the device is unknown
+ */
+const DeviceStatsI2C* I2CBusManager::getStatistics(uint8_t device) {
+    if (device >= numDevices) return nullptr;
+    return &devices[device];
+}
+
+/**
+ * \brief Clears the bus usage statistics for all devices
+ */
+void I2CBusManager::resetStatistics() {
+    uint32_t interruptState = save_and_disable_interrupts();
+
+    for (uint_fast8_t i = 0; i < numDevices; i++) {
+        devices[i].transactions = 0;
+        devices[i].bytes = 0;
+        devices[i].busyUS = 0;
+        devices[i].waitUS = 0;
+        devices[i].maxWaitUS = 0;
+        devices[i].errors = 0;
+        devices[i].retries = 0;
+    }
+    statsStartUS = micros();
+
+    restore_interrupts(interruptState);
+}
+
+/**
+ * \brief Prints the bus usage of each device since the statistics were last reset
+ */
+void I2CBusManager::printStatistics() {
+    unsigned long elapsed = micros() - statsStartUS;
+    if (elapsed == 0) elapsed = 1;
+
+    SerialUSB.println("I2C BUS OCCUPANCY (device, address, clock Hz, transactions, bytes, busy %, average wait us, max wait us, errors, retries, clock fallbacks)");
+    for (uint_fast8_t i = 0; i < numDevices; i++) {
+        SerialUSB.print(devices[i].name);
+        SerialUSB.print("\t0x");
+        SerialUSB.print(devices[i].address, HEX);
+        SerialUSB.print("\t");
+        SerialUSB.print(devices[i].clock);
+        SerialUSB.print("\t");
+        SerialUSB.print(devices[i].transactions);
+        SerialUSB.print("\t");
+        SerialUSB.print(devices[i].bytes);
+        SerialUSB.print("\t");
+        SerialUSB.print(100.0 * devices[i].busyUS / elapsed);
+        SerialUSB.print("\t");
+        if (devices[i].transactions > 0) SerialUSB.print(devices[i].waitUS / devices[i].transactions);
+        else SerialUSB.print(0);
+        SerialUSB.print("\t");
+        SerialUSB.print(devices[i].maxWaitUS);
+        SerialUSB.print("\t");
+        SerialUSB.print(devices[i].errors);
+        SerialUSB.print("\t");
+        SerialUSB.print(devices[i].retries);
+        SerialUSB.print("\t");
+        SerialUSB.println(devices[i].fallbacks);
+    }
+}
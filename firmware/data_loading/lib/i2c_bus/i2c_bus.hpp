@@ -0,0 +1,139 @@
+#ifndef I2C_BUS_HEADER
+#define I2C_BUS_HEADER
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "i2c_transport.hpp"
+
+/* Shared I2C bus manager
+
+    Owns the I2C bus shared by the LED drivers and touch sensor. All
+    traffic from the devices is submitted here as transactions with a
+    priority and run through the non-blocking transport one at a time.
+
+    Transactions are never interrupted once on the bus, so responsiveness
+    for the high priority (touch) traffic is bounded by the longest single
+    transaction of the other devices. Devices are expected to break long
+    bursts up accordingly. To keep the lower priorities moving when there
+    is a lot of high priority traffic, a transaction that has been passed
+    over enough times is run regardless. A set of transactions can also be
+    chained so that they run back to back with nothing in between.
+
+    Bus occupancy (time on the bus, bytes, waiting time, errors) is
+    recorded for each registered device.
+
+    Failed transactions are retried a limited number of times (set per
+    transaction) before the failure is reported. Queued transactions go
+    back to the front of their queue to retry, holding back the rest of a
+    chain they are in so it still runs in order (other priorities can get
+    on the bus in between). Blocking transfers wait a doubling backoff
+    between attempts.
+
+    Each device runs at its own clock rate, switched between transactions.
+    The rate is negotiated at start up by probing the device at the
+    fastest standard rate it supports and stepping down a rate at a time
+    until it is reliable. The probes block, so a keep alive callback (for
+    kicking a watchdog) is run between them. A probe that can only be
+    checked for acknowledgement (of a write only device) can't catch
+    data corrupted on the way, only a device that stops answering. DEBUG
+    builds can also time a device's real transfers at each rate up to
+    the negotiated one with `printTransferTimes`. If errors climb during
+    operation the device is stepped down a rate automatically.
+*/
+
+extern const int I2C_BUS_FAIL;
+extern const int I2C_BUS_SUCCESS;
+
+enum PriorityI2C : uint8_t {
+    PRIO_INTERACTIVE    = 0, // Latency sensitive, user input
+    PRIO_STREAM         = 1, // Regular bulk data like LED frames
+    PRIO_BACKGROUND     = 2  // Configuration and anything else
+};
+
+struct DeviceStatsI2C {
+    const char* name = nullptr;
+    uint8_t address = 0;
+    unsigned long transactions = 0; // Completed transactions
+    unsigned long bytes = 0;        // Bytes moved, including the address byte
+    unsigned long busyUS = 0;       // Total time spent on the bus
+    unsigned long waitUS = 0;       // Total time spent waiting in queue
+    unsigned long maxWaitUS = 0;    // Longest wait in queue
+    unsigned long errors = 0;       // Failed transactions (including ones retried)
+    unsigned long retries = 0;      // Transactions attempted again after failing
+
+    uint32_t clock = 0;             // Bus clock used with the device (Hz)
+    uint32_t maxClock = 0;          // Fastest clock the device supports (Hz)
+    unsigned long fallbacks = 0;    // Times the clock was lowered due to errors while running
+
+    uint_fast8_t windowTransactions = 0;    // Transactions in the current error rate window
+    uint_fast8_t windowErrors = 0;          // Failed transactions in the current error rate window
+};
+
+class I2CBusManager {
+private:
+    static const uint_fast8_t NUM_PRIORITIES = 3;
+    static const uint_fast8_t QUEUE_SIZE = 16;      // Queue size for each priority
+    static const uint_fast8_t MAX_BYPASS = 4;       // Times a transaction can be passed over before it is run regardless
+    static const uint_fast8_t MAX_DEVICES = 4;
+
+    static const uint_fast8_t NUM_CLOCKS = 3;
+    static const uint32_t CLOCKS[NUM_CLOCKS];       // Standard rates to use, increasing
+    static const uint_fast8_t PROBE_ATTEMPTS = 4;   // Probes needed at a rate for it to be considered reliable
+    static const uint_fast8_t ERROR_WINDOW = 64;    // Transactions to track the error rate over
+    static const uint_fast8_t MAX_WINDOW_ERRORS = 4;// Errors in a window that trigger lowering the clock
+    static const unsigned long RETRY_BACKOFF_US = 100; // First wait before retrying a blocking transfer, doubles each retry
+
+    TwoWire* wire;
+    I2CTransport transport;
+
+    struct queue_t {
+        I2CTransaction* entries[QUEUE_SIZE];
+        uint_fast8_t head = 0;
+        uint_fast8_t tail = 0;
+    };
+    queue_t queues[NUM_PRIORITIES];
+
+    DeviceStatsI2C devices[MAX_DEVICES];
+    uint_fast8_t numDevices = 0;
+    unsigned long statsStartUS = 0;
+    uint32_t baseClock = 0;
+    void (*keepAlive)() = nullptr;
+
+    I2CTransaction* popNext();
+    void startNext();
+    void startChained(I2CTransaction* trans);
+    void complete(I2CTransaction* trans, int status);
+    bool retry(I2CTransaction* trans);
+    void trackErrorRate(DeviceStatsI2C* dev, int status);
+    static void completionHandler(void* owner, I2CTransaction* trans, int status);
+
+public:
+    static const uint8_t NO_DEVICE = 0xFF;
+
+    I2CBusManager(TwoWire* bus, i2c_inst_t* inst);
+
+    int initialize(uint32_t clock, void (*keepAliveCallback)() = nullptr);
+    uint8_t registerDevice(uint8_t address, const char* name, uint32_t maxClock = 400000);
+    int negotiateClock(uint8_t device, I2CTransaction* probe, const uint8_t* expected = nullptr);
+#ifdef DEBUG
+    void printTransferTimes(I2CTransaction* trans);
+#endif
+
+    int submit(I2CTransaction* trans, PriorityI2C priority);
+    int submitChain(I2CTransaction* trans[], uint8_t num, PriorityI2C priority);
+    int transfer(I2CTransaction* trans, PriorityI2C priority);
+    int write(uint8_t device, const uint8_t* data, uint8_t len, PriorityI2C priority = PRIO_BACKGROUND);
+    int writeRead(uint8_t device, const uint8_t* data, uint8_t len, uint8_t* tar, uint8_t num,
+        PriorityI2C priority = PRIO_BACKGROUND);
+
+    void service();
+    bool busy();
+    void waitIdle();
+
+    const DeviceStatsI2C* getStatistics(uint8_t device);
+    void resetStatistics();
+    void printStatistics();
+};
+
+#endif
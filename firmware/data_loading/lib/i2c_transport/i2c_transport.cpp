@@ -0,0 +1,170 @@
+#include <Arduino.h>
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "i2c_transport.hpp"
+
+const int I2C_TRANSPORT_FAIL = -1;
+const int I2C_TRANSPORT_SUCCESS = 0;
+
+I2CTransport* I2CTransport::irqOwner[2] = {nullptr, nullptr};
+
+/**
+ * \brief Construct a new I2CTransport object
+ *
+ * \param inst I2C peripheral to use, must match the one used by the `TwoWire` bus
+ */
+I2CTransport::I2CTransport(i2c_inst_t* inst) {
+    instance = inst;
+}
+
+/**
+ * \brief Claims the DMA channels and enables the completion interrupt
+ *
+ * \param handler Called from interrupt once a transaction is complete
+ * \param owner Passed to the handler, typically the bus manager
+ *
+ * \note Call after the bus has been started through `TwoWire::begin()`
+ * \return Return status of the set up
+ */
+int I2CTransport::initialize(I2CCompletionHandler handler, void* owner) {
+    completionHandler = handler;
+    completionOwner = owner;
+
+    if (txChannel < 0) txChannel = dma_claim_unused_channel(false);
+    if (rxChannel < 0) rxChannel = dma_claim_unused_channel(false);
+    if ((txChannel < 0) || (rxChannel < 0)) return I2C_TRANSPORT_FAIL;
+
+    i2c_hw_t* hw = i2c_get_hw(instance);
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->dma_tdlr = 4; // Request more commands when the FIFO is down to this many entries
+    hw->dma_rdlr = 0; // Request a read as soon as a single byte is available
+    hw->intr_mask = 0;
+
+    unsigned index = i2c_hw_index(instance);
+    irqOwner[index] = this;
+    irq_set_exclusive_handler(I2C0_IRQ + index, (index == 0) ? irqHandler0 : irqHandler1);
+    irq_set_enabled(I2C0_IRQ + index, true);
+
+    return I2C_TRANSPORT_SUCCESS;
+}
+
+/**
+ * \brief Puts a transaction on the bus
+ *
+ * \param trans Transaction to perform, must remain valid until completion is reported
+ * \param clk Bus clock to run the transaction at (Hz)
+ *
+ * \note Must be called with interrupts disabled
+ * \return Return status of starting, fails if already busy or the transaction is invalid
+ */
+int I2CTransport::start(I2CTransaction* trans, uint32_t clk) {
+    if (active != nullptr) return I2C_TRANSPORT_FAIL;
+    if ((trans->writeLength + trans->readLength) > MAX_COMMANDS) return I2C_TRANSPORT_FAIL;
+    if ((trans->writeLength + trans->readLength) == 0) return I2C_TRANSPORT_FAIL;
+
+    active = trans;
+    aborted = false;
+
+    // Build the command list, the stop is put on the last command and a restart between writing and reading
+    uint_fast16_t count = 0;
+    for (uint_fast8_t i = 0; i < trans->writeLength; i++) commands[count++] = trans->writeData[i];
+    for (uint_fast8_t i = 0; i < trans->readLength; i++) {
+        commands[count] = I2C_IC_DATA_CMD_CMD_BITS;
+        if ((i == 0) && (trans->writeLength > 0)) commands[count] |= I2C_IC_DATA_CMD_RESTART_BITS;
+        count++;
+    }
+    commands[count - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    // Devices on the bus may run at different rates, only reconfigure when it changes
+    if (clk != clock) {
+        i2c_set_baudrate(instance, clk); // Disables the peripheral while changing the timing
+        clock = clk;
+    }
+
+    // The target address can only be changed while the peripheral is disabled
+    i2c_hw_t* hw = i2c_get_hw(instance);
+    hw->enable = 0;
+    hw->tar = trans->address;
+    hw->enable = 1;
+
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    unsigned index = i2c_hw_index(instance);
+
+    if (trans->readLength > 0) {
+        dma_channel_config rxConfig = dma_channel_get_default_config(rxChannel);
+        channel_config_set_transfer_data_size(&rxConfig, DMA_SIZE_8);
+        channel_config_set_read_increment(&rxConfig, false);
+        channel_config_set_write_increment(&rxConfig, true);
+        channel_config_set_dreq(&rxConfig, DREQ_I2C0_RX + (2 * index));
+        dma_channel_configure(rxChannel, &rxConfig, trans->readData, &hw->data_cmd, trans->readLength, true);
+    }
+
+    dma_channel_config txConfig = dma_channel_get_default_config(txChannel);
+    channel_config_set_transfer_data_size(&txConfig, DMA_SIZE_32);
+    channel_config_set_read_increment(&txConfig, true);
+    channel_config_set_write_increment(&txConfig, false);
+    channel_config_set_dreq(&txConfig, DREQ_I2C0_TX + (2 * index));
+    dma_channel_configure(txChannel, &txConfig, &hw->data_cmd, commands, count, true);
+
+    return I2C_TRANSPORT_SUCCESS;
+}
+
+/**
+ * \brief Checks on the active transaction, reporting it to the owner if the bus is done with it
+ *
+ * \note Run from the I2C interrupt, but can also be polled
+ */
+void I2CTransport::service() {
+    uint32_t interruptState = save_and_disable_interrupts();
+
+    if (active != nullptr) {
+        i2c_hw_t* hw = i2c_get_hw(instance);
+        uint32_t raw = hw->raw_intr_stat;
+
+        if ((raw & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) != 0) {
+            // Device didn't acknowledge, flush out the rest of the transaction
+            (void)hw->clr_tx_abrt;
+            dma_channel_abort(txChannel);
+            if (active->readLength > 0) dma_channel_abort(rxChannel);
+            aborted = true;
+        }
+
+        if ((raw & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) != 0) {
+            (void)hw->clr_stop_det;
+
+            // The last read byte arrives just before the stop, make sure it was moved
+            if (!aborted && (active->readLength > 0)) dma_channel_wait_for_finish_blocking(rxChannel);
+
+            I2CTransaction* trans = active;
+            active = nullptr;
+            hw->intr_mask = 0;
+
+            // Owner may start the next transaction from within the handler
+            if (completionHandler != nullptr) 
+                completionHandler(completionOwner, trans, aborted ? I2C_TRANSPORT_FAIL : I2C_TRANSPORT_SUCCESS);
+        }
+    }
+
+    restore_interrupts(interruptState);
+}
+
+/**
+ * \brief Checks if a transaction is in progress
+ */
+bool I2CTransport::busy() {
+    return active != nullptr;
+}
+
+void I2CTransport::irqHandler0() {
+    if (irqOwner[0] != nullptr) irqOwner[0]->service();
+}
+
+void I2CTransport::irqHandler1() {
+    if (irqOwner[1] != nullptr) irqOwner[1]->service();
+}
@@ -0,0 +1,84 @@
+#ifndef I2C_TRANSPORT_HEADER
+#define I2C_TRANSPORT_HEADER
+
+#include <Arduino.h>
+#include "hardware/i2c.h"
+
+/* Non-blocking I2C transport for the RP2040
+
+    Runs transactions through the RP2040 I2C peripheral using DMA, so the
+    CPU is free while the LED drivers and touch sensor are being talked
+    to. One DMA channel feeds the command FIFO (data and read requests)
+    while another drains read data into the caller's buffer.
+
+    Only one transaction is handled at a time, queuing and deciding what
+    runs next is left to the owner (the bus manager) which is told of
+    each completion through a handler run from the I2C interrupt.
+
+    The peripheral (pins, clock) is expected to have already been set up
+    by `TwoWire::begin()`, this only takes over moving the data.
+*/
+
+extern const int I2C_TRANSPORT_FAIL;
+extern const int I2C_TRANSPORT_SUCCESS;
+
+struct I2CTransaction;
+typedef void (*I2CCallback)(struct I2CTransaction* trans);
+typedef void (*I2CCompletionHandler)(void* owner, struct I2CTransaction* trans, int status);
+
+struct I2CTransaction {
+    uint8_t address = 0;                // Seven bit device address
+    const uint8_t* writeData = nullptr; // Bytes to write, sent before any reading
+    uint8_t writeLength = 0;
+    uint8_t* readData = nullptr;        // Location to record read bytes
+    uint8_t readLength = 0;
+
+    I2CCallback callback = nullptr;     // Run on completion (from interrupt)
+    void* context = nullptr;            // Free for use by the submitter, typically the device object
+
+    volatile bool pending = false;      // True while queued or in progress
+    volatile int status = 0;            // Result once no longer pending
+    uint8_t retries = 2;                // Extra attempts made if it fails before reporting the failure
+
+    // Scheduling details, filled in by the bus manager
+    uint8_t device = 0;                 // Device index for statistics
+    uint8_t priority = 0;               // Queue the transaction is in
+    uint8_t bypassed = 0;               // Times it has been passed over for higher priority traffic
+    uint8_t attempts = 0;               // Failed attempts so far
+    unsigned long queuedUS = 0;         // When it was queued (`micros()`)
+    unsigned long startedUS = 0;        // When it was put on the bus (`micros()`)
+    I2CTransaction* chained = nullptr;  // Run immediately after this one, skipping the queues
+};
+
+class I2CTransport {
+private:
+    static const uint_fast16_t MAX_COMMANDS = 64;   // Maximum bytes (written and read) in one transaction
+
+    i2c_inst_t* instance;
+    int txChannel = -1; // DMA channel feeding the command FIFO
+    int rxChannel = -1; // DMA channel draining read data
+
+    I2CTransaction* volatile active = nullptr;
+    volatile bool aborted = false;
+    uint32_t clock = 0; // Bus clock currently set on the peripheral (Hz)
+
+    uint32_t commands[MAX_COMMANDS]; // Commands for the active transaction
+
+    I2CCompletionHandler completionHandler = nullptr;
+    void* completionOwner = nullptr;
+
+    static I2CTransport* irqOwner[2];
+    static void irqHandler0();
+    static void irqHandler1();
+
+public:
+    I2CTransport(i2c_inst_t* inst);
+
+    int initialize(I2CCompletionHandler handler, void* owner);
+    int start(I2CTransaction* trans, uint32_t clk);
+    void service();
+
+    bool busy();
+};
+
+#endif
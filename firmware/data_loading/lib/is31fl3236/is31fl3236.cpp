@@ -1,27 +1,45 @@
 #include <Arduino.h>
 
+#include "i2c_bus.hpp"
 #include "is31fl3236.hpp"
 
 const int IS31_TRANSFER_FAIL = -1;
 const int IS31_TRANSFER_SUCCESS = 0;
 
+// Bus cost of opening a transaction (address and register bytes, plus about a byte for start/stop)
+const uint_fast8_t IS31_TRANSACTION_OVERHEAD = 3;
+
+// Most PWM channels sent in a single transaction (about 0.5 ms at 400 kHz)
+// Limits how long other devices (touch) can be held off the shared bus by a frame update
+const uint_fast8_t IS31_MAX_BURST = 18;
+
+// Fastest bus clock supported by the IS31FL3236 (fast mode plus)
+const uint32_t IS31_MAX_CLOCK = 1000000;
+
+// Consecutive failed duty updates before the driver is considered to need reinitializing
+const uint_fast8_t IS31_FAILED_FRAMES_BEFORE_REINIT = 3;
+
 /**
  * \brief Sets a single register's value on the IS31FL3236
  * 
  * \param reg Register address to write to
  * \param val New value to write to the register
+ * \param priority Priority of the transfer on the shared bus
  * \return Return status of the transfer 
  */
-int IS31FL3236::writeSingleRegister(RegistersIS31FL3236 reg, uint8_t val) {
-    uint8_t count = 0;
+int IS31FL3236::writeSingleRegister(RegistersIS31FL3236 reg, uint8_t val, PriorityI2C priority) {
+    // Configuration goes through the shadow to skip writes that wouldn't change anything
+    if (shadow.tracks(reg)) {
+        checkShadow();
+        shadow.stage(reg, val);
+        if (batchConfig) return IS31_TRANSFER_SUCCESS;
+        return flushConfig();
+    }
 
-    interface->beginTransmission(ADDRESS); 
-    count = interface->write(reg);
-    count = count + interface->write(val);
-    interface->endTransmission();
+    uint8_t data[] = {reg, val};
 
-    // Check if both fields were communicated correctly
-    if (count == 2) return IS31_TRANSFER_SUCCESS;
+    if (bus->write(busDevice, data, 2, priority) == I2C_BUS_SUCCESS) return IS31_TRANSFER_SUCCESS;
+    errorCount++;
     return IS31_TRANSFER_FAIL;
 }
 
@@ -52,7 +70,15 @@ void IS31FL3236::hardwareShutdown(bool shutdown) {
  * \note All registers will return to defaults afterwards
  */
 int IS31FL3236::softwareReset() {
-    return writeSingleRegister(RegistersIS31FL3236::RESET, 0x00);
+    if (writeSingleRegister(RegistersIS31FL3236::RESET, 0x00) == IS31_TRANSFER_FAIL) {
+        resyncShadow(); // Unknown if the reset happened
+        return IS31_TRANSFER_FAIL;
+    }
+
+    // Everything is back to zero
+    shadow.reset(0x00);
+    for (uint_fast8_t i = 0; i < 36; i++) prevDuties[i] = 0;
+    return IS31_TRANSFER_SUCCESS;
 }
 
 /**
@@ -62,6 +88,7 @@ int IS31FL3236::softwareReset() {
  * \return Return status of the transfer 
  */
 int IS31FL3236::setPWMfrequency(FrequencyIS31FL3236 freq) {
+    pwmFrequency = freq;
     return writeSingleRegister(RegistersIS31FL3236::FREQUENCY, freq);
 }
 
@@ -74,6 +101,7 @@ int IS31FL3236::setPWMfrequency(FrequencyIS31FL3236 freq) {
  * \return Return status of the transfer 
  */
 int IS31FL3236::globalEnable(bool en) {
+    globalEnabled = en;
     if (en) return writeSingleRegister(RegistersIS31FL3236::CTRL_GLOBAL, 0x00);
     else return writeSingleRegister(RegistersIS31FL3236::CTRL_GLOBAL, 0x01);
 }
@@ -85,64 +113,564 @@ int IS31FL3236::globalEnable(bool en) {
  * \return Return status of the transfer 
  */
 int IS31FL3236::updateChannelConfigurations() {
-    uint_fast8_t count = 0;
-
-    interface->beginTransmission(ADDRESS); 
+    checkShadow();
+    stageChannelControls();
 
-    // Start at channel 0 and use sequential write
-    count = interface->write(RegistersIS31FL3236::CTRL_00);
+    if (batchConfig) return IS31_TRANSFER_SUCCESS;
+    return flushConfig();
+}
 
+/**
+ * \brief Stages the channel controls from `channelConfig`, only those that changed are left to be sent
+ */
+void IS31FL3236::stageChannelControls() {
     for (uint_fast8_t i = 0; i < 36; i++) {
-        uint8_t temp = (channelConfig[i].currentLimit << 1) + channelConfig[i].state;
-        count = count + interface->write(temp);
+        shadow.stage(RegistersIS31FL3236::CTRL_00 + i, (channelConfig[i].currentLimit << 1) + channelConfig[i].state);
     }
-    interface->endTransmission();
+}
+
+/**
+ * \brief Holds configuration writes so changes from several calls are sent together by `endConfigBatch`
+ * 
+ * \note Configuration calls return success while held, the result of sending them comes from `endConfigBatch`
+ */
+void IS31FL3236::beginConfigBatch() {
+    batchConfig = true;
+}
+
+/**
+ * \brief Sends all configuration changes held since `beginConfigBatch`
+ * 
+ * \return Return status of the transfers
+ */
+int IS31FL3236::endConfigBatch() {
+    batchConfig = false;
+    return flushConfig();
+}
 
-    // Check if all fields were communicated correctly (36 channels and the starting address)
-    if (count != 37) return IS31_TRANSFER_FAIL;
+/**
+ * \brief Writes the changed configuration registers, latching them if anything was sent
+ * 
+ * \return Return status of the transfers
+ */
+int IS31FL3236::flushConfig() {
+    uint_fast8_t written = 0;
+    int result = IS31_TRANSFER_SUCCESS;
+
+    if (shadow.flush(bus, busDevice, PriorityI2C::PRIO_BACKGROUND, &written) == SHADOW_TRANSFER_FAIL) {
+        errorCount++;
+        result = IS31_TRANSFER_FAIL;
+    }
 
     // Then write to move the values into the hardware
-    return writeSingleRegister(RegistersIS31FL3236::PWM_UPDATE, 0x00);
+    if (written > 0) {
+        if (writeSingleRegister(RegistersIS31FL3236::PWM_UPDATE, 0x00) == IS31_TRANSFER_FAIL) result = IS31_TRANSFER_FAIL;
+    }
+    return result;
+}
+
+/**
+ * \brief Forgets the recorded register state so everything is sent again
+ * 
+ * \note Registers can't be read back so this can't rebuild the shadow from the hardware
+ * \note Use when the chip may have been reset or lost power
+ */
+void IS31FL3236::resyncShadow() {
+    configSuspect = false;
+    shadow.invalidate();
+    forceNextUpdate = true;
+}
+
+/**
+ * \brief Handles a failed asynchronous transfer leaving the shadow unreliable
+ */
+void IS31FL3236::checkShadow() {
+    if (!configSuspect) return;
+    configSuspect = false;
+    shadow.invalidate();
+}
+
+/**
+ * \brief Plans which contiguous spans of PWM duties need to be sent
+ * 
+ * \param forceUpdate Plan to send every channel regardless of previous state
+ * \return Number of spans to send, zero if no update is needed
+ * 
+ * \note A full rewrite is planned as a single span covering all channels
+ */
+uint_fast8_t IS31FL3236::planDutySpans(bool forceUpdate) {
+    /*  Dirty span selection
+
+        Changed channels are gathered into contiguous spans, each sent as its own burst. Every 
+        burst costs the address and register bytes plus the start/stop conditions on top of its
+        data, so spans separated by a few unchanged channels are merged since resending those 
+        channels is cheaper than opening another transaction. 
+        
+        The total cost of the spans is then compared to that of a full rewrite (which includes 
+        the latch for free since `PWM_UPDATE` directly follows `PWM_35`) and the cheaper is used.
+    */
+    const uint_fast8_t FULL_COST = IS31_TRANSACTION_OVERHEAD + 36 + 1; // All channels and the latch
+    uint_fast8_t cost = 0;
+
+    numSpans = 0;
+
+    if (!forceUpdate) {
+        for (uint_fast8_t i = 0; i < 36; i++) {
+            if (prevDuties[i] == duty[i]) continue;
+
+            // Extend the previous span if the gap is cheaper to resend than a new transaction
+            if ((numSpans > 0) && ((i - spanEnd[numSpans - 1]) <= (IS31_TRANSACTION_OVERHEAD + 1))) {
+                cost = cost + (i - spanEnd[numSpans - 1]);
+                spanEnd[numSpans - 1] = i;
+            }
+            else {
+                spanStart[numSpans] = i;
+                spanEnd[numSpans] = i;
+                numSpans++;
+                cost = cost + IS31_TRANSACTION_OVERHEAD + 1;
+            }
+        }
+        if (numSpans == 0) return 0; // No update needed
+
+        // Account for the latch, appended if the last span reaches it or sent on its own
+        if (spanEnd[numSpans - 1] == 35) cost = cost + 1;
+        else cost = cost + IS31_TRANSACTION_OVERHEAD + 1;
+    }
+
+    if (forceUpdate || (cost >= FULL_COST)) {
+        spanStart[0] = 0;
+        spanEnd[0] = 35;
+        numSpans = 1;
+    }
+    return numSpans;
+}
+
+/**
+ * \brief Prepares the data for a burst of PWM duties, recording them as sent
+ * 
+ * \param buf Location to build the burst, needs room for the channels and two more bytes
+ * \param first First channel of the burst
+ * \param last Last channel of the burst (inclusive)
+ * \param latch Append a write to `PWM_UPDATE` after the burst, only valid if the burst ends at channel 35
+ * \return Number of bytes in the burst
+ */
+uint_fast8_t IS31FL3236::stageDutyBurst(uint8_t* buf, uint_fast8_t first, uint_fast8_t last, bool latch) {
+    uint_fast8_t len = 0;
+
+    // Start at the first channel and use sequential write
+    buf[len++] = RegistersIS31FL3236::PWM_00 + first;
+
+    for (uint_fast8_t i = first; i <= last; i++) {
+        buf[len++] = duty[i];
+        prevDuties[i] = duty[i];
+    }
+    if (latch) buf[len++] = 0x00; // Write to the PWM update register to have values reflected in hardware
+
+    return len;
 }
 
 /**
  * \brief Updates the PWM duty for each channel
- * \note Tries to avoid redundant updates by tracking previous state and not updating if no changes occur.
+ * \note Tries to avoid redundant updates by tracking previous state and only sending the channels that changed.
  * 
- * \param forceUpdate Forces the driver to update duties regardless of previous state
+ * \param forceUpdate Forces the driver to update all duties regardless of previous state
  * 
  * \note This only updates the PWM duties, it will not update channel configuration. `updateChannelConfigurations` is for that.
  * \return Return status of the transfer 
  */
 int IS31FL3236::updateDuties(bool forceUpdate) {
-    uint_fast8_t count = 0;
+    frameBytes = 0;
+    if (planDutySpans(forceUpdate || forceNextUpdate) == 0) return IS31_TRANSFER_SUCCESS;
+    forceNextUpdate = false;
 
-    if (!forceUpdate) {
-        // Check if an update is needed by counting new values
-        for (uint_fast8_t i = 0; i < 36; i++) {
-            if (prevDuties[i] != duty[i]) count++;
+    int result = IS31_TRANSFER_SUCCESS;
+    bool latchAppended = spanEnd[numSpans - 1] == 35;
+
+    // Send spans in bursts no longer than the limit to share the bus
+    for (uint_fast8_t s = 0; s < numSpans; s++) {
+        for (uint_fast8_t first = spanStart[s]; first <= spanEnd[s]; first = first + IS31_MAX_BURST) {
+            uint_fast8_t last = first + IS31_MAX_BURST - 1;
+            if (last > spanEnd[s]) last = spanEnd[s];
+
+            uint8_t data[IS31_MAX_BURST + 2];
+            uint_fast8_t len = stageDutyBurst(data, first, last, latchAppended && (last == 35));
+
+            if (bus->write(busDevice, data, len, PriorityI2C::PRIO_STREAM) == I2C_BUS_FAIL) {
+                errorCount++;
+                result = IS31_TRANSFER_FAIL;
+                forceNextUpdate = true; // Hardware no longer matches what was recorded as sent
+            }
+            frameBytes = frameBytes + len + 1; // Include the device address byte
         }
-        if (count == 0) return IS31_TRANSFER_SUCCESS;
     }
 
-    interface->beginTransmission(ADDRESS); 
+    // Latch once all spans are sent if it wasn't appended to the last one
+    if (!latchAppended) {
+        if (writeSingleRegister(RegistersIS31FL3236::PWM_UPDATE, 0x00, PriorityI2C::PRIO_STREAM) == IS31_TRANSFER_FAIL) 
+            result = IS31_TRANSFER_FAIL;
+        frameBytes = frameBytes + 3; // Address, register, and value
+    }
 
-    // Start at channel 0 and use sequential write
-    count = interface->write(RegistersIS31FL3236::PWM_00);
+    totalBytes = totalBytes + frameBytes;
+    totalFrames++;
 
-    for (uint_fast8_t i = 0; i < 36; i++) {
-        count = count + interface->write(duty[i]);
-        prevDuties[i] = duty[i];
+    if (result == IS31_TRANSFER_FAIL) failedFrames++;
+    else failedFrames = 0;
+    return result;
+}
+
+/**
+ * \brief Records the completion of one of the driver's asynchronous transactions
+ * 
+ * \param trans Completed transaction, context is the driver
+ * 
+ * \note Run from interrupt
+ */
+void IS31FL3236::asyncComplete(I2CTransaction* trans) {
+    IS31FL3236* driver = (IS31FL3236*)trans->context;
+
+    if (trans->status != I2C_TRANSPORT_SUCCESS) {
+        driver->asyncResult = IS31_TRANSFER_FAIL;
+        driver->forceNextUpdate = true; // Hardware no longer matches what was recorded as sent
+        driver->configSuspect = true;
+        driver->errorCount++;
     }
-    count = count + interface->write(0x00); // Write to the PWM update register to have values reflected in hardware
-    interface->endTransmission();
+    driver->asyncRemaining--;
+
+    if (driver->asyncRemaining == 0) {
+        if (driver->asyncResult == IS31_TRANSFER_FAIL) driver->failedFrames++;
+        else if (!driver->latchSeparate) driver->failedFrames = 0; // Otherwise left to `recordLatch`
+    }
+
+    if ((driver->asyncRemaining == 0) && (driver->idleHandler != nullptr)) driver->idleHandler(driver->idleContext);
+}
 
-    // Check if all fields were communicated correctly (36 channels and the starting address)
-    if (count == 38) return IS31_TRANSFER_SUCCESS;
+/**
+ * \brief Queues a transaction using one of the driver's asynchronous slots
+ * 
+ * \param slot Index of the transaction slot to use
+ * \param data Data to send, starting with the register address
+ * \param len Number of bytes to send
+ * \return Return status of the queuing
+ */
+int IS31FL3236::submitAsync(uint_fast8_t slot, const uint8_t* data, uint_fast8_t len) {
+    I2CTransaction* trans = &asyncTransactions[slot];
+    trans->device = busDevice;
+    trans->writeData = data;
+    trans->writeLength = len;
+    trans->readData = nullptr;
+    trans->readLength = 0;
+    trans->callback = asyncComplete;
+    trans->context = this;
+
+    // Count it before queuing since it may complete immediately, interrupts also modify the count
+    noInterrupts();
+    asyncRemaining++;
+    interrupts();
 
+    if (bus->submit(trans, PriorityI2C::PRIO_STREAM) == I2C_BUS_SUCCESS) {
+        frameBytes = frameBytes + len + 1; // Include the device address byte
+        return IS31_TRANSFER_SUCCESS;
+    }
+
+    noInterrupts();
+    asyncRemaining--;
+    interrupts();
+    asyncResult = IS31_TRANSFER_FAIL;
+    forceNextUpdate = true;
+    configSuspect = true;
     return IS31_TRANSFER_FAIL;
 }
 
+/**
+ * \brief Queues an update of the PWM duties without waiting for it to complete
+ * 
+ * \param forceUpdate Forces the driver to update all duties regardless of previous state
+ * 
+ * \note The duties are copied when queued so `duty` can be modified immediately afterwards
+ * \note Channel controls changed in `channelConfig` are sent along with the duties, see `queueControls`
+ * \note Fails if a previous asynchronous update is still in progress
+ * \return Return status of the queuing, use `asyncBusy` and `asyncStatus` to follow the transfer
+ */
+int IS31FL3236::updateDutiesAsync(bool forceUpdate) {
+    return queueDuties(forceUpdate, true);
+}
+
+/**
+ * \brief Queues the PWM duties without latching them to the outputs
+ * 
+ * \param forceUpdate Forces the driver to update all duties regardless of previous state
+ * 
+ * \note The new duties only show once `PWM_UPDATE` is written, see `prepareLatch`
+ * \note Channel controls changed in `channelConfig` are sent along with the duties, see `queueControls`
+ * \note Fails if a previous asynchronous update is still in progress
+ * \return Return status of the queuing, use `asyncBusy` and `asyncStatus` to follow the transfer
+ */
+int IS31FL3236::uploadDutiesAsync(bool forceUpdate) {
+    return queueDuties(forceUpdate, false);
+}
+
+/**
+ * \brief Queues the channel controls that changed since they were last sent
+ * 
+ * \param slot Next free transaction slot, moved on if the controls are queued
+ * \param used Bytes of the staging buffer in use, moved on if the controls are queued
+ * \return Return status of the queuing
+ * 
+ * \note Sent as a single write from the first to the last changed control, those between are resent as known
+ * \note The controls only take effect with the next write to `PWM_UPDATE`, like the duties
+ */
+int IS31FL3236::queueControls(uint_fast8_t* slot, uint_fast8_t* used) {
+    checkShadow();
+    stageChannelControls();
+
+    bool changed = false;
+    uint8_t first = 0;
+    uint8_t last = 0;
+    uint8_t runFirst = 0;
+    uint8_t runLast = 0;
+    uint8_t from = RegistersIS31FL3236::CTRL_00;
+    while ((from <= RegistersIS31FL3236::CTRL_35) && shadow.nextRun(from, &runFirst, &runLast) && 
+            (runFirst <= RegistersIS31FL3236::CTRL_35)) {
+        if (!changed) first = runFirst;
+        changed = true;
+        last = runLast;
+        if (last > RegistersIS31FL3236::CTRL_35) last = RegistersIS31FL3236::CTRL_35;
+        from = runLast + 1;
+    }
+    if (!changed) return IS31_TRANSFER_SUCCESS;
+
+    uint8_t* start = &asyncBuffer[*used];
+    uint_fast8_t len = 0;
+    start[len++] = first;
+    for (uint_fast8_t reg = first; reg <= last; reg++) start[len++] = shadow.get(reg);
+    *used = *used + len;
+
+    // Recorded as written now, a failure makes the whole shadow suspect
+    shadow.markWritten(first, last);
+    return submitAsync((*slot)++, start, len);
+}
+
+/**
+ * \brief Queues the changed channel controls and PWM duties
+ * 
+ * \param forceUpdate Forces the driver to update all duties regardless of previous state
+ * \param latch Also queue a write to `PWM_UPDATE` to have the changes reflected in hardware
+ * \return Return status of the queuing
+ */
+int IS31FL3236::queueDuties(bool forceUpdate, bool latch) {
+    if (asyncBusy()) return IS31_TRANSFER_FAIL;
+
+    frameBytes = 0;
+    asyncResult = IS31_TRANSFER_SUCCESS;
+    latchSeparate = !latch;
+    uint_fast8_t used = 0; // Bytes of the staging buffer in use
+    uint_fast8_t slot = 0;
+
+    // Controls go out with the duties so a channel's current limit and duty change on the same latch
+    if (queueControls(&slot, &used) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
+
+    uint_fast8_t spans = planDutySpans(forceUpdate || forceNextUpdate);
+    if ((spans == 0) && (slot == 0)) return IS31_TRANSFER_SUCCESS; // No update needed
+    if (spans > 0) forceNextUpdate = false;
+
+    bool latchAppended = latch && (spans > 0) && (spanEnd[numSpans - 1] == 35);
+
+    // Send spans in bursts no longer than the limit to share the bus
+    for (uint_fast8_t s = 0; s < spans; s++) {
+        for (uint_fast8_t first = spanStart[s]; first <= spanEnd[s]; first = first + IS31_MAX_BURST) {
+            uint_fast8_t last = first + IS31_MAX_BURST - 1;
+            if (last > spanEnd[s]) last = spanEnd[s];
+
+            uint8_t* start = &asyncBuffer[used];
+            uint_fast8_t len = stageDutyBurst(start, first, last, latchAppended && (last == 35));
+            used = used + len;
+
+            if (submitAsync(slot++, start, len) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
+        }
+    }
+
+    if (latch && !latchAppended) {
+        uint8_t* start = &asyncBuffer[used];
+        asyncBuffer[used++] = RegistersIS31FL3236::PWM_UPDATE;
+        asyncBuffer[used++] = 0x00;
+        if (submitAsync(slot, start, 2) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
+    }
+
+    totalBytes = totalBytes + frameBytes;
+    totalFrames++;
+    return IS31_TRANSFER_SUCCESS;
+}
+
+/**
+ * \brief Sets a function to be told when the driver's asynchronous transactions are all finished
+ * 
+ * \param handler Function to run, from interrupt, null to remove
+ * \param context Passed to the handler
+ */
+void IS31FL3236::setIdleHandler(IS31IdleHandler handler, void* context) {
+    noInterrupts();
+    idleHandler = handler;
+    idleContext = context;
+    interrupts();
+}
+
+/**
+ * \brief Fills in a transaction that latches uploaded PWM duties to the outputs
+ * 
+ * \param trans Transaction to prepare, the callback and context are left to the caller
+ */
+void IS31FL3236::prepareLatch(I2CTransaction* trans) {
+    static const uint8_t LATCH[] = {RegistersIS31FL3236::PWM_UPDATE, 0x00};
+
+    trans->device = busDevice;
+    trans->writeData = LATCH;
+    trans->writeLength = 2;
+    trans->readData = nullptr;
+    trans->readLength = 0;
+}
+
+/**
+ * \brief Records the result of latching duties uploaded by `uploadDutiesAsync`, finishing the frame
+ * 
+ * \param success If the latch was written
+ * 
+ * \note A failed latch counts towards reinitializing the chip like a failed upload, see `needsReinitialize`
+ * \note Safe to call from interrupts (including transaction callbacks)
+ */
+void IS31FL3236::recordLatch(bool success) {
+    if (success) {
+        if (asyncResult == IS31_TRANSFER_SUCCESS) failedFrames = 0;
+        return;
+    }
+
+    if (asyncResult == IS31_TRANSFER_SUCCESS) failedFrames++; // A failed upload was already counted
+    asyncResult = IS31_TRANSFER_FAIL;
+    forceNextUpdate = true; // Uploaded duties aren't showing, so resend and latch them with the next frame
+    errorCount++;
+}
+
+/**
+ * \brief Queues an update of the channel settings without waiting for it to complete
+ * 
+ * \note Fails if a previous asynchronous update is still in progress
+ * \return Return status of the queuing, use `asyncBusy` and `asyncStatus` to follow the transfer
+ */
+int IS31FL3236::updateChannelConfigurationsAsync() {
+    if (asyncBusy()) return IS31_TRANSFER_FAIL;
+
+    asyncResult = IS31_TRANSFER_SUCCESS;
+    latchSeparate = false;
+
+    checkShadow();
+    stageChannelControls();
+
+    // Only the changed registers are sent, often nothing at all
+    uint_fast8_t used = 0;
+    uint_fast8_t slot = 0;
+    uint8_t first = 0;
+    uint8_t last = 0;
+    uint8_t from = 0;
+    const uint_fast8_t LAST_SLOT = (sizeof(asyncTransactions) / sizeof(asyncTransactions[0])) - 1; // Kept for the latch
+
+    while ((slot < LAST_SLOT) && shadow.nextRun(from, &first, &last)) {
+        uint_fast8_t len = last - first + 2; // Register address and values
+        if ((unsigned)(used + len + 2) > sizeof(asyncBuffer)) break; // Leave the rest (and room for the latch) for the next call
+
+        uint8_t* start = &asyncBuffer[used];
+        asyncBuffer[used++] = first;
+        for (uint_fast8_t reg = first; reg <= last; reg++) asyncBuffer[used++] = shadow.get(reg);
+
+        // Recorded as written now, a failure makes the whole shadow suspect
+        shadow.markWritten(first, last);
+        if (submitAsync(slot++, start, len) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
+        from = last + 1;
+    }
+    if (slot == 0) return IS31_TRANSFER_SUCCESS;
+
+    // Then write to move the values into the hardware
+    uint8_t* start = &asyncBuffer[used];
+    asyncBuffer[used++] = RegistersIS31FL3236::PWM_UPDATE;
+    asyncBuffer[used++] = 0x00;
+    return submitAsync(slot, start, 2);
+}
+
+/**
+ * \brief Checks if an asynchronous update is still in progress
+ */
+bool IS31FL3236::asyncBusy() {
+    return asyncRemaining != 0;
+}
+
+/**
+ * \brief Result of the last asynchronous update
+ * 
+ * \note Only meaningful once `asyncBusy` returns false
+ * \return Return status of the transfers 
+ */
+int IS31FL3236::asyncStatus() {
+    return asyncResult;
+}
+
+/**
+ * \brief Returns the number of bytes put on the bus by the last `updateDuties` call
+ * 
+ * \note Includes the device address byte of each transaction, zero if no update was needed
+ */
+uint_fast8_t IS31FL3236::getFrameBytes() {
+    return frameBytes;
+}
+
+/**
+ * \brief Returns the average number of bytes put on the bus per updated frame
+ * 
+ * \note Only frames that needed an update are counted
+ * \return Average bytes per frame since the statistics were last reset
+ */
+float IS31FL3236::getAverageFrameBytes() {
+    if (totalFrames == 0) return 0.0;
+    return (float)totalBytes / (float)totalFrames;
+}
+
+/**
+ * \brief Resets the accumulated bus usage statistics
+ */
+void IS31FL3236::resetBusStatistics() {
+    totalBytes = 0;
+    totalFrames = 0;
+}
+
+/**
+ * \brief Finds the fastest bus clock the driver reliably works at
+ * 
+ * \note Registers can't be read back, so the probe is a write of the update register checking for
+ *      acknowledgement, it only latches what the chip already holds
+ * \note Acknowledgement can't show duties corrupted on the way (a risk at 1 MHz), only a chip not answering
+ * \note DEBUG builds print the time to flush a full frame of duties at each rate up to the one chosen
+ * \return Return status of the negotiation
+ */
+int IS31FL3236::negotiateClock() {
+    const uint8_t data[] = {RegistersIS31FL3236::PWM_UPDATE, 0x00};
+    I2CTransaction probe;
+
+    probe.writeData = data;
+    probe.writeLength = sizeof(data);
+
+    if (bus->negotiateClock(busDevice, &probe) == I2C_BUS_FAIL) return IS31_TRANSFER_FAIL;
+
+#ifdef DEBUG
+    // Duties are all sent again once configured, so what this flushes (latched) is soon replaced
+    uint8_t frame[36 + 2];
+    I2CTransaction flush;
+    flush.device = busDevice;
+    flush.writeData = frame;
+    flush.writeLength = stageDutyBurst(frame, 0, 35, true);
+    bus->printTransferTimes(&flush);
+#endif
+
+    return IS31_TRANSFER_SUCCESS;
+}
+
 /**
  * \brief Starts the IS31FL3236 chip
  * 
@@ -153,17 +681,75 @@ int IS31FL3236::initialize() {
     pinMode(SHUTDOWN_PIN, OUTPUT);
     hardwareShutdown(false);
 
-    interface->begin(); // Begin I2C bus
-    interface->setClock(400000);
+    // Bus itself is started by its manager
+    busDevice = bus->registerDevice(ADDRESS, "IS31FL3236", IS31_MAX_CLOCK);
+    if (busDevice == I2CBusManager::NO_DEVICE) return IS31_TRANSFER_FAIL;
 
-    if (softwareShutdown(false) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
-    if (setPWMfrequency(FrequencyIS31FL3236::KHz_22) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
-    if (globalEnable(true) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
-    if (updateChannelConfigurations() == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
-    if (updateDuties(true) == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL; 
-    // Force an update of the LED duties since this might be after the microcontroller is rebooted but not the driver chips
+    // If anything fails the driver is left flagged to be reinitialized later, see `needsReinitialize`
+    failedFrames = IS31_FAILED_FRAMES_BEFORE_REINIT;
 
-    return IS31_TRANSFER_SUCCESS;
+    pwmFrequency = FrequencyIS31FL3236::KHz_22;
+    globalEnabled = true;
+    if (negotiateClock() == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
+    return configure();
+}
+
+/**
+ * \brief Sends the complete configuration and duties to the chip
+ * 
+ * \note Force an update of the LED duties since this might be after the microcontroller is rebooted but not the driver chips
+ * \return Return status of the transfers
+ */
+int IS31FL3236::configure() {
+    // Sent as one sequential write from the channel controls through the frequency, plus the shutdown
+    beginConfigBatch();
+    softwareShutdown(false);
+    setPWMfrequency(pwmFrequency);
+    globalEnable(globalEnabled);
+    updateChannelConfigurations();
+    if (endConfigBatch() == IS31_TRANSFER_FAIL) return IS31_TRANSFER_FAIL;
+
+    return updateDuties(true); // Clears the failed frames on success
+}
+
+/**
+ * \brief Brings the chip back to its expected state after a fault, without disturbing the rest of the system
+ * 
+ * \note Resends the settings from `channelConfig` and the last frequency and enable settings, then all duties
+ * \note Waits for any asynchronous update in progress
+ * \return Return status of the transfers
+ */
+int IS31FL3236::reinitialize() {
+    while (asyncBusy()) bus->service();
+
+    reinitializations++;
+    hardwareShutdown(false); // In case the pin was disturbed
+    resyncShadow(); // Chip state is unknown, send everything
+
+    if (configure() == IS31_TRANSFER_SUCCESS) return IS31_TRANSFER_SUCCESS;
+    failedFrames = IS31_FAILED_FRAMES_BEFORE_REINIT; // Keep it flagged for another attempt
+    return IS31_TRANSFER_FAIL;
+}
+
+/**
+ * \brief Checks if enough consecutive updates failed that the chip should be reinitialized
+ */
+bool IS31FL3236::needsReinitialize() {
+    return failedFrames >= IS31_FAILED_FRAMES_BEFORE_REINIT;
+}
+
+/**
+ * \brief Returns the number of failed transfers since start up (after any retries)
+ */
+unsigned long IS31FL3236::getErrorCount() {
+    return errorCount;
+}
+
+/**
+ * \brief Returns the number of times the chip has been reinitialized since start up
+ */
+unsigned long IS31FL3236::getReinitializationCount() {
+    return reinitializations;
 }
 
 /**
@@ -171,9 +757,13 @@ int IS31FL3236::initialize() {
  * 
  * \param add I2C address
  * \param shtdn Shutdown pin address
- * \param bus Pointer to I2C bus for the drivers
+ * \param i2c Pointer to the manager of the I2C bus for the drivers
  */
-IS31FL3236::IS31FL3236(uint8_t add, pin_size_t shtdn, TwoWire* bus) 
+IS31FL3236::IS31FL3236(uint8_t add, pin_size_t shtdn, I2CBusManager* i2c) 
                         :ADDRESS(add), SHUTDOWN_PIN(shtdn) {
-    interface = bus;
+    bus = i2c;
+
+    // Configuration registers that hold what is written to them
+    shadow.track(RegistersIS31FL3236::SHUTDOWN, RegistersIS31FL3236::SHUTDOWN);
+    shadow.track(RegistersIS31FL3236::CTRL_00, RegistersIS31FL3236::FREQUENCY);
 }
\ No newline at end of file
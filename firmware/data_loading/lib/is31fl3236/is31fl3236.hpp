@@ -2,7 +2,9 @@
 #define IS31FL3236_HEADER
 
 #include <Arduino.h>
-#include <Wire.h>
+
+#include "i2c_bus.hpp"
+#include "register_shadow.hpp"
 
 extern const int IS31_TRANSFER_FAIL;
 extern const int IS31_TRANSFER_SUCCESS;
@@ -108,6 +110,7 @@ enum RegistersIS31FL3236 : uint8_t {
     RESET       = 0x4F
 };
 
+typedef void (*IS31IdleHandler)(void* context);
 
 class IS31FL3236 {
 private: 
@@ -115,18 +118,72 @@ private:
     const pin_size_t SHUTDOWN_PIN;
     
     uint_fast8_t prevDuties[36] = {0}; // Records previous duties uploaded to LED drivers
-
-    TwoWire* interface;
-
-    int writeSingleRegister(RegistersIS31FL3236 reg, uint8_t val);
+    bool forceNextUpdate = false; // Set if the recorded duties may not match the hardware
+
+    // Last known state of the configuration registers, duties are tracked separately by `prevDuties`
+    RegisterShadow shadow;
+    bool batchConfig = false;               // Configuration writes are held until `endConfigBatch`
+    volatile bool configSuspect = false;    // An asynchronous transfer failed so the shadow may not match the hardware
+
+    // Settings to restore when reinitializing
+    FrequencyIS31FL3236 pwmFrequency = FrequencyIS31FL3236::KHz_3;
+    bool globalEnabled = true;
+
+    // Fault tracking
+    volatile uint_fast8_t failedFrames = 0;     // Consecutive duty updates that failed
+    volatile unsigned long errorCount = 0;      // Failed transfers since start up
+    unsigned long reinitializations = 0;
+
+    // Dirty spans of PWM duties planned for the current update
+    // Spans are only made when separated by enough unchanged channels so at most 8 fit
+    static const uint_fast8_t MAX_SPANS = 8;
+    uint_fast8_t spanStart[MAX_SPANS];
+    uint_fast8_t spanEnd[MAX_SPANS];
+    uint_fast8_t numSpans = 0;
+
+    uint_fast8_t frameBytes = 0;    // Bytes put on the bus by the last duty update
+    unsigned long totalBytes = 0;   // Bytes put on the bus by duty updates since statistics reset
+    unsigned long totalFrames = 0;  // Duty updates sent since statistics reset
+
+    I2CBusManager* bus;
+    uint8_t busDevice = I2CBusManager::NO_DEVICE;
+
+    // Asynchronous transfer resources
+    // A transaction for the channel controls, one per span, one more for a span split for being too long, and the latch
+    I2CTransaction asyncTransactions[MAX_SPANS + 3];
+    uint8_t asyncBuffer[(36 + 1) + 36 + (2 * MAX_SPANS) + 1];  // Staging for controls, duties, span addresses, and latch
+    volatile uint_fast8_t asyncRemaining = 0;       // Transactions of the current update yet to finish
+    volatile int asyncResult = 0;
+    volatile bool latchSeparate = false;    // Duties were uploaded to be latched elsewhere, which settles the frame
+
+    IS31IdleHandler idleHandler = nullptr; // Run (from interrupt) when all asynchronous transactions are finished
+    void* idleContext = nullptr;
+
+    int writeSingleRegister(RegistersIS31FL3236 reg, uint8_t val, PriorityI2C priority = PRIO_BACKGROUND);
+    uint_fast8_t planDutySpans(bool forceUpdate);
+    uint_fast8_t stageDutyBurst(uint8_t* buf, uint_fast8_t first, uint_fast8_t last, bool latch);
+    int negotiateClock();
+    int configure();
+    int flushConfig();
+    void checkShadow();
+    void stageChannelControls();
+
+    int submitAsync(uint_fast8_t slot, const uint8_t* data, uint_fast8_t len);
+    int queueControls(uint_fast8_t* slot, uint_fast8_t* used);
+    int queueDuties(bool forceUpdate, bool latch);
+    static void asyncComplete(I2CTransaction* trans);
 
 public:
-    IS31FL3236(uint8_t add, pin_size_t shtdn, TwoWire* bus);
+    IS31FL3236(uint8_t add, pin_size_t shtdn, I2CBusManager* i2c);
 
     struct ChannelIS31FL3236 channelConfig[36];
     uint8_t duty[36]; // PWM duty for each channel
 
     int initialize();
+    int reinitialize();
+    bool needsReinitialize();
+    unsigned long getErrorCount();
+    unsigned long getReinitializationCount();
     void hardwareShutdown(bool shutdown);
     int softwareShutdown(bool shutdown);
     int globalEnable(bool en);
@@ -135,7 +192,23 @@ public:
     int setPWMfrequency(FrequencyIS31FL3236 freq);
 
     int updateChannelConfigurations();
+    void beginConfigBatch();
+    int endConfigBatch();
+    void resyncShadow();
     int updateDuties(bool forceUpdate = false);
+
+    int updateDutiesAsync(bool forceUpdate = false);
+    int uploadDutiesAsync(bool forceUpdate = false);
+    int updateChannelConfigurationsAsync();
+    bool asyncBusy();
+    int asyncStatus();
+    void setIdleHandler(IS31IdleHandler handler, void* context);
+    void prepareLatch(I2CTransaction* trans);
+    void recordLatch(bool success);
+
+    uint_fast8_t getFrameBytes();
+    float getAverageFrameBytes();
+    void resetBusStatistics();
 };
 
 #endif
\ No newline at end of file
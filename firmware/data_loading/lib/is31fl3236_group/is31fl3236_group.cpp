@@ -0,0 +1,171 @@
+#include <Arduino.h>
+
+#include "i2c_bus.hpp"
+#include "is31fl3236.hpp"
+#include "is31fl3236_group.hpp"
+
+const int IS31_GROUP_TRANSFER_FAIL = -1;
+const int IS31_GROUP_TRANSFER_SUCCESS = 0;
+
+/**
+ * \brief Construct a new IS31FL3236Group object
+ * 
+ * \param drv Array of drivers in the group
+ * \param num Number of drivers in the array (at most 4)
+ * \param i2c Manager of the I2C bus the drivers are on
+ */
+IS31FL3236Group::IS31FL3236Group(IS31FL3236* drv, uint8_t num, I2CBusManager* i2c) {
+    drivers = drv;
+    numDrivers = (num < MAX_DRIVERS) ? num : MAX_DRIVERS;
+    bus = i2c;
+}
+
+/**
+ * \brief Has the group follow the drivers' uploads, call once the drivers are initialized
+ */
+void IS31FL3236Group::initialize() {
+    for (uint_fast8_t i = 0; i < numDrivers; i++) drivers[i].setIdleHandler(uploadsIdle, this);
+}
+
+/**
+ * \brief Checks if any driver is still uploading
+ */
+bool IS31FL3236Group::uploadsBusy() {
+    for (uint_fast8_t i = 0; i < numDrivers; i++) {
+        if (drivers[i].asyncBusy()) return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Queues the latches of all drivers with uploaded changes as one chain
+ * 
+ * \note Must be called with interrupts disabled
+ */
+void IS31FL3236Group::submitLatches() {
+    latchArmed = false;
+    latchesRemaining = numLatches;
+
+    if (bus->submitChain(latchChain, numLatches, PriorityI2C::PRIO_STREAM) == I2C_BUS_FAIL) {
+        // Uploaded duties stay in the drivers' registers, the drivers resend them to be latched with the next frame
+        for (uint_fast8_t i = 0; i < numLatches; i++) latchDrivers[i]->recordLatch(false);
+        latchResult = IS31_GROUP_TRANSFER_FAIL;
+        latchesRemaining = 0;
+        latchActive = false;
+    }
+}
+
+/**
+ * \brief Starts the latches once the last driver finishes uploading
+ * 
+ * \param context The group
+ * 
+ * \note Run from interrupt
+ */
+void IS31FL3236Group::uploadsIdle(void* context) {
+    IS31FL3236Group* group = (IS31FL3236Group*)context;
+
+    if (group->latchArmed && !group->uploadsBusy()) group->submitLatches();
+}
+
+/**
+ * \brief Records the completion of a latch, the frame is committed once all of them are finished
+ * 
+ * \param trans Completed transaction, context is the group
+ * 
+ * \note Only called once a latch is done with, after any retries
+ * \note Run from interrupt
+ */
+void IS31FL3236Group::latchComplete(I2CTransaction* trans) {
+    IS31FL3236Group* group = (IS31FL3236Group*)trans->context;
+    bool success = trans->status == I2C_TRANSPORT_SUCCESS;
+
+    group->latchDrivers[trans - group->latches]->recordLatch(success);
+    if (!success) group->latchResult = IS31_GROUP_TRANSFER_FAIL;
+
+    group->latchesRemaining--;
+    if (group->latchesRemaining > 0) return;
+
+    if (group->latchResult == IS31_GROUP_TRANSFER_SUCCESS) {
+        group->commitUS = micros();
+        group->commits++;
+    }
+    group->latchActive = false;
+}
+
+/**
+ * \brief Queues an update of the PWM duties of all drivers, shown together once all are uploaded
+ * 
+ * \param forceUpdate Forces the drivers to update all duties regardless of previous state
+ * 
+ * \note The duties are copied when queued so `duty` can be modified immediately afterwards
+ * \note Fails if the previous frame is still in progress, changes carry over to the next frame
+ * \return Return status of the queuing, use `asyncBusy` and `asyncStatus` to follow the transfer
+ */
+int IS31FL3236Group::updateDutiesAsync(bool forceUpdate) {
+    if (asyncBusy()) return IS31_GROUP_TRANSFER_FAIL;
+
+    int result = IS31_GROUP_TRANSFER_SUCCESS;
+    latchResult = IS31_GROUP_TRANSFER_SUCCESS;
+    numLatches = 0;
+
+    for (uint_fast8_t i = 0; i < numDrivers; i++) {
+        if (drivers[i].uploadDutiesAsync(forceUpdate) == IS31_TRANSFER_FAIL) result = IS31_GROUP_TRANSFER_FAIL;
+
+        // Only drivers that were sent something need latching
+        if (drivers[i].getFrameBytes() > 0) {
+            I2CTransaction* latch = &latches[numLatches];
+            drivers[i].prepareLatch(latch);
+            latch->callback = latchComplete;
+            latch->context = this;
+            latchDrivers[numLatches] = &drivers[i];
+            latchChain[numLatches++] = latch;
+        }
+    }
+    if (numLatches == 0) return result;
+
+    // Uploads may already be done, otherwise the last one to finish starts the latches
+    noInterrupts();
+    latchActive = true;
+    latchArmed = true;
+    if (!uploadsBusy()) submitLatches();
+    interrupts();
+
+    return result;
+}
+
+/**
+ * \brief Checks if a frame is still being uploaded or latched
+ */
+bool IS31FL3236Group::asyncBusy() {
+    return latchActive || uploadsBusy();
+}
+
+/**
+ * \brief Returns the result of the last frame once it is no longer busy
+ * 
+ * \return Return status of the transfers, fails if any upload or latch failed
+ */
+int IS31FL3236Group::asyncStatus() {
+    if (latchResult == IS31_GROUP_TRANSFER_FAIL) return IS31_GROUP_TRANSFER_FAIL;
+    for (uint_fast8_t i = 0; i < numDrivers; i++) {
+        if (drivers[i].asyncStatus() == IS31_TRANSFER_FAIL) return IS31_GROUP_TRANSFER_FAIL;
+    }
+    return IS31_GROUP_TRANSFER_SUCCESS;
+}
+
+/**
+ * \brief Returns when the last frame was committed (all drivers latched successfully)
+ * 
+ * \return Time of the commit in microseconds (`micros()`)
+ */
+unsigned long IS31FL3236Group::getCommitTime() {
+    return commitUS;
+}
+
+/**
+ * \brief Returns the number of frames committed since start up, frames with a failed latch aren't counted
+ */
+unsigned long IS31FL3236Group::getCommitCount() {
+    return commits;
+}
@@ -0,0 +1,71 @@
+#ifndef IS31FL3236_GROUP_HEADER
+#define IS31FL3236_GROUP_HEADER
+
+#include <Arduino.h>
+
+#include "i2c_bus.hpp"
+#include "is31fl3236.hpp"
+
+/* Group of IS31FL3236 drivers showing frames together
+
+    Each driver only shows new PWM duties once its `PWM_UPDATE` register
+    is written, so latching each driver as part of its own upload makes
+    the first driver show a frame roughly an upload earlier than the
+    next. This causes visible tearing at the seam between drivers in fast
+    effects.
+
+    The group instead uploads the duties to all drivers first, and once
+    all of them are done it latches every driver in a single chain of bus
+    transactions so nothing else gets on the bus between the latches. The
+    IS31FL3236 has no general call support so the latches can't be a
+    single broadcast write, but back to back they are only a few tens of
+    microseconds apart.
+
+    A frame is committed once every latch has finished. A latch that
+    fails is reported to its driver like a failed upload, so the duties
+    are resent and repeated failures get the driver reinitialized.
+*/
+
+extern const int IS31_GROUP_TRANSFER_FAIL;
+extern const int IS31_GROUP_TRANSFER_SUCCESS;
+
+class IS31FL3236Group {
+private:
+    static const uint_fast8_t MAX_DRIVERS = 4;
+
+    IS31FL3236* drivers;
+    uint_fast8_t numDrivers;
+    I2CBusManager* bus;
+
+    I2CTransaction latches[MAX_DRIVERS];
+    I2CTransaction* latchChain[MAX_DRIVERS];
+    IS31FL3236* latchDrivers[MAX_DRIVERS];  // Driver each latch is for
+    uint_fast8_t numLatches = 0;
+
+    volatile bool latchArmed = false;   // Uploads are queued and the latches should follow once they're done
+    volatile bool latchActive = false;  // Latches are queued or on the bus
+    volatile uint_fast8_t latchesRemaining = 0; // Latches yet to finish, including any being retried
+    volatile int latchResult = 0;
+
+    volatile unsigned long commitUS = 0;    // When the last frame was latched (`micros()`)
+    volatile unsigned long commits = 0;     // Frames latched
+
+    bool uploadsBusy();
+    void submitLatches();
+    static void uploadsIdle(void* context);
+    static void latchComplete(I2CTransaction* trans);
+
+public:
+    IS31FL3236Group(IS31FL3236* drv, uint8_t num, I2CBusManager* i2c);
+
+    void initialize();
+
+    int updateDutiesAsync(bool forceUpdate = false);
+    bool asyncBusy();
+    int asyncStatus();
+
+    unsigned long getCommitTime();
+    unsigned long getCommitCount();
+};
+
+#endif
@@ -1,8 +1,16 @@
 #include <Arduino.h>
+#include <new>
 
 #include "../../include/enumerators.h"
 #include "is31fl3236.hpp"
+#include "comet_animation.hpp"
 #include "led.hpp"
+#include "led_animation.hpp"
+#include "led_canvas.hpp"
+#include "led_compositor.hpp"
+#include "led_particles.hpp"
+#include "led_random.hpp"
+#include "render_profiler.hpp"
 
 /*  LED System Code
 
@@ -13,8 +21,8 @@
     LED banks).
 
     These functions are meant to work using a driver chip agnostic
-    system, writing to buffers in RAM which are then re-read by the 
-    drivers.
+    system, writing to buffers in RAM which are then converted into the
+    drivers' duty buffers in a single pass by `remapLED`.
 
     One major thing to note is the use of "gamma" levels. Since 
     human light perception is non-linear to achieve uniformly 
@@ -22,19 +30,28 @@
     a curve that better resembles a linear gradient to our eyes.
 
     All effect are calculated and "rendered" using these gamma levels.
+    Those that need finer steps, like slow fades at low brightness, can
+    add a fraction of a level which is dithered over successive frames.
 */
 
-const ledInd_t NUM_LED = 72;
-const ledInd_t NUM_ROW = 8;
-const ledInd_t NUM_COL = 30;
-
-ledlevel_t LEDlevel[NUM_LED] = {0}; // Actual LED brightness
-ledlevel_t LEDgamma[NUM_LED] = {0}; // Used to store LED gamma levels. Must be copied into actual buffer.
-ledInd_t LEDstartIndex[] = {0, 8, 38, 44};
-ledInd_t LEDmiddleIndex[] = {4, 23, 41, 58};
+const int LED_LAYER_FAIL = -1;
+const int LED_LAYER_SUCCESS = 0;
+
+LEDFrame LEDblended; // Frame shown while transitioning between effects
+LEDFrame LEDcomposite; // Frame shown while there are layers over the FSM's effect
+LEDFrame* LEDtarget = &LEDblended; // Frame the effects draw into
+ledlevel_t* LEDgamma = LEDblended.gamma; // Used to store LED gamma levels, those of `LEDtarget`
+const LEDFrame* LEDshown = &LEDblended; // Frame converted to duties by `remapLED`, set by the FSM
+bool LEDinverted = false; // Marks if the gamma levels are to be shown inverted, set by the FSM
+constexpr ledInd_t LEDstartIndex[] = {0, 8, 38, 44};
+constexpr ledInd_t LEDmiddleIndex[] = {4, 23, 41, 58};
 ledInd_t LEDbutton[] = {44, 42, 40, 38};
 
-const byte PWM_GAMMA[] = {
+ledFSMstates LEDstate = ledFSMstates::SOLID; // State of the LED FSM after its last execution
+
+const uint32_t LED_RANDOM_SEED = 0x4C454453UL; // Seed of the effects' random numbers, the same every start
+
+constexpr byte PWM_GAMMA[] = {
   0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,
   0x08,0x09,0x0b,0x0d,0x0f,0x11,0x13,0x16,
   0x1a,0x1c,0x1d,0x1f,0x22,0x25,0x28,0x2e,
@@ -44,23 +61,208 @@ const byte PWM_GAMMA[] = {
   0xac,0xb0,0xb9,0xbf,0xc6,0xcb,0xcf,0xd6,
   0xe1,0xe9,0xed,0xf1,0xf6,0xfa,0xfe,0xff
 }; // Gamma levels that are perceived as even steps in brightness
-// Number of perceptable "gamma" levels available
-const unsigned int NUM_GAMMA = sizeof(PWM_GAMMA) / sizeof(PWM_GAMMA[0]); 
+static_assert((sizeof(PWM_GAMMA) / sizeof(PWM_GAMMA[0])) == NUM_GAMMA, "Gamma table doesn't match `NUM_GAMMA`");
+
+constexpr uint8_t DITHER_BITS = 4; // Bits of duty kept below those sent to the drivers, made up for by dithering
+constexpr uint16_t DITHER_MASK = (1 << DITHER_BITS) - 1;
+uint8_t LEDdither[NUM_LED] = {0}; // Duty left over from previous frames for each LED, before the drivers' mapping
+
+constexpr uint16_t MAX_DUTY = 255 << DITHER_BITS; // Largest duty the drivers take (Q4)
+constexpr uint16_t CURRENT_DROP_DUTY = (MAX_DUTY * 7) / 8; // Duty an LED must fit under at a lower current to move to it (Q4)
+uint16_t LEDdimmer = 256; // Master dimmer for all LEDs (Q8, 256 being full brightness)
+
+/*  Geometry generation
+
+    Everything below is only evaluated by the compiler to fill in the
+    geometry table, none of it runs on the board.
+*/
+
+// Anchor locations in `LEDAnchor` order, each just before the LED given
+// The bottom left corner is moved back one for visuals (matching the sweep effects)
+constexpr ledInd_t GEOMETRY_ANCHOR[NUM_ANCHORS] = {
+    LEDstartIndex[0], LEDstartIndex[1], LEDstartIndex[2] - 1, LEDstartIndex[3],
+    LEDmiddleIndex[0] + 1, LEDmiddleIndex[1] + 1, LEDmiddleIndex[2] + 1, LEDmiddleIndex[3] + 1
+};
+// Corners in `LEDAnchor` order (column, row)
+constexpr ledInd_t GEOMETRY_CORNER[4][2] = {{NUM_COL - 1, NUM_ROW - 1}, {NUM_COL - 1, 0}, {0, 0}, {0, NUM_ROW - 1}};
+
+constexpr ledInd_t geometryRow(ledInd_t i) {
+    if (i < LEDstartIndex[1]) return (NUM_ROW - 1) - i;         // Right side
+    if (i < LEDstartIndex[2]) return 0;                         // Bottom row
+    if (i < LEDstartIndex[3]) return i - LEDstartIndex[2];      // Left side
+    return NUM_ROW - 1;                                         // Top row
+}
+
+constexpr ledInd_t geometryColumn(ledInd_t i) {
+    if (i < LEDstartIndex[1]) return NUM_COL - 1;                           // Right side
+    if (i < LEDstartIndex[2]) return (NUM_COL - 1) - (i - LEDstartIndex[1]);// Bottom row
+    if (i < LEDstartIndex[3]) return 0;                                     // Left side
+    return (i + 1) - LEDstartIndex[3]; // Top row, since it is a bit narrower the outer columns are skipped
+}
+
+constexpr float geometryAbs(float v) {
+    return (v < 0) ? -v : v;
+}
+
+constexpr float geometrySqrt(float v) {
+    if (v <= 0) return 0;
+    float root = v;
+    for (uint_fast8_t i = 0; i < 20; i++) root = 0.5f * (root + (v / root));
+    return root;
+}
+
+// Arctangent of `y / x` in turns (0 to 1), measured from the positive x direction towards positive y
+constexpr float geometryAtan2(float y, float x) {
+    if ((x == 0) && (y == 0)) return 0;
+
+    // Approximate in the first octant (good to about a quarter of a degree) and then unfold
+    float ax = geometryAbs(x);
+    float ay = geometryAbs(y);
+    float z = (ax > ay) ? (ay / ax) : (ax / ay);
+    float turns = z * (0.125f + (0.0434f * (1.0f - z)));
+    if (ay > ax) turns = 0.25f - turns;
+    if (x < 0) turns = 0.5f - turns;
+    if (y < 0) turns = 1.0f - turns;
+    return turns;
+}
+
+constexpr int8_t geometryAnchorOffset(ledInd_t i, ledInd_t anchor) {
+    ledInd_t ahead = (i - anchor + NUM_LED) % NUM_LED;
+    if (ahead < (NUM_LED / 2)) return ahead;
+    return ahead - NUM_LED;
+}
+
+constexpr LEDGeometry geometryOf(ledInd_t i) {
+    LEDGeometry led;
+    led.row = geometryRow(i);
+    led.col = geometryColumn(i);
+    led.x = (led.col * 255) / (NUM_COL - 1);
+    led.y = (led.row * 255) / (NUM_ROW - 1);
+
+    // Centre of the board, in terms of LED spacing
+    float dx = led.col - ((NUM_COL - 1) / 2.0f);
+    float dy = led.row - ((NUM_ROW - 1) / 2.0f);
+    led.angle = (uint8_t)((int)((geometryAtan2(dx, dy) * 256.0f) + 0.5f) & 0xFF); // Clockwise from up
+
+    for (uint_fast8_t c = 0; c < 4; c++) {
+        float cx = led.col - GEOMETRY_CORNER[c][0];
+        float cy = led.row - GEOMETRY_CORNER[c][1];
+        led.cornerDistance[c] = (uint8_t)((geometrySqrt((cx * cx) + (cy * cy)) * 8.0f) + 0.5f);
+    }
+
+    for (uint_fast8_t a = 0; a < NUM_ANCHORS; a++) led.anchorOffset[a] = geometryAnchorOffset(i, GEOMETRY_ANCHOR[a]);
+    return led;
+}
+
+struct LEDGeometryTable {
+    LEDGeometry led[NUM_LED];
+
+    constexpr LEDGeometryTable() : led() {
+        for (ledInd_t i = 0; i < NUM_LED; i++) led[i] = geometryOf(i);
+    }
+};
+
+constexpr LEDGeometryTable GEOMETRY_TABLE; // Stays in flash
+const LEDGeometry* const LEDgeometry = GEOMETRY_TABLE.led;
+
+/*  Output tables
+
+    Gamma levels are turned into PWM duties and placed in the right
+    driver channel in one pass using these tables, also generated by the
+    compiler. Gamma tables cover every possible level so out of range
+    levels are clamped by the table itself.
+
+    Duties are worked out with `DITHER_BITS` more precision than the
+    drivers take, interpolating linearly towards the next level by the
+    fraction. Each LED carries what is left below the drivers' precision
+    on to its next frame (error diffusion over time), so on average it
+    shows the finer duty.
+
+    Dim LEDs are moved to a lower current limit on the drivers with their
+    duty raised to match (twice the duty at half the current and so on),
+    giving them a finer range of duties to work with. An LED only drops
+    to a lower current once its duty fits comfortably under the limit so
+    it doesn't flip back and forth on every frame, the drivers are only
+    sent the current limits that change.
+*/
+
+struct LEDChannel {
+    uint8_t driver = 0;
+    uint8_t channel = 0;
+};
+
+struct LEDDutyStep {
+    uint16_t base = 0;                  // Duty of the level (Q4)
+    int16_t slope = 0;                  // Change in duty to the next level up, as shown (Q4)
+};
+
+/**
+ * \brief Finds where an LED is connected on the drivers
+ * 
+ * \note THIS MUST BE UPDATED WITH ANY HARDWARE CHANGES!
+ */
+constexpr LEDChannel outputChannelOf(ledInd_t i) {
+    LEDChannel out;
+    if (i < 6) {
+        out.driver = 0;
+        out.channel = 30 + i;
+    }
+    else if (i < 42) {
+        out.driver = 1;
+        out.channel = i - 6;
+    }
+    else {
+        out.driver = 0;
+        out.channel = i - 42;
+    }
+    return out;
+}
+
+struct LEDOutputTable {
+    LEDChannel channel[NUM_LED];
+    LEDDutyStep gamma[2][256]; // Duty for each gamma level, as is and inverted
+
+    constexpr LEDOutputTable() : channel(), gamma() {
+        for (ledInd_t i = 0; i < NUM_LED; i++) channel[i] = outputChannelOf(i);
+
+        for (unsigned int g = 0; g < 256; g++) {
+            unsigned int level = (g < NUM_GAMMA) ? g : (NUM_GAMMA - 1);
+            unsigned int inverted = (NUM_GAMMA - 1) - level;
+            gamma[0][g].base = PWM_GAMMA[level] << DITHER_BITS;
+            gamma[1][g].base = PWM_GAMMA[inverted] << DITHER_BITS;
+
+            // The top level has nowhere further to go
+            if (level < (NUM_GAMMA - 1)) {
+                gamma[0][g].slope = (PWM_GAMMA[level + 1] - PWM_GAMMA[level]) << DITHER_BITS;
+                gamma[1][g].slope = -((PWM_GAMMA[inverted] - PWM_GAMMA[inverted - 1]) << DITHER_BITS);
+            }
+        }
+    }
+};
+
+constexpr LEDOutputTable OUTPUT_TABLE; // Stays in flash
 
 /**
  * \brief Function to initialize the LEDs
  * 
  * \param drvrs Array of LED drivers
  * \note This is best called prior to the initialization the the drivers themselves
+ * \note Seeds the effects' random numbers, so must be called before any effect is started
  */
 void initializeLED(IS31FL3236 drvrs[]) {
+    // Effects play out the same from every start, so their timings can be compared between builds
+    seedEffectRandom(LED_RANDOM_SEED);
+
     for (ledInd_t i = 0; i < NUM_LED; i++) {
-        LEDlevel[i] = 0;
-        LEDgamma[i] = 0;
+        LEDblended.gamma[i] = 0;
+        LEDblended.fraction[i] = 0;
+        LEDdither[i] = 0;
     }
+    LEDblended.rotation = 0;
+    LEDshown = &LEDblended;
 
     // Configure the LED channels for each driver
-    // This is done if we want to dim one set of LEDs relative to the other
+    // The current limits set here are only until the first frame, they're then picked for each LED by `remapLED`
     ChannelIS31FL3236 forwardsLEDs; // Settings to use for the forward facing LEDs
     ChannelIS31FL3236 sidewaysLEDs; // Settings to use for the sideways facing LEDs
 
@@ -78,55 +280,384 @@ void initializeLED(IS31FL3236 drvrs[]) {
 }
 
 /**
- * \brief Maps the calculated LED values to the right hardware register
+ * \brief Converts the gamma levels into duties in the right hardware channels
  * 
  * \param drvrs The array of LED drivers
  * 
- * \note THIS MUST BE UPDATED WITH ANY HARDWARE CHANGES!
+ * \note Clamping, gamma correction, inversion, rotation, dimming, current scaling, dithering and channel mapping are 
+ * all done in one pass
+ * \note The mapping to channels is set by `outputChannelOf`, update it with any hardware changes
+ * \note Call once per frame sent to the drivers, dithering relies on every frame converted being shown
+ * \note Sets the current limits in the drivers' `channelConfig`, these go out with the duties
  * 
  * \warning This must be called so LED effects can be seen properly
  */
 void remapLED(IS31FL3236 drvrs[]) {
-    for (uint_fast8_t i = 0; i < 6; i++) {
-        drvrs[0].duty[30 + i] = LEDlevel[i];
-    }
-    for (uint_fast8_t i = 6; i < 42; i++) {
-        drvrs[1].duty[i - 6] = LEDlevel[i];
-    }
-    for (uint_fast8_t i = 42; i < 72; i++) {
-        drvrs[0].duty[i - 42] = LEDlevel[i];
+    const LEDDutyStep* steps = OUTPUT_TABLE.gamma[LEDinverted ? 1 : 0];
+    const ledlevel_t* levels = LEDshown->gamma;
+    const uint8_t* fractions = LEDshown->fraction;
+    uint8_t* duties[] = {drvrs[0].duty, drvrs[1].duty};
+    ChannelIS31FL3236* configs[] = {drvrs[0].channelConfig, drvrs[1].channelConfig};
+
+    // Rotating clockwise shows each LED the level from behind it
+    ledInd_t source = constrainIndex(-LEDshown->rotation);
+
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        const LEDChannel& out = OUTPUT_TABLE.channel[i];
+        const LEDDutyStep& step = steps[levels[source]];
+        uint32_t duty = step.base + ((step.slope * fractions[source]) >> 8); // At full current
+        duty = (duty * LEDdimmer) >> 8;
+
+        // Each setting below full current divides it by one more (half, third, quarter) so the duty is multiplied to match
+        uint8_t limit = configs[out.driver][out.channel].currentLimit;
+        while ((limit > CurrentSettingIS31FL3236::FULL) && ((duty * (limit + 1)) > MAX_DUTY)) limit--;
+        while ((limit < CurrentSettingIS31FL3236::QUARTER) && ((duty * (limit + 2)) <= CURRENT_DROP_DUTY)) limit++;
+        configs[out.driver][out.channel].currentLimit = (CurrentSettingIS31FL3236)limit;
+
+        duty = (duty * (limit + 1)) + LEDdither[i];
+        LEDdither[i] = duty & DITHER_MASK;
+        duties[out.driver][out.channel] = duty >> DITHER_BITS;
+
+        source++;
+        if (source == NUM_LED) source = 0;
     }
 }
 
 /**
- * \brief Rotates the LED brightness buffers
+ * \brief Sets the master dimmer, scaling the brightness of all LEDs
+ * 
+ * \param level Brightness (Q8, 256 being full brightness)
+ * 
+ * \note Applied to the duties, so it is smooth even where the gamma levels are coarse
+ */
+void setDimmerLED(uint16_t level) {
+    LEDdimmer = (level > 256) ? 256 : level;
+}
+
+/**
+ * \brief Sets the frame effects draw into
+ * 
+ * \param frame Frame to draw into
+ */
+void targetLED(LEDFrame* frame) {
+    LEDtarget = frame;
+    LEDgamma = frame->gamma;
+}
+
+/**
+ * \brief Rotates the targeted LED frame
  * 
  * \param amount Number of places to rotate LEDs by
  * \param clockwise Direction of rotation to take
+ * 
+ * \note Adds to any rotation already made, the LED levels themselves aren't moved
  */
 void rotateLED(ledInd_t amount, bool clockwise) {
     amount = constrainIndex(amount); // Limits rotation to under one rotation
-    if (amount == 0) return; // Return if no rotation is needed
 
-    ledlevel_t tempLevel[NUM_LED] = {0};
-    ledlevel_t tempGamma[NUM_LED] = {0};
-    for (ledInd_t i = 0; i < NUM_LED; i++) {
-        tempLevel[i] = LEDlevel[i];
-        tempGamma[i] = LEDgamma[i];
+    if (clockwise) LEDtarget->rotation = constrainIndex(LEDtarget->rotation + amount);
+    else LEDtarget->rotation = constrainIndex(LEDtarget->rotation - amount);
+}
+
+/**
+ * \brief Removes any rotation of the targeted LED frame
+ */
+void resetRotationLED() {
+    LEDtarget->rotation = 0;
+}
+
+/*  Effect registry
+
+    The render functions adapt the effects to the common form used by
+    the registry. Parameters come from each effect's table entry.
+*/
+
+/**
+ * \brief Resets an effect's state in the pool
+ */
+template <typename T, T EffectState::*member> void startEffect(EffectState* state) {
+    new (&(state->*member)) T();
+}
+
+ledlevel_t LEDsolidLevel = NUM_GAMMA / 2; // Level of the solid effect, kept between visits
+
+void renderSolid(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    // Inversion isn't allowed, using it for level control
+#ifdef DEBUG
+    ledlevel_t previousLevel = LEDsolidLevel;
+#endif
+    if (input.toggleUser && (LEDsolidLevel < (NUM_GAMMA - 1))) LEDsolidLevel++;
+    if (input.toggleInvert && (LEDsolidLevel > 0)) LEDsolidLevel--;
+    uniformLED(LEDsolidLevel);
+
+#ifdef DEBUG
+    // Brightness statements for debugging, only when it changes since this also renders as a layer and while fading out
+    if (LEDsolidLevel != previousLevel) {
+        SerialUSB.print("Gamma / PWM:\t");
+        SerialUSB.print(LEDsolidLevel);
+        SerialUSB.print("\t");
+        SerialUSB.println(PWM_GAMMA[LEDsolidLevel]);
     }
+#endif
+}
 
-    if (clockwise) {
-        for (ledInd_t i = 0; i < NUM_LED; i++) {
-            LEDlevel[i] = tempLevel[constrainIndex(i - amount)];
-            LEDgamma[i] = tempGamma[constrainIndex(i - amount)];
-        }
+void renderBreathing(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    breathingLED(&state->paced, input.elapsedUS, params.periodMS);
+}
+
+void renderSpinning(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    spinningLED(&state->spinning, input.elapsedUS, params.periodMS, input.userControl);
+}
+
+void renderSweep(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    sweepLED(&state->sweep, input.elapsedUS, params.periodMS, params.holdMS, input.toggleUser);
+}
+
+void renderSway(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    swayLED(&state->sweep, input.elapsedUS, params.periodMS, params.holdMS, input.toggleUser);
+}
+
+void renderPlasma(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    plasmaLED(&state->paced, input.elapsedUS, params.periodMS);
+}
+
+void renderAnimation(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    animationLED(&state->animation, input.elapsedUS, COMET_ANIMATION, COMET_ANIMATION_SIZE);
+}
+
+void renderWaveHor(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    waveHorLED(&state->waveHor, input.elapsedUS, params.periodMS, input.userControl);
+}
+
+void renderWaveVer(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    waveVerLED(&state->waveVer, input.elapsedUS, params.periodMS, input.userControl);
+}
+
+void renderCloud(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    cloudLED(&state->cloud, input.elapsedUS, params.periodMS);
+}
+
+void renderTracking(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    trackingLED(&state->tracking, input.elapsedUS, params.periodMS, params.holdMS, params.width, params.probability);
+}
+
+void renderBumps(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    bumpsLED(&state->bumps, input.elapsedUS, params.periodMS, params.count, params.probability);
+}
+
+void renderAudioUniform(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioUniformLED(&state->paced, input.elapsedUS, params.periodMS, input.lRMS, input.rRMS);
+}
+
+void renderAudioBalance(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioBalanceLED(&state->paced, input.elapsedUS, params.periodMS, input.lRMS, input.rRMS);
+}
+
+void renderAudioHoriSpectrum(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioHoriSpectrumLED(&state->paced, input.elapsedUS, params.periodMS, input.lMag, input.rMag, input.userControl);
+}
+
+void renderAudioSplitSpectrum(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioSplitSpectrumLED(&state->paced, input.elapsedUS, params.periodMS, input.lMag, input.rMag, input.userControl);
+}
+
+void renderAudioSplitSpectrumSpin(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioSplitSpectrumSpinLED(&state->paced, input.elapsedUS, params.periodMS, input.lMag, input.rMag, input.userControl);
+}
+
+void renderAudioVertVol(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioVertVolLED(&state->volume, input.elapsedUS, params.periodMS, input.lRMS, input.rRMS, input.userControl);
+}
+
+void renderAudioHoriVol(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioHoriVolLED(&state->volume, input.elapsedUS, params.periodMS, input.lRMS, input.rRMS, input.userControl);
+}
+
+void renderAudioHoriSplitVol(EffectState* state, const EffectInput& input, const EffectParameters& params) {
+    audioHoriSplitVolLED(&state->splitVolume, input.elapsedUS, params.periodMS, input.lRMS, input.rRMS);
+}
+
+constexpr EffectParameters effectPeriod(unsigned long periodMS, unsigned long holdMS = 0, 
+        uint8_t width = 0, uint8_t probability = 0, uint8_t count = 0) {
+    EffectParameters params;
+    params.periodMS = periodMS;
+    params.holdMS = holdMS;
+    params.width = width;
+    params.probability = probability;
+    params.count = count;
+    return params;
+}
+
+// Entries must be in `ledFSMstates` order, the cycle itself is set by the links
+constexpr EffectDescriptor EFFECTS[] = {
+    {ledFSMstates::SOLID, renderSolid, nullptr, effectPeriod(0),
+        AudioProcessing::NO_AUDIO, false, ledFSMstates::AUD_HORI_SPLIT_VOL, ledFSMstates::BREATH},
+    {ledFSMstates::BREATH, renderBreathing, startEffect<PacedState, &EffectState::paced>, effectPeriod(5000),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::SOLID, ledFSMstates::SPINNING},
+    {ledFSMstates::WAVE_VERT, renderWaveVer, startEffect<WaveVerState, &EffectState::waveVer>, effectPeriod(3000),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::WAVE_HORI, ledFSMstates::CLOUD},
+    {ledFSMstates::WAVE_HORI, renderWaveHor, startEffect<WaveHorState, &EffectState::waveHor>, effectPeriod(3000),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::ANIMATION, ledFSMstates::WAVE_VERT},
+    {ledFSMstates::CLOUD, renderCloud, startEffect<CloudState, &EffectState::cloud>, effectPeriod(8),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::WAVE_VERT, ledFSMstates::TRACKING},
+    {ledFSMstates::BUMPS, renderBumps, startEffect<BumpsState, &EffectState::bumps>, effectPeriod(10, 0, 0, 3, 3),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::TRACKING, ledFSMstates::AUD_UNI},
+    {ledFSMstates::TRACKING, renderTracking, startEffect<TrackingState, &EffectState::tracking>, effectPeriod(8, 500, 2, 5),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::CLOUD, ledFSMstates::BUMPS},
+    {ledFSMstates::SPINNING, renderSpinning, startEffect<SpinningState, &EffectState::spinning>, effectPeriod(5000),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::BREATH, ledFSMstates::SWEEP},
+    {ledFSMstates::SWEEP, renderSweep, startEffect<SweepState, &EffectState::sweep>, effectPeriod(500, 500),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::SPINNING, ledFSMstates::SWAY},
+    {ledFSMstates::SWAY, renderSway, startEffect<SweepState, &EffectState::sweep>, effectPeriod(500, 500),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::SWEEP, ledFSMstates::PLASMA},
+    {ledFSMstates::AUD_UNI, renderAudioUniform, startEffect<PacedState, &EffectState::paced>, effectPeriod(10),
+        AudioProcessing::RMS_ONLY, true, ledFSMstates::BUMPS, ledFSMstates::AUD_BALANCE},
+    {ledFSMstates::AUD_BALANCE, renderAudioBalance, startEffect<PacedState, &EffectState::paced>, effectPeriod(10),
+        AudioProcessing::RMS_ONLY, true, ledFSMstates::AUD_UNI, ledFSMstates::AUD_HORI_SPECTRUM},
+    {ledFSMstates::AUD_HORI_SPECTRUM, renderAudioHoriSpectrum, startEffect<PacedState, &EffectState::paced>, effectPeriod(10),
+        AudioProcessing::SPECTRUM, true, ledFSMstates::AUD_BALANCE, ledFSMstates::AUD_SPLIT},
+    {ledFSMstates::AUD_SPLIT, renderAudioSplitSpectrum, startEffect<PacedState, &EffectState::paced>, effectPeriod(10),
+        AudioProcessing::SPECTRUM, true, ledFSMstates::AUD_HORI_SPECTRUM, ledFSMstates::AUD_SPLIT_SPIN},
+    {ledFSMstates::AUD_SPLIT_SPIN, renderAudioSplitSpectrumSpin, startEffect<PacedState, &EffectState::paced>, effectPeriod(20),
+        AudioProcessing::SPECTRUM, true, ledFSMstates::AUD_SPLIT, ledFSMstates::AUD_VERT_VOL},
+    {ledFSMstates::AUD_HORI_VOL, renderAudioHoriVol, startEffect<VolumeState, &EffectState::volume>, effectPeriod(20),
+        AudioProcessing::RMS_ONLY, true, ledFSMstates::AUD_VERT_VOL, ledFSMstates::AUD_HORI_SPLIT_VOL},
+    {ledFSMstates::AUD_HORI_SPLIT_VOL, renderAudioHoriSplitVol, startEffect<SplitVolumeState, &EffectState::splitVolume>, effectPeriod(20),
+        AudioProcessing::RMS_ONLY, true, ledFSMstates::AUD_HORI_VOL, ledFSMstates::SOLID},
+    {ledFSMstates::AUD_VERT_VOL, renderAudioVertVol, startEffect<VolumeState, &EffectState::volume>, effectPeriod(20),
+        AudioProcessing::RMS_ONLY, true, ledFSMstates::AUD_SPLIT_SPIN, ledFSMstates::AUD_HORI_VOL},
+    {ledFSMstates::PLASMA, renderPlasma, startEffect<PacedState, &EffectState::paced>, effectPeriod(8000),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::SWAY, ledFSMstates::ANIMATION},
+    {ledFSMstates::ANIMATION, renderAnimation, startEffect<AnimationState, &EffectState::animation>, effectPeriod(0),
+        AudioProcessing::NO_AUDIO, true, ledFSMstates::PLASMA, ledFSMstates::WAVE_HORI}
+};
+const EffectDescriptor* const LEDeffects = EFFECTS;
+
+// Checks every state has its entry in place and that the links are consistent both ways
+constexpr bool effectsValid() {
+    if ((sizeof(EFFECTS) / sizeof(EFFECTS[0])) != ledFSMstates::NUM_LED_STATES) return false;
+    for (unsigned int i = 0; i < ledFSMstates::NUM_LED_STATES; i++) {
+        if (EFFECTS[i].state != i) return false;
+        if (EFFECTS[EFFECTS[i].next].previous != i) return false;
+        if (EFFECTS[EFFECTS[i].previous].next != i) return false;
     }
-    else {
-        for (ledInd_t i = 0; i < NUM_LED; i++) {
-            LEDlevel[i] = tempLevel[constrainIndex(i + amount)];
-            LEDgamma[i] = tempGamma[constrainIndex(i + amount)];
-        }
+    return true;
+}
+static_assert(effectsValid(), "LED effect table doesn't match the states");
+
+/*  Effect slots
+
+    An effect runs in a slot holding its state and the frame it draws.
+    There are two so that on a state change the outgoing effect can keep
+    running alongside the incoming one while they are blended together.
+    Outside of transitions only the current slot runs and its frame is
+    shown directly. A state change part way through a transition holds
+    the blend last shown in the outgoing slot and blends out of that,
+    with the effects it was made of stopped, so nothing jumps.
+*/
+struct EffectSlot {
+    ledFSMstates state = ledFSMstates::NUM_LED_STATES; // Effect in the slot, none if `NUM_LED_STATES`
+    EffectState effect;
+    LEDFrame frame;
+    unsigned long lastRenderUS = 0; // When the effect was last rendered, its clock is advanced by the time since
+};
+
+EffectSlot LEDslots[2];
+LEDTransition LEDtransitionKind = LEDTransition::FADE;  // How to move between effects
+unsigned long LEDtransitionMS = 400;                    // Duration of transitions (ms)
+
+/**
+ * \brief Sets how the FSM moves from one effect to the next
+ * 
+ * \param kind Kind of transition
+ * \param durationMS How long the transition lasts, zero to cut straight across
+ */
+void setTransitionLED(LEDTransition kind, unsigned long durationMS) {
+    LEDtransitionKind = kind;
+    LEDtransitionMS = durationMS;
+}
+
+/*  Layers
+
+    Layers over the FSM's effect run in the same way as the slots, each
+    with its own state and frame. They are drawn and composited after
+    the FSM's effect every cycle.
+*/
+struct EffectLayer {
+    ledFSMstates state = ledFSMstates::NUM_LED_STATES; // Effect in the layer, unused if `NUM_LED_STATES`
+    LEDBlend mode = LEDBlend::BLEND_ALPHA;
+    uint16_t opacity = 256;
+    EffectState effect;
+    LEDFrame frame;
+    unsigned long lastRenderUS = 0;
+};
+
+EffectLayer LEDlayers[MAX_LED_LAYERS - 1];
+
+/**
+ * \brief Adds a layer over the FSM's effect
+ * 
+ * \param effect Effect to run in the layer
+ * \param mode How the layer is blended with those below it
+ * \param opacity Opacity of the layer (Q8, 256 being opaque)
+ * \return The layer's index to remove it with, or `LED_LAYER_FAIL` if there are no free layers
+ * 
+ * \note Layers are drawn in index order, the first free index is used
+ */
+int addLayerLED(ledFSMstates effect, LEDBlend mode, uint16_t opacity) {
+    if (effect >= ledFSMstates::NUM_LED_STATES) return LED_LAYER_FAIL;
+
+    int layer = 0;
+    while ((layer < (MAX_LED_LAYERS - 1)) && (LEDlayers[layer].state != ledFSMstates::NUM_LED_STATES)) layer++;
+    if (layer == (MAX_LED_LAYERS - 1)) return LED_LAYER_FAIL;
+
+    EffectLayer* added = &LEDlayers[layer];
+    added->mode = mode;
+    added->opacity = (opacity > 256) ? 256 : opacity;
+    if (EFFECTS[effect].start != nullptr) EFFECTS[effect].start(&added->effect);
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        added->frame.gamma[i] = 0;
+        added->frame.fraction[i] = 0;
     }
+    added->frame.rotation = 0;
+    added->lastRenderUS = micros();
+    added->state = effect;
+    return layer;
+}
+
+/**
+ * \brief Removes a layer
+ * 
+ * \param layer Index of the layer from `addLayerLED`
+ * \return Whether it was removed or not, fails if it isn't in use
+ */
+int removeLayerLED(int layer) {
+    if ((layer < 0) || (layer >= (MAX_LED_LAYERS - 1))) return LED_LAYER_FAIL;
+    if (LEDlayers[layer].state == ledFSMstates::NUM_LED_STATES) return LED_LAYER_FAIL;
+
+    LEDlayers[layer].state = ledFSMstates::NUM_LED_STATES;
+    return LED_LAYER_SUCCESS;
+}
+
+/**
+ * \brief Runs a step of an effect
+ * 
+ * \param state Effect to run
+ * \param effect State of the effect
+ * \param frame Frame for the effect to draw into
+ * \param lastRenderUS When the effect was last rendered, updated to now
+ * \param input Inputs for the effect, the elapsed time is filled in
+ */
+void renderEffect(ledFSMstates state, EffectState* effect, LEDFrame* frame, unsigned long* lastRenderUS, 
+        EffectInput input) {
+    unsigned long now = micros();
+    input.elapsedUS = now - *lastRenderUS;
+    *lastRenderUS = now;
+
+    targetLED(frame);
+    PROFILE_START(render);
+    EFFECTS[state].render(effect, input, EFFECTS[state].params);
+    PROFILE_END(render, state);
 }
 
 /**
@@ -141,10 +672,14 @@ void rotateLED(ledInd_t amount, bool clockwise) {
 AudioProcessing LEDfsm(uint8_t buttons, double lMag[], double rMag[], double lRMS, double rRMS,
             ledFSMstates overrideState, bool override) {
     static ledFSMstates state = ledFSMstates::SOLID;
-    static ledFSMstates prevState = ledFSMstates::SOLID;
     static bool invertBrightness = false;
     static bool userControl = true; // Used for user togglable setting
 
+    static uint_fast8_t current = 0;            // Slot of the current effect, the other has any outgoing effect
+    static bool transitioning = false;
+    static bool outgoingHeld = false;           // Outgoing slot holds a blend rather than running an effect
+    static unsigned long transitionStart = 0;   // When the current transition started (ms)
+
     bool advanceState   = ((buttons & 0b0010) != 0);
     bool returnState    = ((buttons & 0b0100) != 0);
     bool toggleInvert   = ((buttons & 0b1000) != 0);
@@ -153,177 +688,179 @@ AudioProcessing LEDfsm(uint8_t buttons, double lMag[], double rMag[], double lRM
     if (toggleUser) userControl = !userControl;
     if (toggleInvert) invertBrightness = !invertBrightness;
 
-    // Keeps track of if audio sampling is needed (slows looping)
-    AudioProcessing sampleAudio = AudioProcessing::NO_AUDIO;   
-    bool allowInversion = true; // Record whether a state allows colour inversion or not
-
     if (override) state = overrideState;
-    switch (state) {
-    case ledFSMstates::BREATH:
-        breathingLED(5000);
-        if (returnState) state = ledFSMstates::SOLID;
-        if (advanceState) state = ledFSMstates::SPINNING;
-        break;
-    case ledFSMstates::SPINNING:
-        spinningLED(5000, userControl);
-        if (returnState) state = ledFSMstates::BREATH;
-        if (advanceState) state = ledFSMstates::SWEEP;
-        break;
-    case ledFSMstates::SWEEP:
-        sweepLED(500, 500, toggleUser);
-        if (returnState) state = ledFSMstates::SPINNING;
-        if (advanceState) state = ledFSMstates::SWAY;
-        break;
-    case ledFSMstates::SWAY:
-        swayLED(500, 500, toggleUser);
-        if (returnState) state = ledFSMstates::SWEEP;
-        if (advanceState) state = ledFSMstates::WAVE_HORI;
-        break;
-    case ledFSMstates::WAVE_HORI:
-        waveHorLED(3000, userControl);
-        if (returnState) state = ledFSMstates::SWAY;
-        if (advanceState) state = ledFSMstates::WAVE_VERT;
-        break;
-    case ledFSMstates::WAVE_VERT:
-        waveVerLED(3000, userControl);
-        if (returnState) state = ledFSMstates::WAVE_HORI;
-        if (advanceState) state = ledFSMstates::CLOUD;
-        break;
-    case ledFSMstates::CLOUD:
-        cloudLED(8);
-        if (returnState) state = ledFSMstates::WAVE_VERT;
-        if (advanceState) state = ledFSMstates::TRACKING;
-        break;
-    case ledFSMstates::TRACKING:
-        trackingLED(8, 500, 2, 5);
-        if (returnState) state = ledFSMstates::CLOUD;
-        if (advanceState) state = ledFSMstates::BUMPS;
-        break;
-    case ledFSMstates::BUMPS:
-        bumpsLED(10);
-        if (returnState) state = ledFSMstates::TRACKING;
-        if (advanceState) state = ledFSMstates::AUD_UNI;
-        break;
-    case ledFSMstates::AUD_UNI:
-        audioUniformLED(10, lRMS, rRMS);
-        if (returnState) state = ledFSMstates::BUMPS;
-        if (advanceState) state = ledFSMstates::AUD_BALANCE;
-        break;
-    case ledFSMstates::AUD_BALANCE:
-        audioBalanceLED(10, lRMS, rRMS);
-        if (returnState) state = ledFSMstates::AUD_UNI;
-        if (advanceState) state = ledFSMstates::AUD_HORI_SPECTRUM;
-        break;
-    case ledFSMstates::AUD_HORI_SPECTRUM:
-        audioHoriSpectrumLED(10, lMag, rMag, userControl);
-        if (returnState) state = ledFSMstates::AUD_BALANCE;
-        if (advanceState) state = ledFSMstates::AUD_SPLIT;
-        break;
-    case ledFSMstates::AUD_SPLIT:
-        audioSplitSpectrumLED(10, lMag, rMag, userControl);
-        if (returnState) state = ledFSMstates::AUD_HORI_SPECTRUM;
-        if (advanceState) state = ledFSMstates::AUD_SPLIT_SPIN;
-        break;
-    case ledFSMstates::AUD_SPLIT_SPIN:
-        audioSplitSpectrumSpinLED(20, lMag, rMag, userControl);
-        if (returnState) state = ledFSMstates::AUD_SPLIT;
-        if (advanceState) state = ledFSMstates::AUD_VERT_VOL;
-        break;
-    case ledFSMstates::AUD_VERT_VOL:
-        audioVertVolLED(20, lRMS, rRMS, userControl);
-        if (returnState) state = ledFSMstates::AUD_SPLIT_SPIN;
-        if (advanceState) state = ledFSMstates::AUD_HORI_VOL;
-        break;
-    case ledFSMstates::AUD_HORI_VOL:
-        audioHoriVolLED(20, lRMS, rRMS, userControl);
-        if (returnState) state = ledFSMstates::AUD_VERT_VOL;
-        if (advanceState) state = ledFSMstates::AUD_HORI_SPLIT_VOL;
-        break;
-    case ledFSMstates::AUD_HORI_SPLIT_VOL:
-        audioHoriSplitVolLED(20, lRMS, rRMS);
-        if (returnState) state = ledFSMstates::AUD_HORI_VOL;
-        if (advanceState) state = ledFSMstates::SOLID;
-        break;
-    
-    default: // Solid is default case
-        static ledlevel_t level = NUM_GAMMA / 2; // Used for the solid lighting level
-        if (toggleUser && (level < (NUM_GAMMA - 1))) level++;
-        if (toggleInvert && (level > 0)) level--;
-        uniformLED(level);
-        allowInversion = false; // Don't want inversion, using it for level control
-        if (returnState) state = ledFSMstates::AUD_HORI_SPLIT_VOL;
-        if (advanceState) state = ledFSMstates::BREATH;
-
-        // Brightness statements for debugging
-        SerialUSB.print("Gamma / PWM:\t");
-        SerialUSB.print(level);
-        SerialUSB.print("\t");
-        SerialUSB.println(PWM_GAMMA[level]);
-        delay(5);
-        break;
+
+    if (LEDslots[current].state != state) {
+        // The current effect moves out to the other slot to be blended out, unless there was nothing running
+        // A change during a transition blends out of what was last shown, both effects in it are dropped
+        bool blend = (LEDslots[current].state != ledFSMstates::NUM_LED_STATES) && 
+            (LEDtransitionKind != LEDTransition::CUT) && (LEDtransitionMS > 0);
+        if (blend) {
+            outgoingHeld = transitioning;
+            if (outgoingHeld) LEDslots[current].frame = LEDblended;
+            current = current ^ 1;
+            transitioning = true;
+            transitionStart = millis();
+        }
+        else transitioning = false;
+
+        EffectSlot* slot = &LEDslots[current];
+        slot->state = state;
+        if (EFFECTS[state].start != nullptr) EFFECTS[state].start(&slot->effect);
+        slot->frame.rotation = 0; // Effects expect to start drawing unrotated
+        for (ledInd_t i = 0; i < NUM_LED; i++) slot->frame.fraction[i] = 0; // Only some effects draw the fractions
+        slot->lastRenderUS = micros();
     }
 
-    if (prevState != state) {
-        // Do we want some sort of gradual shift between states?
+    EffectSlot* incoming = &LEDslots[current];
+    EffectSlot* outgoing = &LEDslots[current ^ 1];
+
+    EffectInput input;
+    input.userControl = userControl;
+    input.lMag = lMag;
+    input.rMag = rMag;
+    input.lRMS = lRMS;
+    input.rRMS = rRMS;
+
+    // Only the current effect sees the button presses
+    if (transitioning && !outgoingHeld) renderEffect(outgoing->state, &outgoing->effect, &outgoing->frame, &outgoing->lastRenderUS, input);
+    input.toggleUser = toggleUser;
+    input.toggleInvert = toggleInvert;
+    renderEffect(incoming->state, &incoming->effect, &incoming->frame, &incoming->lastRenderUS, input);
+
+    if (transitioning && ((millis() - transitionStart) >= LEDtransitionMS)) transitioning = false;
+
+    const LEDFrame* base; // Frame of the FSM's effect
+    bool baseInverted;
+    if (transitioning) {
+        // Blend into a separate frame, inversion is done while blending since it can differ between the effects
+        uint16_t progress = ((millis() - transitionStart) << 8) / LEDtransitionMS;
+        PROFILE_START(transition);
+        // A held blend already had any inversion applied
+        blendTransitionLED(&outgoing->frame, !outgoingHeld && invertBrightness && EFFECTS[outgoing->state].invertible,
+            &incoming->frame, invertBrightness && EFFECTS[incoming->state].invertible,
+            &LEDblended, LEDtransitionKind, progress);
+        PROFILE_END(transition, PROFILE_TRANSITION);
+        base = &LEDblended;
+        baseInverted = false;
     }
-    prevState = state;
-
-    // Handle inverting LED brightness as needed
-    copyGammaIntoBuffer(invertBrightness && allowInversion);
-
-    // Decide what audio processing is needed for the next cycle
-    // Uses a lot of "fall-through cases" to collect multiple states
-    switch (state) {
-    case ledFSMstates::AUD_HORI_SPECTRUM:
-    case ledFSMstates::AUD_SPLIT:
-    case ledFSMstates::AUD_SPLIT_SPIN:
-        sampleAudio = AudioProcessing::SPECTRUM;
-        break;
-    case ledFSMstates::AUD_UNI:
-    case ledFSMstates::AUD_BALANCE:
-    case ledFSMstates::AUD_VERT_VOL:
-    case ledFSMstates::AUD_HORI_VOL:
-    case ledFSMstates::AUD_HORI_SPLIT_VOL:
-        sampleAudio = AudioProcessing::RMS_ONLY;
-        break;
-    default: 
-        sampleAudio = AudioProcessing::NO_AUDIO;
-        break;
+    else {
+        base = &incoming->frame;
+        baseInverted = invertBrightness && EFFECTS[incoming->state].invertible;
+    }
+
+    // Draw the layers, they don't see the button presses either
+    input.toggleUser = false;
+    input.toggleInvert = false;
+    LEDLayerView layers[MAX_LED_LAYERS - 1];
+    uint8_t numLayers = 0;
+    AudioProcessing layerAudio = AudioProcessing::NO_AUDIO;
+    for (uint_fast8_t l = 0; l < (MAX_LED_LAYERS - 1); l++) {
+        EffectLayer* layer = &LEDlayers[l];
+        if (layer->state == ledFSMstates::NUM_LED_STATES) continue;
+
+        renderEffect(layer->state, &layer->effect, &layer->frame, &layer->lastRenderUS, input);
+        if (EFFECTS[layer->state].audio > layerAudio) layerAudio = EFFECTS[layer->state].audio;
+
+        layers[numLayers].frame = &layer->frame;
+        layers[numLayers].mode = layer->mode;
+        layers[numLayers].opacity = layer->opacity;
+        numLayers++;
     }
+
+    if (numLayers == 0) {
+        // Inverting LED brightness is handled when converting to duties
+        LEDshown = base;
+        LEDinverted = baseInverted;
+    }
+    else {
+        // Only the FSM's effect is inverted, the layers go over it as drawn
+        PROFILE_START(composite);
+        compositeLayersLED(base, baseInverted, layers, numLayers, &LEDcomposite);
+        PROFILE_END(composite, PROFILE_COMPOSITE);
+        LEDshown = &LEDcomposite;
+        LEDinverted = false;
+    }
+
+    const EffectDescriptor& effect = EFFECTS[incoming->state];
+    if (returnState) state = effect.previous;
+    if (advanceState) state = effect.next;
+    LEDstate = state;
+
+    // Audio processing needed for the next cycle, covering every effect that could be running in it
+    // The current effect is blended out if the state changed, spectrum processing also provides the RMS
+    AudioProcessing sampleAudio = EFFECTS[state].audio;
+    if (EFFECTS[incoming->state].audio > sampleAudio) sampleAudio = EFFECTS[incoming->state].audio;
+    if (transitioning && !outgoingHeld && (EFFECTS[outgoing->state].audio > sampleAudio)) sampleAudio = EFFECTS[outgoing->state].audio;
+    if (layerAudio > sampleAudio) sampleAudio = layerAudio;
     return sampleAudio;
 }
 
+const uint8_t MAX_EFFECT_STEPS = 64; // Most steps an effect catches up on in a render, the rest are dropped
+
+/**
+ * \brief Moves an effect's clock on by the time since it was last rendered
+ * 
+ * \param clock Clock of the effect
+ * \param elapsedUS Time since the effect was last rendered (us)
+ */
+void advanceClock(EffectClock* clock, unsigned long elapsedUS) {
+    unsigned long total = clock->carryUS + elapsedUS;
+    clock->deltaMS = total / 1000;
+    clock->timeMS = clock->timeMS + clock->deltaMS;
+    clock->carryUS = total % 1000;
+    clock->steps = 0;
+}
+
 /**
- * \brief Used to check if a given effect has not been used for a while
+ * \brief Checks if a step of an effect is due, taking it if so
  * 
- * \param mark The next time an effect increment is meant to occur
- * \param stepPeriod The desired period between effect increments
- * \param curTime The current time
+ * \param clock Clock of the effect, advanced for this render
+ * \param stepMS The desired period between steps (ms)
  * 
- * \note All marameters should reference the same clock and unit (milli- or microseconds)
+ * \note Call until it returns false to take every step due, `stepTime` is when the taken step was due
  * 
- * \return If a timeout/reset has occured
+ * \return If a step is to be taken
  */
-bool checkReset(unsigned long mark, unsigned long stepPeriod, unsigned long curTime) {
-    if (mark >= curTime) return false; // If mark is in the future then not timed out
-
-    /*  Reset check
+bool stepDue(EffectClock* clock, unsigned long stepMS) {
+    if (stepMS == 0) stepMS = 1; // Steps as fast as the clock allows
+
+    if (!clock->started) {
+        clock->started = true;
+        clock->stepTime = clock->timeMS;
+        clock->nextMark = clock->timeMS + stepMS;
+        return true;
+    }
+    if (clock->nextMark > clock->timeMS) return false;
 
-        Checking if the function hasn't been called for some time indirectly via a 
-        notably out of date `nextMark` value. Thus the function should probably restart.
+    if (clock->steps >= MAX_EFFECT_STEPS) {
+        clock->nextMark = clock->timeMS + stepMS; // Too far behind, drop the backlog rather than stall the frame
+        return false;
+    }
 
-        It also accounts for audio sampling by using the larger of the two periods:
-        function step and approximate audio sampling period.
-    */ 
-    const unsigned long AUDIO_SAMPLE_PERIOD = 40;
-    const unsigned long FUNC_TIMEOUT_PERIOD = 3 * stepPeriod;
+    clock->steps++;
+    clock->stepTime = clock->nextMark;
+    clock->nextMark = clock->nextMark + stepMS;
+    return true;
+}
 
-    bool timedOut;
-    if (AUDIO_SAMPLE_PERIOD > FUNC_TIMEOUT_PERIOD) timedOut = (mark + AUDIO_SAMPLE_PERIOD) < curTime;
-    else timedOut = (mark + FUNC_TIMEOUT_PERIOD) < curTime;
-    if (timedOut) return true;
+/**
+ * \brief Checks if an effect that only shows the latest input is due an update
+ * 
+ * \param clock Clock of the effect, advanced for this render
+ * \param stepMS The desired period between updates (ms)
+ * 
+ * \note Missed updates are dropped rather than caught up on
+ * 
+ * \return If an update is to be made
+ */
+bool paceDue(EffectClock* clock, unsigned long stepMS) {
+    if (clock->started && (clock->nextMark > clock->timeMS)) return false;
 
-    return (mark == 0); // If mark is zero then it's the first time a function's run, should reset
+    clock->started = true;
+    clock->stepTime = clock->timeMS;
+    clock->nextMark = clock->timeMS + stepMS;
+    return true;
 }
 
 /**
@@ -352,18 +889,7 @@ ledInd_t constrainIndex(ledInd_t ind, ledInd_t limit) {
  * \note Bottom row is row 0
  */
 void paintRows(ledlevel_t intensities[]) {
-    // Right side
-    for (ledInd_t i = LEDstartIndex[0]; i < LEDstartIndex[1]; i++)
-        LEDgamma[i] = intensities[(NUM_ROW - 1) - i];
-    // Bottom row
-    for (ledInd_t i = LEDstartIndex[1]; i < LEDstartIndex[2]; i++)
-        LEDgamma[i] = intensities[0];
-    // Left side
-    for (ledInd_t i = LEDstartIndex[2]; i < LEDstartIndex[3]; i++)
-        LEDgamma[i] = intensities[i - LEDstartIndex[2]];
-    // Top row
-    for (ledInd_t i = LEDstartIndex[3]; i < NUM_LED; i++)
-        LEDgamma[i] = intensities[NUM_ROW - 1];
+    for (ledInd_t i = 0; i < NUM_LED; i++) LEDgamma[i] = intensities[LEDgeometry[i].row];
 }
 
 /**
@@ -372,36 +898,21 @@ void paintRows(ledlevel_t intensities[]) {
  * \param intensities Array of intensities to paint on the columns
  * 
  * \note Left column is column 0
+ * \note The top row is narrower, its LEDs skip the outer columns
  */
 void paintColumns(ledlevel_t intensities[]) {
-    // Right side
-    for (ledInd_t i = LEDstartIndex[0]; i < LEDstartIndex[1]; i++) 
-        LEDgamma[i] = intensities[NUM_COL - 1];
-    // Bottom row
-    for (ledInd_t i = LEDstartIndex[1]; i < LEDstartIndex[2]; i++) 
-        LEDgamma[i] = intensities[(NUM_COL - 1) - (i - LEDstartIndex[1])];
-    // Left side
-    for (ledInd_t i = LEDstartIndex[2]; i < LEDstartIndex[3]; i++) 
-        LEDgamma[i] = intensities[0];
-    // Top row, since it is a bit narrower we skip the outer values
-    for (ledInd_t i = LEDstartIndex[3]; i < NUM_LED; i++) 
-        LEDgamma[i] = intensities[(i + 1) - LEDstartIndex[3]];
+    for (ledInd_t i = 0; i < NUM_LED; i++) LEDgamma[i] = intensities[LEDgeometry[i].col];
 }
 
 /**
- * \brief Copies the gamma brightness buffer into the actual light intensity buffer
+ * \brief Paints the LEDs in bands along any of the geometry positions
  * 
- * \param invert Invert the gamma intensities or not
+ * \param intensities Array of intensities for each band, in increasing position
+ * \param num Number of bands the full range of the position is split into
+ * \param position Position to paint along, like `&LEDGeometry::x` or `&LEDGeometry::angle`
  */
-void copyGammaIntoBuffer(bool invert) {
-    for (ledInd_t i = 0; i < NUM_LED; i++) {
-        // Clamp buffer
-        if (LEDgamma[i] >= NUM_GAMMA) LEDgamma[i] = NUM_GAMMA - 1;
-
-        // Copy value as is or inverted
-        if (!invert) LEDlevel[i] = PWM_GAMMA[LEDgamma[i]];
-        else LEDlevel[i] = PWM_GAMMA[(NUM_GAMMA - 1) - LEDgamma[i]];
-    }
+void paintAxis(const ledlevel_t intensities[], uint8_t num, uint8_t LEDGeometry::*position) {
+    for (ledInd_t i = 0; i < NUM_LED; i++) LEDgamma[i] = intensities[((LEDgeometry[i].*position) * num) >> 8];
 }
 
 /**
@@ -413,128 +924,124 @@ void uniformLED(ledlevel_t intensity) {
     for (ledInd_t i = 0; i < NUM_LED; i++) LEDgamma[i] = intensity;
 }
 
+/**
+ * \brief Sets all LEDs to the same level, including a fraction of a level
+ * 
+ * \param level Level to set (Q8 gamma levels)
+ */
+void uniformFineLED(uint16_t level) {
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        LEDgamma[i] = level >> 8;
+        LEDtarget->fraction[i] = level & 0xFF;
+    }
+}
+
+/**
+ * \brief Returns the level of an LED, including its fraction of a level
+ * 
+ * \param ind Index of the LED
+ * \return Level of the LED (Q8 gamma levels)
+ */
+uint16_t fineLevelLED(ledInd_t ind) {
+    return (LEDgamma[ind] << 8) | LEDtarget->fraction[ind];
+}
+
+/**
+ * \brief Sets the level of an LED, including a fraction of a level
+ * 
+ * \param ind Index of the LED
+ * \param level Level to set (Q8 gamma levels)
+ */
+void setFineLED(ledInd_t ind, uint16_t level) {
+    LEDgamma[ind] = level >> 8;
+    LEDtarget->fraction[ind] = level & 0xFF;
+}
+
 /**
  * \brief Does a uniform cyclic breathing effect (fading in and out)
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param periodMS Period in ms for a complete breathing cycle
  */
-void breathingLED(unsigned long periodMS) {
+void breathingLED(PacedState* state, unsigned long elapsedUS, unsigned long periodMS) {
     const ledlevel_t MAX_INTENSITY = NUM_GAMMA;
     const ledlevel_t MIN_INTENSITY = 0;
-    const ledlevel_t intensityStep = 1;
 
-    static ledlevel_t breathingIntensity = 0;
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    static bool climbing = true;            // True if brightness is to climb
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    if (nextMark > currentTime) return; // Wait for effect mark
-
-    // Determine approximate time step for each lighting step so a complete up-down cycle is done
-    unsigned int stepMS = periodMS / (2 * (MAX_INTENSITY / intensityStep));
-
-    // Check and handle resets
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        breathingIntensity = MIN_INTENSITY;
-        climbing = true;
-    }
+    // Climb for the first half of the cycle and fall for the second, starting from the bottom
+    unsigned long cycleTime = state->clock.timeMS % periodMS;
+    unsigned long halfPeriod = periodMS / 2;
+    if (cycleTime > halfPeriod) cycleTime = periodMS - cycleTime;
 
-    // Actually enact effect
-    if (climbing) {
-        if (breathingIntensity >= MAX_INTENSITY) {
-            breathingIntensity = MAX_INTENSITY;
-            climbing = false;
-        }
-        else breathingIntensity += intensityStep;
-    }
-    else {
-        if (breathingIntensity <= MIN_INTENSITY) {
-            breathingIntensity = MIN_INTENSITY;
-            climbing = true;
-        }
-        else breathingIntensity -= intensityStep;
-    }
-    uniformLED(breathingIntensity);
+    // Drawn between the levels so the slow fade doesn't step visibly near the bottom
+    uint16_t intensity = (MIN_INTENSITY << 8) + ((((MAX_INTENSITY - MIN_INTENSITY) << 8) * cycleTime) / halfPeriod);
+    uniformFineLED(intensity);
 }
 
 /**
  * \brief Moves perturbations around the logo gradually
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param periodMS Period for one rotation around board
  * \param clockwise Direction of rotation, true for clockwise
- * \note Probably going to be pretty choppy if run slowly
  */
-void spinningLED(unsigned long periodMS, bool clockwise) {
+void spinningLED(SpinningState* state, unsigned long elapsedUS, unsigned long periodMS, bool clockwise) {
     const ledlevel_t BASE_INTENSITY = 10;
-    const int NUM_BUMPS = 2; // Number of light "bumps" going around
+    const uint8_t NUM_BUMPS = SpinningState::NUM_BUMP;
     const ledInd_t SPACING = NUM_LED / NUM_BUMPS;
-    ledlevel_t STAGES[] = {NUM_GAMMA, 55, 50, 45, 40, 35, 25, 20, BASE_INTENSITY}; 
-    // Gamma intensities of the bumps going around
-    // Need to include background to reset 
-    const int NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
-
-    static ledInd_t rotation = 0;
-
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
-
-    if (nextMark > currentTime) return; // Wait for effect mark
-
-    // Determine approximate time step for each lighting step so rotations are done
-    unsigned int stepMS = periodMS / NUM_LED;
-
-    // Check and handle resets
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        rotation = 0;
-    }
-
-    uniformLED(BASE_INTENSITY);
-
-    // Draw the bumps
-    for (int_fast8_t b = 0; b < NUM_BUMPS; b++) {
-        ledInd_t baseAddress = b * SPACING;
-
-        for (ledInd_t offset = 0; offset < NUM_STAGES; offset++) {
-            ledInd_t ahead = constrainIndex(baseAddress + offset);
-            ledInd_t behind = constrainIndex(baseAddress - offset);
-            LEDgamma[ahead] = STAGES[offset];
-            LEDgamma[behind] = STAGES[offset];
+    static const ledlevel_t STAGES[] = {NUM_GAMMA, 55, 50, 45, 40, 35, 25, 20}; 
+    // Gamma intensities of the bumps going around, from their crest out
+    const uint8_t NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
+
+    LEDParticle* bump = state->bump;
+
+    advanceClock(&state->clock, elapsedUS);
+
+    // Spread the bumps out evenly to start
+    if (!state->clock.started) {
+        state->clock.started = true;
+        for (uint_fast8_t b = 0; b < NUM_BUMPS; b++) {
+            bump[b].position = (int32_t)(b * SPACING) << 16;
+            bump[b].lifeMS = PARTICLE_FOREVER;
+            bump[b].profile = STAGES;
+            bump[b].width = NUM_STAGES;
         }
     }
 
-    // Enact rotation
-    rotateLED(rotation, true);
-    
-    // Accumulate rotations this way so direction can be seemlessly switched
-    if (clockwise) rotation++;
-    else rotation--;
-    rotation = constrainIndex(rotation);
+    // Setting the speed on every render lets the direction be seemlessly switched
+    int32_t velocity = particleSpeed(NUM_LED, periodMS);
+    for (uint_fast8_t b = 0; b < NUM_BUMPS; b++) bump[b].velocity = clockwise ? velocity : -velocity;
+    stepParticlesLED(bump, NUM_BUMPS, state->clock.deltaMS, NUM_LED, true);
+
+    uniformLED(BASE_INTENSITY);
+    renderParticlesLED(bump, NUM_BUMPS, LEDgamma, NUM_LED, true, LEDBlend::BLEND_MAX);
 }
 
 /**
  * \brief Sweeping effect from one corner to the opposite corner
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param periodMS Period for sweep from corner to corner (milliseconds)
  * \param holdMS How long to hold after a complete sweep (millisocends)
  * \param toggleCorner Used to advance which corner to use as start
  */
-void sweepLED(unsigned long periodMS, unsigned long holdMS, bool toggleCorner) {
+void sweepLED(SweepState* state, unsigned long elapsedUS, unsigned long periodMS, unsigned long holdMS, 
+        bool toggleCorner) {
 
     const ledlevel_t BASE_INTENSITY = 10;
     const ledlevel_t PEAK_INTENSITY = 63;
 
-    static unsigned int corner = 0; // Corner to emit effect from
-    static ledInd_t progress = 0;
-    static bool lightingUp = true;
-    static bool holdingOff = false;
+    uint8_t& corner = state->corner;
+    ledInd_t& progress = state->progress;
+    bool& lightingUp = state->lightingUp;
+    bool& holdingOff = state->holdingOff;
+    unsigned long& holdoffEnd = state->holdoffEnd;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    static unsigned long holdoffEnd = 0;
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
     if (toggleCorner) {
         corner = (corner + 1) % 4;
@@ -546,91 +1053,72 @@ void sweepLED(unsigned long periodMS, unsigned long holdMS, bool toggleCorner) {
         holdingOff = false;
     }
 
-    if (nextMark > currentTime) return; // Wait for effect mark
-
     // Determine approximate time step for each lighting step so sweep is done
     unsigned int stepMS = periodMS / (NUM_LED / 2);
 
-    // Check and handle resets
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        uniformLED(BASE_INTENSITY);
-        lightingUp = true;
-        progress = 0;
-        holdingOff = false;
-        holdoffEnd = 0;
-        return;
-    }
+    bool restart = !state->clock.started; // Start afresh on the first step
+    while (stepDue(&state->clock, stepMS)) {
+        unsigned long currentTime = state->clock.stepTime;
+
+        if (restart) {
+            uniformLED(BASE_INTENSITY);
+            lightingUp = true;
+            progress = 0;
+            holdingOff = false;
+            holdoffEnd = 0;
+            restart = false;
+            continue;
+        }
 
-    // Check and handle hold offs
-    if (holdingOff) {
-        if (holdoffEnd > currentTime) return; // Return until holdoff is to end
+        // Check and handle hold offs
+        if (holdingOff) {
+            if (holdoffEnd > currentTime) continue; // Wait until holdoff is to end
 
-        // Start the opposite sweep
-        holdingOff = false;
-        progress = 0;
-        lightingUp = !lightingUp;
-    }
+            // Start the opposite sweep
+            holdingOff = false;
+            progress = 0;
+            lightingUp = !lightingUp;
+        }
 
-    // Detemine start for sweep effect (some manual adjustments are needed for visuals)
-    ledInd_t baseLocation = LEDstartIndex[corner];
-    switch (corner) {
-    case 0:
-        baseLocation = LEDstartIndex[0];
-        break;
-    case 1:
-        baseLocation = LEDstartIndex[1];
-        break;
-    case 2:
-        baseLocation = LEDstartIndex[2] - 1;
-        break;
-    case 3:
-        baseLocation = LEDstartIndex[3];
-        break;
-    }
 
-    // Check where in sweep effect it is
-    progress++;
-    for (int i = 0; i < (NUM_LED / 2); i++) {
-        ledInd_t forwards = constrainIndex(baseLocation + i);
-        ledInd_t backwards = constrainIndex(baseLocation - (i + 1));
-
-        if (lightingUp != (i >= progress)) {
-            LEDgamma[forwards] = PEAK_INTENSITY;
-            LEDgamma[backwards] = PEAK_INTENSITY;
-        } else {
-            LEDgamma[forwards] = BASE_INTENSITY;
-            LEDgamma[backwards] = BASE_INTENSITY;
+        // Check where in sweep effect it is, spreading both ways from the corner
+        progress++;
+        for (ledInd_t i = 0; i < NUM_LED; i++) {
+            ledInd_t steps = anchorSteps(LEDgeometry[i].anchorOffset[corner]);
+
+            if (lightingUp != (steps >= progress)) LEDgamma[i] = PEAK_INTENSITY;
+            else LEDgamma[i] = BASE_INTENSITY;
         }
-    }
 
-    if (progress >= (NUM_LED / 2)) {
-        // At the end, start holdoff 
-        holdingOff = true;
-        holdoffEnd = currentTime + holdMS;
+        if (progress >= (NUM_LED / 2)) {
+            // At the end, start holdoff 
+            holdingOff = true;
+            holdoffEnd = currentTime + holdMS;
+        }
     }
 }
 
 /**
  * \brief Swaying effect from one corner to the opposite corner, then back
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param periodMS Period for sweep from corner to corner (milliseconds)
  * \param holdMS How long to hold after a complete sweep (millisocends)
  * \param toggleCorner Used to advance which corner to use as start
  */
-void swayLED(unsigned long periodMS, unsigned long holdMS, bool toggleCorner) {
+void swayLED(SweepState* state, unsigned long elapsedUS, unsigned long periodMS, unsigned long holdMS, 
+        bool toggleCorner) {
     const ledlevel_t BASE_INTENSITY = 10;
     const ledlevel_t PEAK_INTENSITY = 63;
 
-    static unsigned int corner = 0; // Corner to emit effect from
-    static ledInd_t progress = 0;   // Marks the amount of the wave to draw
-    static bool lightingUp = true;
-    static bool holdingOff = false;
+    uint8_t& corner = state->corner;
+    ledInd_t& progress = state->progress;
+    bool& lightingUp = state->lightingUp;
+    bool& holdingOff = state->holdingOff;
+    unsigned long& holdoffEnd = state->holdoffEnd;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    static unsigned long holdoffEnd = 0;
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
     if (toggleCorner) {
         corner = (corner + 1) % 4;
@@ -642,328 +1130,343 @@ void swayLED(unsigned long periodMS, unsigned long holdMS, bool toggleCorner) {
         holdingOff = false;
     }
 
-    if (nextMark > currentTime) return; // Wait for effect mark
-
     // Determine approximate time step for each lighting step so sweep is done
     unsigned int stepMS = periodMS / (NUM_LED / 2);
 
-    // Check and handle resets
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        uniformLED(BASE_INTENSITY);
-        lightingUp = true;
-        progress = 0;
-        holdingOff = false;
-        holdoffEnd = 0;
-        return;
-    }
+    bool restart = !state->clock.started; // Start afresh on the first step
+    while (stepDue(&state->clock, stepMS)) {
+        unsigned long currentTime = state->clock.stepTime;
+
+        if (restart) {
+            uniformLED(BASE_INTENSITY);
+            lightingUp = true;
+            progress = 0;
+            holdingOff = false;
+            holdoffEnd = 0;
+            restart = false;
+            continue;
+        }
 
-    // Check and handle hold offs
-    if (holdingOff) {
-        if (holdoffEnd > currentTime) return; // Return until holdoff is to end
+        // Check and handle hold offs
+        if (holdingOff) {
+            if (holdoffEnd > currentTime) continue; // Wait until holdoff is to end
 
-        // Start the opposite sweep
-        holdingOff = false;
-        lightingUp = !lightingUp;
-    }
+            // Start the opposite sweep
+            holdingOff = false;
+            lightingUp = !lightingUp;
+        }
 
-    // Detemine start for sweep effect (some manual adjustments are needed for visuals)
-    ledInd_t baseLocation = LEDstartIndex[corner];
-    switch (corner) {
-    case 0:
-        baseLocation = LEDstartIndex[0];
-        break;
-    case 1:
-        baseLocation = LEDstartIndex[1];
-        break;
-    case 2:
-        baseLocation = LEDstartIndex[2] - 1;
-        break;
-    case 3:
-        baseLocation = LEDstartIndex[3];
-        break;
-    }
 
-    if (lightingUp) progress++;
-    else progress--;
+        if (lightingUp) progress++;
+        else progress--;
 
-    for (int i = 0; i < (NUM_LED / 2); i++) {
-        ledInd_t forwards = constrainIndex(baseLocation + i);
-        ledInd_t backwards = constrainIndex(baseLocation - (i + 1));
-        if (i < progress) {
-            LEDgamma[forwards] = PEAK_INTENSITY;
-            LEDgamma[backwards] = PEAK_INTENSITY;
-        } else {
-            LEDgamma[forwards] = BASE_INTENSITY;
-            LEDgamma[backwards] = BASE_INTENSITY;
+        // Spread both ways from the corner
+        for (ledInd_t i = 0; i < NUM_LED; i++) {
+            if (anchorSteps(LEDgeometry[i].anchorOffset[corner]) < progress) LEDgamma[i] = PEAK_INTENSITY;
+            else LEDgamma[i] = BASE_INTENSITY;
+        }
+
+        // Check where in sweep effect it is
+        if ((progress == (NUM_LED / 2)) || (progress == 0)) {
+            // At the end, start holdoff 
+            holdingOff = true;
+            holdoffEnd = currentTime + holdMS;
         }
     }
+}
+
+/**
+ * \brief Slowly swirling plasma, drawn on the canvas
+ * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
+ * \param periodMS Period in ms for the plasma to go through a cycle
+ */
+void plasmaLED(PacedState* state, unsigned long elapsedUS, unsigned long periodMS) {
+    const ledlevel_t BASE_INTENSITY = 5;
+    const ledlevel_t PEAK_INTENSITY = 50;
+    const int16_t WAVELENGTH = 12 << 8; // Length of the plasma's waves (Q8 canvas cells)
 
-    // Check where in sweep effect it is
-    if ((progress == (NUM_LED / 2)) || (progress == 0)) {
-        // At the end, start holdoff 
-        holdingOff = true;
-        holdoffEnd = currentTime + holdMS;
+    advanceClock(&state->clock, elapsedUS);
+
+    uint8_t phase = ((state->clock.timeMS % periodMS) * 256) / periodMS;
+
+    LEDCanvas canvas;
+    clearCanvas(&canvas);
+    drawPlasmaCanvas(&canvas, WAVELENGTH, phase, BASE_INTENSITY << 8, PEAK_INTENSITY << 8);
+    renderCanvasLED(&canvas);
+}
+
+/**
+ * \brief Plays an animation, each frame shown for its own time
+ * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
+ * \param data Animation to play (see `led_animation.hpp`), must stay put while it is played
+ * \param size Bytes of animation data
+ */
+void animationLED(AnimationState* state, unsigned long elapsedUS, const uint8_t data[], uint32_t size) {
+    AnimationPlayer* player = &state->player;
+
+    advanceClock(&state->clock, elapsedUS);
+
+    // Shows nothing rather than whatever was left in the frame if the animation can't be played
+    if (!state->clock.started && (startAnimation(player, data, size) == LED_ANIMATION_FAIL)) uniformLED(0);
+
+    // Each frame is a step lasting as long as it is shown, frames build on each other so none are skipped
+    while (stepDue(&state->clock, player->durationMS)) {
+        if (decodeFrameAnimation(player) == LED_ANIMATION_FAIL) break;
     }
 }
 
 /**
  * \brief Vertical wave effect
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param periodMS Period for wave from end to end in milliseconds
  * \param upwards Should the wave move upwards or not
  */
-void waveVerLED(unsigned long periodMS, bool upwards) {
+void waveVerLED(WaveVerState* state, unsigned long elapsedUS, unsigned long periodMS, bool upwards) {
     const ledlevel_t END_INTENSITY = 60;
     const ledlevel_t START_INTENSITY = 10;
     const int INTENSITY_INCR = (START_INTENSITY < END_INTENSITY) ? 1 : -1;
     const ledlevel_t PROPAGATE_LVL = 30; // Level to start next row
 
-    static bool lastUpwards = false;
-    static ledInd_t location = 0; // Location of leading row in effect
-    static ledlevel_t rowLevels[NUM_ROW] = { 0 };
-    static bool rowGrowing[NUM_ROW] = { false }; // Marks if a row's brightness is climbing or not
+    bool& lastUpwards = state->lastForwards;
+    ledInd_t& location = state->location; // Location of leading row in effect
+    ledlevel_t* rowLevels = state->levels;
+    bool* rowGrowing = state->growing; // Marks if a row's brightness is climbing or not
+
+    advanceClock(&state->clock, elapsedUS);
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
     unsigned int stepMS = periodMS / (NUM_ROW * 2 * ((END_INTENSITY - START_INTENSITY) /  INTENSITY_INCR));
     // Determine approximate time step for each lighting step so rotations are done
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
+    bool restart = !state->clock.started; // Start afresh on the first step
+    bool stepped = false;
+    while (stepDue(&state->clock, stepMS)) {
+        stepped = true;
 
-    // Handle potential reset
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        for (ledInd_t i = 0; i < NUM_ROW; i++) rowLevels[i] = START_INTENSITY;
-        uniformLED(START_INTENSITY);
+        if (restart) {
+            for (ledInd_t i = 0; i < NUM_ROW; i++) rowLevels[i] = START_INTENSITY;
+            uniformLED(START_INTENSITY);
 
-        if (upwards) location = NUM_ROW - 1;
-        else location = 0;
+            if (upwards) location = NUM_ROW - 1;
+            else location = 0;
 
-        lastUpwards = upwards;
-        return;
-    }
+            lastUpwards = upwards;
+            restart = false;
+            continue;
+        }
 
-    // Deal with a direction reversal
-    if (lastUpwards != upwards) {
-        if (upwards) {
-            for (int i = 0; i < NUM_ROW; i++) {
-                if (rowGrowing[i] == true) rowGrowing[i] = false;
-                else if (rowLevels[i] != START_INTENSITY) {
-                    rowGrowing[i] = true;
-                    location = i;
+        // Deal with a direction reversal
+        if (lastUpwards != upwards) {
+            if (upwards) {
+                for (int i = 0; i < NUM_ROW; i++) {
+                    if (rowGrowing[i] == true) rowGrowing[i] = false;
+                    else if (rowLevels[i] != START_INTENSITY) {
+                        rowGrowing[i] = true;
+                        location = i;
+                    }
                 }
             }
-        }
-        else {
-            for (int i = NUM_ROW - 1; i >= 0; i--) {
-                if (rowGrowing[i] == true) rowGrowing[i] = false;
-                else if (rowLevels[i] != START_INTENSITY) {
-                    rowGrowing[i] = true;
-                    location = i;
+            else {
+                for (int i = NUM_ROW - 1; i >= 0; i--) {
+                    if (rowGrowing[i] == true) rowGrowing[i] = false;
+                    else if (rowLevels[i] != START_INTENSITY) {
+                        rowGrowing[i] = true;
+                        location = i;
+                    }
                 }
             }
         }
-    }
-    lastUpwards = upwards;
+        lastUpwards = upwards;
 
-    // Set lighting by rows
-    rowGrowing[location] = true; // Always growing on the leading edge
+        // Set lighting by rows
+        rowGrowing[location] = true; // Always growing on the leading edge
 
-    for (unsigned int r = 0; r < NUM_ROW; r++) {
-        if (rowGrowing[r] == true) {
-            // Climb to end point then start reversing
-            if (rowLevels[r] != END_INTENSITY) rowLevels[r] = rowLevels[r] + INTENSITY_INCR;
-            else rowGrowing[r] = false; // Hit endpoint
+        for (unsigned int r = 0; r < NUM_ROW; r++) {
+            if (rowGrowing[r] == true) {
+                // Climb to end point then start reversing
+                if (rowLevels[r] != END_INTENSITY) rowLevels[r] = rowLevels[r] + INTENSITY_INCR;
+                else rowGrowing[r] = false; // Hit endpoint
+            }
+            else {
+                // Decend until hitting base colour
+                if (rowLevels[r] != START_INTENSITY) rowLevels[r] = rowLevels[r] - INTENSITY_INCR;
+            } 
         }
-        else {
-            // Decend until hitting base colour
-            if (rowLevels[r] != START_INTENSITY) rowLevels[r] = rowLevels[r] - INTENSITY_INCR;
-        } 
-    }
 
-    // Check to propagate
-    // Also check for top out (happens occasionally after direction change)
-    if ((rowLevels[location] == PROPAGATE_LVL) || (rowLevels[location] == END_INTENSITY)) {
-        if (upwards) {
-            if (location == (NUM_ROW - 1)) {
-                location = 0;
+        // Check to propagate
+        // Also check for top out (happens occasionally after direction change)
+        if ((rowLevels[location] == PROPAGATE_LVL) || (rowLevels[location] == END_INTENSITY)) {
+            if (upwards) {
+                if (location == (NUM_ROW - 1)) {
+                    location = 0;
+                }
+                else location++;
             }
-            else location++;
-        }
-        else {
-            if (location == 0) {
-                location = NUM_ROW - 1;
+            else {
+                if (location == 0) {
+                    location = NUM_ROW - 1;
+                }
+                else location--;
             }
-            else location--;
+            rowLevels[location] = rowLevels[location] + INTENSITY_INCR; // Increment new location
         }
-        rowLevels[location] = rowLevels[location] + INTENSITY_INCR; // Increment new location
     }
 
-    // Paint LEDs using gamma correction
-    paintRows(rowLevels);
+    // Paint LEDs using gamma correction, once all the steps are done
+    if (stepped) paintRows(rowLevels);
 }
 
 /**
  * \brief Horizontal wave effect
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param periodMS Period for wave from end to end in milliseconds
  * \param rightwards Should the wave scroll rightwards or not
  */
-void waveHorLED(unsigned long periodMS, bool rightwards) {
+void waveHorLED(WaveHorState* state, unsigned long elapsedUS, unsigned long periodMS, bool rightwards) {
     const ledlevel_t END_INTENSITY = NUM_GAMMA;
     const ledlevel_t START_INTENSITY = 10;
     const int INTENSITY_INCR = (START_INTENSITY < END_INTENSITY) ? 1 : -1;
     const ledlevel_t PROPAGATE_LVL = 32; // Level to start next row
 
-    static bool lastRightwards = false;
-    static ledInd_t location = 0; // Location of leading row in effect
-    static ledlevel_t colLevels[NUM_COL] = { 0 };
-    static bool colGrowing[NUM_COL] = { false }; // Marks if a row's brightness is climbing or not
+    bool& lastRightwards = state->lastForwards;
+    ledInd_t& location = state->location; // Location of leading column in effect
+    ledlevel_t* colLevels = state->levels;
+    bool* colGrowing = state->growing; // Marks if a column's brightness is climbing or not
+
+    advanceClock(&state->clock, elapsedUS);
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
     unsigned int stepMS = periodMS / (NUM_COL * 2 * ((END_INTENSITY - START_INTENSITY) / INTENSITY_INCR));
     // Determine approximate time step for each lighting step so rotations are done
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
+    bool restart = !state->clock.started; // Start afresh on the first step
+    bool stepped = false;
+    while (stepDue(&state->clock, stepMS)) {
+        stepped = true;
 
-    // Handle potential reset
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        for (ledInd_t i = 0; i < NUM_COL; i++) colLevels[i] = START_INTENSITY;
-        uniformLED(START_INTENSITY);
+        if (restart) {
+            for (ledInd_t i = 0; i < NUM_COL; i++) colLevels[i] = START_INTENSITY;
+            uniformLED(START_INTENSITY);
 
-        if (rightwards) location = NUM_COL - 1;
-        else location = 0;
+            if (rightwards) location = NUM_COL - 1;
+            else location = 0;
 
-        lastRightwards = rightwards;
-        return;
-    }
+            lastRightwards = rightwards;
+            restart = false;
+            continue;
+        }
 
-    // Deal with a direction reversal
-    if (lastRightwards != rightwards) {
-        if (rightwards) {
-            for (int i = 0; i < NUM_COL; i++) {
-                if (colLevels[i] == true) colGrowing[i] = false;
-                else if (colLevels[i] != START_INTENSITY) {
-                    colGrowing[i] = true;
-                    location = i;
+        // Deal with a direction reversal
+        if (lastRightwards != rightwards) {
+            if (rightwards) {
+                for (int i = 0; i < NUM_COL; i++) {
+                    if (colLevels[i] == true) colGrowing[i] = false;
+                    else if (colLevels[i] != START_INTENSITY) {
+                        colGrowing[i] = true;
+                        location = i;
+                    }
                 }
             }
-        }
-        else {
-            for (int i = NUM_COL - 1; i >= 0; i--) {
-                if (colLevels[i] == true) colGrowing[i] = false;
-                else if (colLevels[i] != START_INTENSITY) {
-                    colGrowing[i] = true;
-                    location = i;
+            else {
+                for (int i = NUM_COL - 1; i >= 0; i--) {
+                    if (colLevels[i] == true) colGrowing[i] = false;
+                    else if (colLevels[i] != START_INTENSITY) {
+                        colGrowing[i] = true;
+                        location = i;
+                    }
                 }
             }
         }
-    }
-    lastRightwards = rightwards;
+        lastRightwards = rightwards;
 
-    // Set lighting by rows
-    colGrowing[location] = true; // Always growing on the leading edge
+        // Set lighting by rows
+        colGrowing[location] = true; // Always growing on the leading edge
 
-    for (unsigned int r = 0; r < NUM_COL; r++) {
-        if (colGrowing[r] == true) {
-            // Climb to end point then start reversing
-            if (colLevels[r] != END_INTENSITY) colLevels[r] = colLevels[r] + INTENSITY_INCR;
-            else colGrowing[r] = false; // Hit endpoint
+        for (unsigned int r = 0; r < NUM_COL; r++) {
+            if (colGrowing[r] == true) {
+                // Climb to end point then start reversing
+                if (colLevels[r] != END_INTENSITY) colLevels[r] = colLevels[r] + INTENSITY_INCR;
+                else colGrowing[r] = false; // Hit endpoint
+            }
+            else {
+                // Decend until hitting base colour
+                if (colLevels[r] != START_INTENSITY) colLevels[r] = colLevels[r] - INTENSITY_INCR;
+            } 
         }
-        else {
-            // Decend until hitting base colour
-            if (colLevels[r] != START_INTENSITY) colLevels[r] = colLevels[r] - INTENSITY_INCR;
-        } 
-    }
 
-    // Check to propagate
-    if ((colLevels[location] == PROPAGATE_LVL) || (colLevels[location] == END_INTENSITY)) {
-        if (rightwards) {
-            if (location == (NUM_COL - 1)) {
-                location = 0;
+        // Check to propagate
+        if ((colLevels[location] == PROPAGATE_LVL) || (colLevels[location] == END_INTENSITY)) {
+            if (rightwards) {
+                if (location == (NUM_COL - 1)) {
+                    location = 0;
+                }
+                else location++;
             }
-            else location++;
-        }
-        else {
-            if (location == 0) {
-                location = NUM_COL - 1;
+            else {
+                if (location == 0) {
+                    location = NUM_COL - 1;
+                }
+                else location--;
             }
-            else location--;
+            colLevels[location] = colLevels[location] + INTENSITY_INCR; // Increment new location
         }
-        colLevels[location] = colLevels[location] + INTENSITY_INCR; // Increment new location
     }
 
-    // Paint LEDs using gamma correction
-    paintColumns(colLevels);
+    // Paint LEDs using gamma correction, once all the steps are done
+    if (stepped) paintColumns(colLevels);
 }
 
 /**
  * \brief Randomly adjusts brightness around entire perimeter
  * \note Kind of like a lava lamp
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Period in milliseconds between each adjustment cycle
  */
-void cloudLED(unsigned long stepMS) {
+void cloudLED(CloudState* state, unsigned long elapsedUS, unsigned long stepMS) {
     const ledlevel_t MAX_INTENSITY = 60;
     const ledlevel_t MIN_INTENSITY = 10;
     const ledlevel_t MAX_INCREMENT = 6;
     const unsigned int NUM_ADJUST = 12; // How many LEDs get adjusted per cycle
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
-
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-
-    // Handle potential reset
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        // Reset to middle light level
-        uniformLED((MIN_INTENSITY + MAX_INTENSITY) / 2);
-        return;
-    }
-
-    // Come up with the adjustments to make
-    bool increase[NUM_ADJUST] = {false};
-    ledInd_t target[NUM_ADJUST] = {0};
+    EffectRandom* random = &state->random;
 
-    for (uint_fast8_t i = 0; i < NUM_ADJUST; i++) {
+    advanceClock(&state->clock, elapsedUS);
 
-        bool uniqueChange = true;
-        do {
-            // Need to use entirely independant bits for each part of a change to avoid correlations
-            unsigned long temp = random();
-            increase[i] = temp & 1;
-            target[i] = constrainIndex(temp >> 1); // Discard direction bit for location calculation
+    bool restart = !state->clock.started; // Start afresh on the first step
+    while (stepDue(&state->clock, stepMS)) {
+        if (restart) {
+            // Reset to middle light level
+            uniformFineLED(((MIN_INTENSITY + MAX_INTENSITY) / 2) << 8);
+            restart = false;
+            continue;
+        }
 
-            uniqueChange = true;
-            for (uint_fast8_t c = 0; c < i; c++) {
-                if (target[c] == target[i]) uniqueChange = false;
+        // Adjust a set of different LEDs, each drawn once so the step always takes the same time
+        // Changes are made in fractions of a level (averaging the same as whole levels from 1 to `MAX_INCREMENT`)
+        state->targets.begin();
+        for (uint_fast8_t i = 0; i < NUM_ADJUST; i++) {
+            ledInd_t target = state->targets.next(random);
+            uint32_t roll = random->next();
+            bool increase = (roll & 1) != 0;
+            uint16_t increment = (((roll >> 16) * (MAX_INCREMENT << 8)) >> 16) + 128;
+
+            uint16_t level = fineLevelLED(target);
+            if (increase == true) {
+                if (level < ((MAX_INTENSITY << 8) - increment)) setFineLED(target, level + increment);
+                else setFineLED(target, MAX_INTENSITY << 8);
+            }
+            if (increase == false) {
+                if (level > ((MIN_INTENSITY << 8) + increment)) setFineLED(target, level - increment);
+                else setFineLED(target, MIN_INTENSITY << 8);
             }
-        } while (uniqueChange == false);
-    }
-    
-    // Enact the changes if valid
-    for (uint_fast8_t i = 0; i < NUM_ADJUST; i++) {
-        ledlevel_t increment = (random() % MAX_INCREMENT) + 1;
-        if (increase[i] == true) {
-            if (LEDgamma[target[i]] < (MAX_INTENSITY - increment))
-                LEDgamma[target[i]] = LEDgamma[target[i]] + increment;
-            else LEDgamma[target[i]] = MAX_INTENSITY;
-        }
-        if (increase[i] == false) {
-            if (LEDgamma[target[i]] > (MIN_INTENSITY + increment))
-                LEDgamma[target[i]] = LEDgamma[target[i]] - increment;
-            else LEDgamma[target[i]] = MIN_INTENSITY;
         }
     }
 }
@@ -971,6 +1474,8 @@ void cloudLED(unsigned long stepMS) {
 /**
  * \brief Tracking lines effect (randomly have columns swap)
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Period in milliseconds between each adjustment cycle
  * \param swapDurMS Duration a swap should last in milliseconds
  * \param widthSwap Distance of columns to be swapped
@@ -978,262 +1483,197 @@ void cloudLED(unsigned long stepMS) {
  * 
  * \note Idle effect is that of cloud but done in columns for visible swapping
  */
-void trackingLED(unsigned long stepMS, unsigned long swapDurMS,
+void trackingLED(TrackingState* state, unsigned long elapsedUS, unsigned long stepMS, unsigned long swapDurMS,
                  unsigned int widthSwap, uint8_t probOfSwap) {
     const ledlevel_t MAX_INTENSITY = 60;
     const ledlevel_t MIN_INTENSITY = 10;
     const ledlevel_t MAX_INCREMENT = 3;
-    static ledlevel_t colIntensity[NUM_COL] = {0};
     const unsigned int NUM_ADJUST = 4;   // How many columns get adjusted per cycle
-    const unsigned int NUM_SWAPS = 3;    // Number of possible simultanious swaps
-
-    struct swap_t {
-        bool enabled = false;       // Is this swap active?
-        unsigned long endTime = 0;  // When to deactivate (based on `millis()` time)
-        ledInd_t location = 0;      // What is the start of this swap
-    };
-    static swap_t swaps[NUM_SWAPS];
-
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
-
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-
-    // Handle potential reset
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-        // Reset to middle light level
-        for (ledInd_t i = 0; i < NUM_COL; i++) colIntensity[i] = (MIN_INTENSITY + MAX_INTENSITY) / 2;
-        paintColumns(colIntensity);
-
-        // Reset swaps
-        for (unsigned int i = 0; i < NUM_SWAPS; i++) swaps[i].enabled = false;
-        return;
-    }
+    const unsigned int NUM_SWAPS = TrackingState::NUM_SWAPS;
 
-    // Come up with the adjustments to make
-    bool increase[NUM_ADJUST] = {false};
-    ledInd_t target[NUM_ADJUST] = {0};
+    ledlevel_t* colIntensity = state->colIntensity;
+    TrackingSwap* swaps = state->swaps;
+    EffectRandom* random = &state->random;
 
-    for (uint_fast8_t i = 0; i < NUM_ADJUST; i++) {
+    advanceClock(&state->clock, elapsedUS);
 
-        bool uniqueChange = true;
-        do {
-            // Need to use entirely independant bits for each part of a change to avoid correlations
-            unsigned long temp = random();
-            increase[i] = temp & 1;
-            target[i] = constrainIndex((temp >> 1), NUM_COL); // Discard direction bit for location calculation
+    bool restart = !state->clock.started; // Start afresh on the first step
+    bool stepped = false;
+    while (stepDue(&state->clock, stepMS)) {
+        unsigned long currentTime = state->clock.stepTime;
+        stepped = true;
 
-            uniqueChange = true;
-            for (uint_fast8_t c = 0; c < i; c++) {
-                if (target[c] == target[i]) uniqueChange = false;
-            }
-        } while (uniqueChange == false);
-    }
-    
-    // Enact the changes if valid
-    for (uint_fast8_t i = 0; i < NUM_ADJUST; i++) {
-        ledlevel_t increment = (random() % MAX_INCREMENT) + 1;
-        if (increase[i] == true) {
-            if (colIntensity[target[i]] < (MAX_INTENSITY - increment))
-                colIntensity[target[i]] = colIntensity[target[i]] + increment;
-            else colIntensity[target[i]] = MAX_INTENSITY;
+        if (restart) {
+            // Reset to middle light level
+            for (ledInd_t i = 0; i < NUM_COL; i++) colIntensity[i] = (MIN_INTENSITY + MAX_INTENSITY) / 2;
+            paintColumns(colIntensity);
+
+            // Reset swaps
+            for (unsigned int i = 0; i < NUM_SWAPS; i++) swaps[i].enabled = false;
+            restart = false;
+            continue;
         }
-        if (increase[i] == false) {
-            if (colIntensity[target[i]] > (MIN_INTENSITY + increment))
-                colIntensity[target[i]] = colIntensity[target[i]] - increment;
-            else colIntensity[target[i]] = MIN_INTENSITY;
+
+        // Adjust a set of different columns, each drawn once so the step always takes the same time
+        state->targets.begin();
+        for (uint_fast8_t i = 0; i < NUM_ADJUST; i++) {
+            ledInd_t target = state->targets.next(random);
+            uint32_t roll = random->next();
+            bool increase = (roll & 1) != 0;
+            ledlevel_t increment = (((roll >> 16) * MAX_INCREMENT) >> 16) + 1;
+
+            if (increase == true) {
+                if (colIntensity[target] < (MAX_INTENSITY - increment))
+                    colIntensity[target] = colIntensity[target] + increment;
+                else colIntensity[target] = MAX_INTENSITY;
+            }
+            if (increase == false) {
+                if (colIntensity[target] > (MIN_INTENSITY + increment))
+                    colIntensity[target] = colIntensity[target] - increment;
+                else colIntensity[target] = MIN_INTENSITY;
+            }
         }
-    }
 
-    // Work through swaps
-    for (unsigned int i = 0; i < NUM_SWAPS; i++) {
-        if (swaps[i].enabled == true) {
-            if (currentTime > swaps[i].endTime) {
-                swaps[i].enabled = false;
+        // Work through swaps
+        for (unsigned int i = 0; i < NUM_SWAPS; i++) {
+            if (swaps[i].enabled == true) {
+                if (currentTime > swaps[i].endTime) {
+                    swaps[i].enabled = false;
+
+                    // Undo the swap
+                    ledlevel_t temp = colIntensity[swaps[i].location];
+                    colIntensity[swaps[i].location] = 
+                        colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)];
+                    colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)] = temp;
+                }
+            }
+            else {
+                // Check if it should swap
+                if (!random->chance(probOfSwap)) continue;
+
+                // Generate a swap that doesn't overlap another currently active swap
+                // Columns are drawn without repeats, so at most one more than the number of clashes is drawn
+                state->targets.begin();
+                bool uniqueSwap = false;
+                while (!uniqueSwap) {
+                    ledInd_t location = state->targets.next(random);
+                    if (location >= NUM_COL) break; // Nowhere left, can only happen with very wide swaps
+                    swaps[i].location = location;
+
+                    uniqueSwap = true;
+                    for (uint_fast8_t c = 0; c < NUM_SWAPS; c++) {
+                        if (swaps[c].enabled == false) continue;
+                        if (c == i) continue; // Don't compare to itself
+                        if (swaps[i].location == swaps[c].location) uniqueSwap = false;
+                        if (swaps[i].location == constrainIndex(swaps[c].location + widthSwap, NUM_COL)) 
+                            uniqueSwap = false;
+                    }
+                }
+                if (!uniqueSwap) continue;
+
+                swaps[i].enabled = true;
+                swaps[i].endTime = currentTime + swapDurMS;
 
-                // Undo the swap
+                // Perform the swap
                 ledlevel_t temp = colIntensity[swaps[i].location];
-                colIntensity[swaps[i].location] = 
-                    colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)];
+                colIntensity[swaps[i].location] = colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)];
                 colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)] = temp;
             }
         }
-        else {
-            // Check if it should swap
-            unsigned long roll = random();
-            swaps[i].enabled = (roll & 0xFF) < probOfSwap;
-
-            if (!swaps[i].enabled) continue;
-
-            swaps[i].endTime = currentTime + swapDurMS;
-
-            // Generate a swap that doesn't overlap another currently active swap
-            bool uniqueSwap = true;
-            do {
-                roll = random();
-                swaps[i].location = constrainIndex(roll, NUM_COL);
-
-                uniqueSwap = true;
-                for (uint_fast8_t c = 0; c < NUM_SWAPS; c++) {
-                    if (swaps[c].enabled == false) continue;
-                    if (c == i) continue; // Don't compare to itself
-                    if (swaps[i].location == swaps[c].location) uniqueSwap = false;
-                    if (swaps[i].location == constrainIndex(swaps[c].location + widthSwap, NUM_COL)) 
-                        uniqueSwap = false;
-                }
-            } while (uniqueSwap == false);
-
-            // Perform the swap
-            ledlevel_t temp = colIntensity[swaps[i].location];
-            colIntensity[swaps[i].location] = colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)];
-            colIntensity[constrainIndex(swaps[i].location + widthSwap, NUM_COL)] = temp;
-        }
     }
 
-    paintColumns(colIntensity);
+    if (stepped) paintColumns(colIntensity);
 }
 
 /**
  * \brief Has some bumps moving around the board edge randomly
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Period in milliseconds between each adjustment cycle
+ * \param numBumps Number of bumps, at most `BumpsState::MAX_BUMP`
  * \param probOfStart Likelihood of a swap per cycle out of 255
+ * 
+ * \note The nearest bump sets the level of an LED where bumps overlap
  */
-void bumpsLED(unsigned long stepMS, uint8_t probOfStart) {
+void bumpsLED(BumpsState* state, unsigned long elapsedUS, unsigned long stepMS, uint8_t numBumps, 
+        uint8_t probOfStart) {
     const ledlevel_t BASE_INTENSITY = 10;
-    const unsigned int NUM_BUMP = 3;                // Number of bumps
     const unsigned int MAX_MOVEMENT_PERIOD = 50;    // Maximum period between bump steps
     const unsigned int MIN_MOVEMENT_PERIOD = 10;    // Minimum period for bump steps
-    const unsigned int MAX_MOVEMENT_STEP_SIZE = 1;  // The maximum number of LEDs moved per step
     const unsigned int MAX_NUMBER_OF_STEPS = 20;    // The maximum number of movement steps per motion
-    ledlevel_t STAGES[] = {NUM_GAMMA, 55, 35, 20, BASE_INTENSITY}; 
-    // Gamma intensities of the bumps going around
-    // Need to include background to reset 
-    const int NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
-
-    struct bump_t {
-        unsigned long moveTime = 0; // When to move again (based on `millis()` time)
-        unsigned int movePeriod = 0;
-        ledInd_t location = 0;      // Location of bump center
-        ledInd_t numKeyPoints = 0;
-        ledlevel_t* keypoints;      // Points to array for key stages
-        int motionIncrement = 0;    // Size of each step (counterclockwise if negative)
-        int stepsRemaining = 0;
-    };
-    static struct bump_t bump[NUM_BUMP];
-
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
-
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-
-    // Reset to base
-    uniformLED(BASE_INTENSITY);
-
-    // Handle potential reset
-    bool restart = checkReset(nextMark, stepMS, currentTime);
-    nextMark = currentTime + stepMS; // Update mark after reset check
-    if (restart == true) {
-
-        // Reset bumps
-        const ledInd_t SPACING = NUM_LED / NUM_BUMP;
-        for (unsigned int i = 0; i < NUM_BUMP; i++) {
-            bump[i].location = i * SPACING;
-            bump[i].stepsRemaining = 0;
-            bump[i].keypoints = STAGES;
-            bump[i].numKeyPoints = NUM_STAGES;
-            bump[i].moveTime = 0;
-            bump[i].movePeriod = MAX_MOVEMENT_PERIOD;
-            bump[i].motionIncrement = 0; // Clockwise if true
-        }
-
-        // Do not return, continue to execute
-    }
-
-    // Set up the bumps
-    for (unsigned int i = 0; i < NUM_BUMP; i++) {
-        // Bump on the move?
-        if (bump[i].stepsRemaining > 0) {
-            if (currentTime > bump[i].moveTime) {
-                // Bump on the move!
-                bump[i].location = bump[i].location + bump[i].motionIncrement;
-                bump[i].location = constrainIndex(bump[i].location);
-
-                bump[i].stepsRemaining--;
-                bump[i].moveTime = currentTime + bump[i].movePeriod;
+    static const ledlevel_t STAGES[] = {NUM_GAMMA, 55, 35, 20}; 
+    // Gamma intensities of the bumps going around, from their crest out
+    const uint8_t NUM_STAGES = sizeof(STAGES) / sizeof(STAGES[0]);
+
+    LEDParticle* bump = state->bump;
+    EffectRandom* random = &state->random;
+    if (numBumps > BumpsState::MAX_BUMP) numBumps = BumpsState::MAX_BUMP;
+    if (numBumps == 0) numBumps = 1;
+
+    advanceClock(&state->clock, elapsedUS);
+
+    bool restart = !state->clock.started; // Start afresh on the first step
+    while (stepDue(&state->clock, stepMS)) {
+        if (restart) {
+            // Reset bumps, spread out evenly and stationary
+            const ledInd_t SPACING = NUM_LED / numBumps;
+            for (unsigned int i = 0; i < numBumps; i++) {
+                bump[i] = LEDParticle();
+                bump[i].position = (int32_t)(i * SPACING) << 16;
+                bump[i].lifeMS = PARTICLE_FOREVER;
+                bump[i].moveMS = 0;
+                bump[i].profile = STAGES;
+                bump[i].width = NUM_STAGES;
             }
-            continue; // Skip to next bump
-        }
+            restart = false;
 
-        // Stationary bump, will it move?
-        unsigned long roll = random();
-        if ((roll & 0xFF) >= probOfStart) continue; // Not moving, go to next bump
+            // Do not skip the step, continue to execute
+        }
 
-        // Set up new motion
-        roll = random();
-        bump[i].stepsRemaining = 1 + (roll & 0xFFUL) % MAX_NUMBER_OF_STEPS;
+        // Start stationary bumps moving at random
+        for (unsigned int i = 0; i < numBumps; i++) {
+            if (bump[i].moveMS > 0) continue; // Still on the move
+            if (!random->chance(probOfStart)) continue; // Not moving, go to next bump
 
-        // Decide on a motion, occasionally negative
-        bump[i].motionIncrement = 1 + (roll & 0xFF00UL) % MAX_MOVEMENT_STEP_SIZE;
-        if ((roll & 0x10000UL) == 0) bump[i].motionIncrement = -bump[i].motionIncrement;
+            // Set up new motion, a number of LEDs at a set pace, occasionally counterclockwise
+            uint32_t roll = random->next();
+            unsigned int steps = 1 + (((roll & 0xFFFF) * MAX_NUMBER_OF_STEPS) >> 16);
+            unsigned int period = MIN_MOVEMENT_PERIOD + 
+                (((roll >> 16) * (MAX_MOVEMENT_PERIOD - MIN_MOVEMENT_PERIOD)) >> 16);
 
-        bump[i].movePeriod = (roll & 0xFFFE0000UL) % (MAX_MOVEMENT_PERIOD - MIN_MOVEMENT_PERIOD);
-        bump[i].movePeriod = MIN_MOVEMENT_PERIOD + bump[i].movePeriod;
-        bump[i].moveTime = currentTime + bump[i].movePeriod;
+            bump[i].velocity = particleSpeed(1, period);
+            if (random->chance(128)) bump[i].velocity = -bump[i].velocity;
+            bump[i].moveMS = steps * period;
+        }
     }
 
-    // Render the bumps
-    // Need to be careful to not overwrite bumps incorrectly when in proximity
-    // Want to preserve the information/brightness of the closest bump
-    for (unsigned int i = 0; i < NUM_BUMP; i++) {
-        LEDgamma[bump[i].location] = bump[i].keypoints[0]; // Always paint crest of a bump
-
-        // Extend out in a direction unless it encounter another bump that will be dominant
-        bool isDomForwards = true;
-        bool isDomBackwards = true;
-        for (ledInd_t offset = 1; offset < NUM_STAGES; offset++) {
-            ledInd_t tarIndFwd = constrainIndex(bump[i].location + offset);
-            ledInd_t tarIndBack = constrainIndex(bump[i].location - offset);
-
-            // Scan along a second offset from the current offset to compare to other bumps
-            for (int so = 0; so < offset; so++) {
-                for (unsigned int c = 0; c < NUM_BUMP; c++) {
-                    ledInd_t doubOffsetFwd = constrainIndex(tarIndFwd + so);
-                    ledInd_t doubOffsetBack = constrainIndex(tarIndFwd - so);
-                    if (bump[c].location == doubOffsetFwd) isDomForwards = false;
-                    if (bump[c].location == doubOffsetBack) isDomBackwards = false;
-                }
-            }
+    // Bumps glide between steps, they settle back on an LED when they stop
+    stepParticlesLED(bump, numBumps, state->clock.deltaMS, NUM_LED, true);
 
-            // Paint only if still dominant in that direction
-            if (isDomForwards) LEDgamma[tarIndFwd] = STAGES[offset];
-            if (isDomBackwards) LEDgamma[tarIndBack] = STAGES[offset];
-        }
-    }
+    uniformLED(BASE_INTENSITY);
+    renderParticlesLED(bump, numBumps, LEDgamma, NUM_LED, true, LEDBlend::BLEND_MAX);
 }
 
 /**
  * \brief Uniform illumination based on overall sound RMS
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates
  * \param leftRMS RMS of left audio channel (should be between 0 and 1)
  * \param rightRMS RMS of right audio channel (should be between 0 and 1)
  * 
  * \note Although this doesn't truely need to be paced, it's included to pace updates to lighting chips
  */
-void audioUniformLED(unsigned long stepMS, double leftRMS, double rightRMS) {
+void audioUniformLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+        double rightRMS) {
     const double SCALING = 7.0;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Determine overall RMS, clamp it to 1 at max
@@ -1249,11 +1689,14 @@ void audioUniformLED(unsigned long stepMS, double leftRMS, double rightRMS) {
 /**
  * \brief Tracks the audio balancing left to right with a block
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates
  * \param leftRMS RMS of left audio channel (should be between 0 and 1)
  * \param rightRMS RMS of right audio channel (should be between 0 and 1)
  */
-void audioBalanceLED(unsigned long stepMS, double leftRMS, double rightRMS) {
+void audioBalanceLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+        double rightRMS) {
     // When adjusting these constants adjust them in this order: scaling -> width -> exaggerate
     const float SCALING_RMS =  8.0; // RMS scaling
     const float EXAGGERATE  =  2.0; // How much to exaggerate the stereo imbalance
@@ -1263,12 +1706,10 @@ void audioBalanceLED(unsigned long stepMS, double leftRMS, double rightRMS) {
     const ledlevel_t BASE_LEVEL = 10;
     const ledlevel_t PEAK_LEVEL = 63;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Perform level rule to interpolate values between edges
@@ -1360,20 +1801,21 @@ void filterSpectrum(double lIn[], double rIn[], double lOut[], double rOut[]) {
 /**
  * \brief Horizontal spectrum graph across the entire board
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates (ms)
  * \param left Left spectrum magnitudes
  * \param right Right spectrum magnitudes
  * \param leftToRight Should the lowest frequencies start at the left (true) or right
  */
-void audioHoriSpectrumLED(unsigned long stepMS, double left[], double right[], bool leftToRight) {
+void audioHoriSpectrumLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double left[], 
+        double right[], bool leftToRight) {
     const double SCALING = NUM_GAMMA / 2; // Spectrum levels are clamped to 1
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Acquire the trimmed response and combine into one array
@@ -1399,95 +1841,117 @@ void audioHoriSpectrumLED(unsigned long stepMS, double left[], double right[], b
 /**
  * \brief Shows a split spectrum for each channel
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates (ms)
  * \param left Left spectrum magnitudes
  * \param right Right spectrum magnitudes
  * \param bottomToTop Should the spectrum start with the lowest frequencies at the bottom (true) or not
  */
-void audioSplitSpectrumLED(unsigned long stepMS, double left[], double right[], bool bottomToTop) {
+void audioSplitSpectrumLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double left[], 
+        double right[], bool bottomToTop) {
     const double SCALING = NUM_GAMMA;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Acquire the trimmed response and combine into one array
     double lRes[NUM_LED / 2], rRes[NUM_LED / 2]; 
     filterSpectrum(left, right, lRes, rRes);
 
-    int baseLocation = 0;
-    if (bottomToTop) baseLocation = LEDmiddleIndex[1];
-    else baseLocation = LEDmiddleIndex[3];
+    LEDAnchor base = bottomToTop ? LEDAnchor::MIDDLE_BOTTOM : LEDAnchor::MIDDLE_TOP;
 
-    // Get the levels for the graph
-    for (int i = 0; i < (NUM_LED / 2); i++) {
-        ledInd_t curLeft, curRight;
-        if (bottomToTop) {
-            curLeft = constrainIndex(baseLocation + i + 1);
-            curRight = constrainIndex(baseLocation - i);
-        }
-        else {
-            curRight = constrainIndex(baseLocation + i + 1);
-            curLeft = constrainIndex(baseLocation - i);
-        }
-        LEDgamma[curLeft] = lRes[i] * SCALING;
-        LEDgamma[curRight] = rRes[i] * SCALING;
+    // Get the levels for the graph, left channel on the left side and both starting from the base
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        int8_t offset = LEDgeometry[i].anchorOffset[base];
+        ledInd_t steps = anchorSteps(offset);
+
+        if ((offset >= 0) == bottomToTop) LEDgamma[i] = lRes[steps] * SCALING;
+        else LEDgamma[i] = rRes[steps] * SCALING;
     }
 }
 
 /**
  * \brief Shows a split spectrum for each channel but gradually rotating around
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates (ms)
  * \param left Left spectrum magnitudes
  * \param right Right spectrum magnitudes
  * \param clockwise Should the spectrum start with the lowest frequencies at the bottom (true) or not
  */
-void audioSplitSpectrumSpinLED(unsigned long stepMS, double left[], double right[], bool clockwise) {
+void audioSplitSpectrumSpinLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double left[], 
+        double right[], bool clockwise) {
+    advanceClock(&state->clock, elapsedUS);
+
+    // The rotation takes a step for every step due, so it keeps pace under load
+    ledInd_t steps = 0;
+    while (stepDue(&state->clock, stepMS)) steps++;
+    if (steps == 0) return;
+    // There's no need to handle resets since this is a instantanious effect
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    // Just run the normal split and then step the frame's rotation
+    // Stepping the rotation this way lets the direction be seemlessly switched
+    PacedState split; // Fresh state so the split draws straight away, pacing is done here
+    audioSplitSpectrumLED(&split, 0, stepMS, left, right, true);
+    rotateLED(steps, clockwise);
+}
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
-    // There's no need to handle resets since this is a instantanious effect
+/**
+ * \brief Moves a volume peak mark up to a new location, it holds there for a period before falling back
+ * 
+ * \param peak Peak mark to place
+ * \param location Index it is placed on, in the line of rows or columns
+ * \param fallMS Time the mark takes to fall back by each LED
+ * \param fallsUp If it falls back towards higher indices, otherwise towards lower
+ */
+void placePeak(LEDParticle* peak, ledInd_t location, unsigned long fallMS, bool fallsUp) {
+    static const ledlevel_t PEAK_PROFILE[] = {63};
 
-    // Just run the normal split and then rotate
-    static int rotation = 0;
-    audioSplitSpectrumLED(stepMS, left, right, true);
-    rotateLED(rotation, true);
+    peak->profile = PEAK_PROFILE;
+    peak->width = 1;
+    peak->lifeMS = PARTICLE_FOREVER;
+    peak->moveMS = PARTICLE_FOREVER;
 
-    // Accumulate rotations this way so rotation can be seemlessly switched
-    if (clockwise) rotation++;
-    else rotation--;
-    rotation = constrainIndex(rotation);
+    // Starts on the far side of the LED from where it falls, so it is shown there for a whole period
+    peak->velocity = particleSpeed(1, fallMS);
+    if (fallsUp) peak->position = ((int32_t)location << 16) - 0x8000;
+    else {
+        peak->position = ((int32_t)location << 16) + 0x7FFF;
+        peak->velocity = -peak->velocity;
+    }
 }
 
 /**
  * \brief Vertical volume bar efect
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates
  * \param leftRMS RMS of left audio channel (should be between 0 and 1)
  * \param rightRMS RMS of right audio channel (should be between 0 and 1)
  * \param bottomToTop Paint volume from bottom (true) or top
  */
-void audioVertVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool bottomToTop) {
+void audioVertVolLED(VolumeState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+        double rightRMS, bool bottomToTop) {
     const double SCALING = 8.0;
     const unsigned int FALLDOWN_PERIOD = 200;
     const ledlevel_t PEAK_INTENSITY = 63;
     const ledlevel_t BASE_INTENSITY = 10;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
+
+    // Upper mark, falls at a set rate whatever the frame rate
+    LEDParticle* peak = &state->peak;
+    if (peak->lifeMS == 0) placePeak(peak, 0, FALLDOWN_PERIOD, false);
+    stepParticlesLED(peak, 1, state->clock.deltaMS, NUM_ROW, false);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Overall RMS, clamp to 1
@@ -1505,22 +1969,13 @@ void audioVertVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool
     for (ledInd_t i = 0; i < fullRow; i++) rows[i] = PEAK_INTENSITY;
     rows[fullRow] = (PEAK_INTENSITY - BASE_INTENSITY) * partialRow;
 
-    // Upper mark, falls at a set rate
-    static unsigned long nextPeakMark = 0;
-    static ledInd_t peakLocation = NUM_ROW - 1;
-
-    if (fullRow >= peakLocation) {
-        peakLocation = fullRow + 1;
+    // Upper mark is pushed up by the bar
+    if (fullRow >= particleIndex(peak)) {
+        ledInd_t peakLocation = fullRow + 1;
         if (peakLocation > NUM_ROW - 1) peakLocation = NUM_ROW - 1;
-        nextPeakMark = currentTime + FALLDOWN_PERIOD;
+        placePeak(peak, peakLocation, FALLDOWN_PERIOD, false);
     }
-
-    if (nextPeakMark < currentTime) {
-        nextPeakMark = currentTime + FALLDOWN_PERIOD;
-
-        if (peakLocation > 0) peakLocation--;
-    }
-    rows[peakLocation] = PEAK_INTENSITY;
+    renderParticlesLED(peak, 1, rows, NUM_ROW, false, LEDBlend::BLEND_MAX);
 
     // Reverse if needed
     if (bottomToTop == false) {
@@ -1535,23 +1990,29 @@ void audioVertVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool
 /**
  * \brief Horizontal volume bar effect
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates
  * \param leftRMS RMS of left audio channel (should be between 0 and 1)
  * \param rightRMS RMS of right audio channel (should be between 0 and 1)
  * \param leftToRight Should the bar go from the left (true) or right?
  */
-void audioHoriVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool leftToRight) {
+void audioHoriVolLED(VolumeState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+        double rightRMS, bool leftToRight) {
     const double SCALING = 8.0;
     const unsigned int FALLDOWN_PERIOD = 100;
     const ledlevel_t PEAK_INTENSITY = 63;
     const ledlevel_t BASE_INTENSITY = 10;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Upper mark, falls at a set rate whatever the frame rate
+    LEDParticle* peak = &state->peak;
+    if (peak->lifeMS == 0) placePeak(peak, 0, FALLDOWN_PERIOD, false);
+    stepParticlesLED(peak, 1, state->clock.deltaMS, NUM_COL, false);
+
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Calculate overall RMS, clamped to 1
@@ -1569,22 +2030,13 @@ void audioHoriVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool
     for (ledInd_t i = 0; i < fullCol; i++) cols[i] = PEAK_INTENSITY;
     cols[fullCol] = (PEAK_INTENSITY - BASE_INTENSITY) * partialCol;
 
-    // Upper mark, falls at a set rate
-    static unsigned long nextPeakMark = 0;
-    static ledInd_t peakLocation = NUM_COL - 1;
-
-    if (fullCol >= peakLocation) {
-        peakLocation = fullCol + 1;
+    // Upper mark is pushed up by the bar
+    if (fullCol >= particleIndex(peak)) {
+        ledInd_t peakLocation = fullCol + 1;
         if (peakLocation >= NUM_COL - 1) peakLocation = NUM_COL - 1;
-        nextPeakMark = currentTime + FALLDOWN_PERIOD;
-    }
-
-    if (nextPeakMark < currentTime) {
-        nextPeakMark = currentTime + FALLDOWN_PERIOD;
-
-        if (peakLocation > 0) peakLocation--;
+        placePeak(peak, peakLocation, FALLDOWN_PERIOD, false);
     }
-    cols[peakLocation] = PEAK_INTENSITY;
+    renderParticlesLED(peak, 1, cols, NUM_COL, false, LEDBlend::BLEND_MAX);
 
     // Reverse if needed
     if (leftToRight == false) {
@@ -1599,22 +2051,36 @@ void audioHoriVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool
 /**
  * \brief Horizontal split volume for channels
  * 
+ * \param state State of the effect
+ * \param elapsedUS Time since the effect was last rendered
  * \param stepMS Time between updates
  * \param leftRMS RMS of left audio channel (should be between 0 and 1)
  * \param rightRMS RMS of right audio channel (should be between 0 and 1)
  */
-void audioHoriSplitVolLED(unsigned long stepMS, double leftRMS, double rightRMS) {
+void audioHoriSplitVolLED(SplitVolumeState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+        double rightRMS) {
     const double SCALING = 4.0;
     const unsigned int FALLDOWN_PERIOD = 150;
     const ledlevel_t PEAK_INTENSITY = 63;
     const ledlevel_t BASE_INTENSITY = 10;
 
-    static unsigned long nextMark = 0;      // Marks next time to adjust brightness
-    unsigned long currentTime = millis();
+    advanceClock(&state->clock, elapsedUS);
 
-    // Check if it is time to adjust effects or not
-    if (nextMark > currentTime) return;
-    nextMark = currentTime + stepMS;
+    // Upper marks, each falls back towards the middle at a set rate whatever the frame rate
+    // They start at the edges and stop falling on the first column of their side
+    LEDParticle* peak = state->peak;
+    if (peak[0].lifeMS == 0) {
+        placePeak(&peak[0], 0, FALLDOWN_PERIOD, true);
+        placePeak(&peak[1], NUM_COL - 1, FALLDOWN_PERIOD, false);
+    }
+    stepParticlesLED(peak, 2, state->clock.deltaMS, NUM_COL, false);
+    const int32_t LEFT_STOP = (int32_t)(NUM_COL / 2) << 16;
+    const int32_t RIGHT_STOP = (int32_t)((NUM_COL / 2) + 1) << 16;
+    if (peak[0].position > LEFT_STOP) peak[0].position = LEFT_STOP;
+    if (peak[1].position < RIGHT_STOP) peak[1].position = RIGHT_STOP;
+
+    // Check if it is time to adjust effects or not, only the latest audio is shown so missed updates are dropped
+    if (!paceDue(&state->clock, stepMS)) return;
     // There's no need to handle resets since this is a instantanious effect
 
     // Calculate volumes
@@ -1625,11 +2091,6 @@ void audioHoriSplitVolLED(unsigned long stepMS, double leftRMS, double rightRMS)
     ledlevel_t cols[NUM_COL];
     for (ledInd_t i = 0; i < NUM_COL; i++) cols[i] = BASE_INTENSITY;
 
-
-    // Upper mark, falls at a set rate
-    static unsigned long nextPeakMark[2] = {0}; // Records when to move upper mark down for each side
-    static ledInd_t peakLocation[2] = {0, NUM_COL - 1}; // Record upper mark for each side
-
     for (int i = 0; i < 2; i++) {
 
         if (partialCol[i] > NUM_COL / 2) partialCol[i] = NUM_COL / 2;
@@ -1643,10 +2104,8 @@ void audioHoriSplitVolLED(unsigned long stepMS, double leftRMS, double rightRMS)
             for (ledInd_t i = 0; i < fullCol; i++) cols[BASE - i] = PEAK_INTENSITY;
             cols[BASE - fullCol] = (PEAK_INTENSITY - BASE_INTENSITY) * partialCol[i];
 
-            if ((NUM_COL / 2) - fullCol < peakLocation[i]) {
-                peakLocation[i] = (NUM_COL / 2) - fullCol;
-                nextPeakMark[i] = currentTime + FALLDOWN_PERIOD;
-            }
+            if ((NUM_COL / 2) - fullCol < particleIndex(&peak[i])) 
+                placePeak(&peak[i], (NUM_COL / 2) - fullCol, FALLDOWN_PERIOD, true);
         }
         else {
             // Right
@@ -1654,24 +2113,14 @@ void audioHoriSplitVolLED(unsigned long stepMS, double leftRMS, double rightRMS)
             for (ledInd_t i = 0; i < fullCol; i++) cols[i + BASE] = PEAK_INTENSITY;
             cols[fullCol + BASE + 1] = (PEAK_INTENSITY - BASE_INTENSITY) * partialCol[i];
 
-            if (fullCol + (NUM_COL / 2) + 1 >= peakLocation[i]) {
-                peakLocation[i] = fullCol + (NUM_COL / 2);
-                nextPeakMark[i] = currentTime + FALLDOWN_PERIOD;
-            }
-        }
-
-        if (nextPeakMark[i] < currentTime) {
-            nextPeakMark[i] = currentTime + FALLDOWN_PERIOD;
-
-            if (i == 0) {
-                if (peakLocation[i] < (NUM_COL / 2)) peakLocation[i]++;
-            }
-            else {
-                if (peakLocation[i] > ((NUM_COL / 2) + 1)) peakLocation[i]--;
+            if (fullCol + (NUM_COL / 2) + 1 >= particleIndex(&peak[i])) {
+                ledInd_t peakLocation = fullCol + (NUM_COL / 2);
+                if (peakLocation > NUM_COL - 1) peakLocation = NUM_COL - 1;
+                placePeak(&peak[i], peakLocation, FALLDOWN_PERIOD, false);
             }
         }
-        cols[peakLocation[i]] = PEAK_INTENSITY;
     }
+    renderParticlesLED(peak, 2, cols, NUM_COL, false, LEDBlend::BLEND_MAX);
 
     paintColumns(cols);
 }
@@ -5,6 +5,7 @@
 
 #include "../../include/enumerators.h"
 #include "is31fl3236.hpp"
+#include "led_random.hpp"
 
 typedef uint8_t ledlevel_t;
 typedef int8_t ledInd_t;
@@ -14,16 +15,78 @@ typedef int8_t ledInd_t;
 LED brightness is stored in an array going clockwise from the top LED
 on the right side of the logo. There are some constant to mark out 
 key locations, following the same clockwise from right top scheme.
+
+The brightness array is part of a frame, which also holds a rotation.
+The rotation is only applied when the frame is sent to the drivers, so
+effects can turn the whole frame without moving any of its contents.
+Rotations add up, with clockwise being positive.
+
+Each running effect has a frame of its own, effects draw into whichever
+frame is targeted at the time (`LEDtarget`).
+
+Slow effects can also draw between the gamma levels using the frame's
+fractions, which are shown by dithering the duties over successive
+frames. Effects that don't use them leave them at zero.
 */
-extern const ledInd_t NUM_LED; // Number of LEDs lining the board
-extern const ledInd_t NUM_ROW; // Number of rows the LEDs form
-extern const ledInd_t NUM_COL; // Number of columns the LEDs form
+constexpr ledInd_t NUM_LED = 72; // Number of LEDs lining the board
+constexpr ledInd_t NUM_ROW = 8;  // Number of rows the LEDs form
+constexpr ledInd_t NUM_COL = 30; // Number of columns the LEDs form
+constexpr unsigned int NUM_GAMMA = 64; // Number of perceptable "gamma" levels available
+
+struct LEDFrame {
+    ledlevel_t gamma[NUM_LED] = {0};    // Gamma level of each LED, before rotation
+    uint8_t fraction[NUM_LED] = {0};    // Fraction of a level above `gamma` for each LED (Q8)
+    ledInd_t rotation = 0;              // Places the frame is turned clockwise when shown
+};
 
-extern ledlevel_t LEDlevel[];
-extern ledInd_t LEDstartIndex[];
-extern ledInd_t LEDmiddleIndex[];
+extern LEDFrame* LEDtarget;
+
+extern const ledInd_t LEDstartIndex[];
+extern const ledInd_t LEDmiddleIndex[];
 extern ledInd_t LEDbutton[];
 
+/* LED Geometry
+
+Where each LED sits on the board is worked out at compile time, so 
+effects can paint by position with a single table lookup per LED rather
+than walking each side of the board with their own index arithmetic.
+
+Rows and columns are those used by `paintRows` and `paintColumns`. The
+anchors are points between two LEDs that effects spread out from (the
+corners and the middle of each side), the offset to an anchor counts
+LEDs clockwise from it as 0, 1, 2... and anticlockwise as -1, -2, -3...
+*/
+enum LEDAnchor : uint8_t {
+    CORNER_TOP_RIGHT = 0,
+    CORNER_BOTTOM_RIGHT,
+    CORNER_BOTTOM_LEFT,
+    CORNER_TOP_LEFT,
+    MIDDLE_RIGHT,
+    MIDDLE_BOTTOM,
+    MIDDLE_LEFT,
+    MIDDLE_TOP,
+    NUM_ANCHORS
+};
+
+struct LEDGeometry {
+    uint8_t row = 0;                    // Bottom row is row 0
+    uint8_t col = 0;                    // Left column is column 0
+    uint8_t x = 0;                      // Horizontal position, 0 (left) to 255 (right)
+    uint8_t y = 0;                      // Vertical position, 0 (bottom) to 255 (top)
+    uint8_t angle = 0;                  // Direction from the centre of the board, clockwise from up (256 per turn)
+    uint8_t cornerDistance[4] = {0};    // Straight line distance to each corner in `LEDAnchor` order (eighths of the LED spacing)
+    int8_t anchorOffset[NUM_ANCHORS] = {0}; // Position relative to each anchor along the LEDs
+};
+
+extern const LEDGeometry* const LEDgeometry;
+
+/**
+ * \brief Converts an offset from an anchor into the number of LEDs away from it, regardless of direction
+ */
+inline ledInd_t anchorSteps(int8_t offset) {
+    return (offset >= 0) ? offset : -(offset + 1);
+}
+
 enum ledFSMstates {
     SOLID = 0,          // Uniform and steady glow
     BREATH,             // Uniform breathing effect
@@ -42,42 +105,300 @@ enum ledFSMstates {
     AUD_SPLIT_SPIN,     // Split spectrum graph left/right, but continuously rotating
     AUD_HORI_VOL,       // Horizontal volume effect
     AUD_HORI_SPLIT_VOL, // Split volume as horizontal effect
-    AUD_VERT_VOL        // Vertical volume effect
+    AUD_VERT_VOL,       // Vertical volume effect
+    PLASMA,             // Slowly swirling plasma drawn on the canvas
+    ANIMATION,          // Plays an animation stored in flash
+    NUM_LED_STATES
+};
+
+extern ledFSMstates LEDstate;
+
+enum LEDTransition : uint8_t {
+    CUT = 0,            // Switch immediately
+    FADE,               // Crossfade all LEDs together
+    WIPE,               // Sweep clockwise around the perimeter from the top right corner
+    DISSOLVE,           // LEDs change over one by one in a scattered order
+    NUM_TRANSITIONS
+};
+
+/* LED Layers
+
+Effects can be stacked on top of the one run by the FSM as layers, like
+an audio effect over a slow background. Each layer runs an effect from
+the registry into its own frame, which is blended over the layers below
+it with an opacity (Q8, 256 being opaque). Layers come from a fixed
+pool, the FSM's effect always being the bottom one.
+*/
+constexpr uint8_t MAX_LED_LAYERS = 4; // Layers that can be shown at once, including the FSM's effect
+
+enum LEDBlend : uint8_t {
+    BLEND_ADD = 0,      // Levels add together
+    BLEND_MAX,          // Brightest of the levels
+    BLEND_MULTIPLY,     // Layer dims what is below it
+    BLEND_ALPHA,        // Layer covers what is below it
+    NUM_BLENDS
+};
+
+extern const int LED_LAYER_FAIL;
+extern const int LED_LAYER_SUCCESS;
+
+/* LED Effect Time
+
+Effects are animated from time rather than from how often they are
+rendered, so they look the same whatever the frame rate and don't stall
+when a frame runs long. Each render gives the effect the time elapsed
+since its last one, which it adds to its own clock.
+
+Effects that work in steps take however many steps are due by their
+clock, catching up after a long frame (up to a limit, past which the
+backlog is dropped). Timings within a step use the time the step was
+due. Others work out where they are in their cycle from the time.
+*/
+struct EffectClock {
+    unsigned long timeMS = 0;           // Time the effect has been running for
+    unsigned long carryUS = 0;          // Elapsed time not yet making up a whole millisecond
+    unsigned long deltaMS = 0;          // Time the clock moved on by in the current render
+    unsigned long nextMark = 0;         // Marks the time the next step is due
+    unsigned long stepTime = 0;         // Time the current step was due
+    uint8_t steps = 0;                  // Steps taken in the current render
+    bool started = false;               // Set once the effect has taken its first step
+};
+
+/* LED Particles
+
+Particles are features that move along a line of LEDs (the perimeter, a
+row or a column), drawn by spreading a level profile out either side of
+where they are. Positions and velocities are fixed point with sixteen
+fractional bits (Q16) so slow particles keep their pace, they are shown
+on the nearest LED. See `led_particles.hpp` for moving and drawing them.
+*/
+constexpr unsigned long PARTICLE_FOREVER = 0xFFFFFFFFUL; // Lifetime or motion that doesn't run out
+
+struct LEDParticle {
+    int32_t position = 0;               // Place along the LEDs (Q16 LEDs)
+    int32_t velocity = 0;               // Speed towards higher indices, negative for lower (Q16 LEDs per ms)
+    unsigned long lifeMS = 0;           // Time left before it disappears, not in use once it reaches zero
+    unsigned long moveMS = PARTICLE_FOREVER; // Time left moving, it stops on the nearest LED once it runs out
+    const ledlevel_t* profile = nullptr; // Levels from the centre outwards
+    uint8_t width = 0;                  // Number of levels in the profile
+};
+
+/* LED Animations
+
+Animations are frames made ahead of time (see `tools/`) and compressed,
+kept in flash and played back a frame at a time. Frames are decoded
+straight into the frame being drawn, most of them only changing what
+differs from the one before, so a player only needs to keep its place
+in the data. See `led_animation.hpp` for the format and decoding.
+*/
+struct AnimationPlayer {
+    const uint8_t* data = nullptr;      // Animation being played, read in place
+    uint32_t size = 0;                  // Bytes of data
+    uint32_t offset = 0;                // Place in the data of the next frame to decode
+    uint16_t frames = 0;                // Frames in the animation
+    uint16_t frame = 0;                 // Next frame to decode
+    uint16_t durationMS = 0;            // How long the next frame is shown for
+    bool loop = false;                  // Goes back to the first frame after the last, otherwise holds it
 };
 
+/* LED Effect State
+
+Everything an effect keeps between steps lives in its state object
+rather than in function statics. Each running effect has its own state,
+which is reset whenever the effect is started. A reset state has a
+clock that hasn't started, so effects restart themselves on their first
+step.
+*/
+struct PacedState {
+    EffectClock clock;
+};
+
+struct CloudState {
+    EffectClock clock;
+    EffectRandom random;
+    RandomOrder<NUM_LED> targets;       // Picks the LEDs to adjust
+};
+
+struct SpinningState {
+    static const uint8_t NUM_BUMP = 2;  // Number of light "bumps" going around
+    EffectClock clock;
+    LEDParticle bump[NUM_BUMP];
+};
+
+struct SweepState {
+    uint8_t corner = 0;                 // Corner to emit effect from
+    ledInd_t progress = 0;              // Marks the amount of the sweep to draw
+    bool lightingUp = true;
+    bool holdingOff = false;
+    EffectClock clock;
+    unsigned long holdoffEnd = 0;
+};
+
+template <ledInd_t N> struct WaveState {
+    bool lastForwards = false;
+    ledInd_t location = 0;              // Location of leading row/column in effect
+    ledlevel_t levels[N] = {0};
+    bool growing[N] = {false};          // Marks if a row/column's brightness is climbing or not
+    EffectClock clock;
+};
+typedef WaveState<NUM_ROW> WaveVerState;
+typedef WaveState<NUM_COL> WaveHorState;
+
+struct TrackingSwap {
+    bool enabled = false;               // Is this swap active?
+    unsigned long endTime = 0;          // When to deactivate (based on `millis()` time)
+    ledInd_t location = 0;              // What is the start of this swap
+};
+
+struct TrackingState {
+    static const uint8_t NUM_SWAPS = 3; // Number of possible simultanious swaps
+    ledlevel_t colIntensity[NUM_COL] = {0};
+    TrackingSwap swaps[NUM_SWAPS];
+    EffectClock clock;
+    EffectRandom random;
+    RandomOrder<NUM_COL> targets;       // Picks the columns to adjust or swap
+};
+
+struct BumpsState {
+    static const uint8_t MAX_BUMP = 16; // Most bumps that can be used
+    LEDParticle bump[MAX_BUMP];
+    EffectClock clock;
+    EffectRandom random;
+};
+
+struct VolumeState {
+    EffectClock clock;
+    LEDParticle peak;                   // Upper mark, falls back towards the base
+};
+
+struct AnimationState {
+    EffectClock clock;
+    AnimationPlayer player;
+};
+
+struct SplitVolumeState {
+    EffectClock clock;
+    LEDParticle peak[2];                // Upper mark for each side, each falls back towards the middle
+};
+
+union EffectState {
+    PacedState paced;
+    CloudState cloud;
+    SpinningState spinning;
+    SweepState sweep;                   // Also used by sway
+    WaveVerState waveVer;
+    WaveHorState waveHor;
+    TrackingState tracking;
+    BumpsState bumps;
+    VolumeState volume;
+    SplitVolumeState splitVolume;
+    AnimationState animation;
+
+    EffectState() : paced() {}
+};
+
+/* LED Effect Registry
+
+Each state of the FSM is described by an entry in a table kept in 
+flash, indexed by `ledFSMstates`. The entry holds the effect's render 
+function and parameters, the audio processing it needs and the states 
+either side of it in the cycle. Adding an effect or reordering the 
+cycle only means changing the table.
+*/
+struct EffectInput {
+    unsigned long elapsedUS = 0;        // Time since the effect was last rendered
+    bool userControl = true;            // User togglable setting
+    bool toggleUser = false;            // User setting was toggled this cycle
+    bool toggleInvert = false;          // Inversion was toggled this cycle
+    double* lMag = nullptr;             // Left spectrum magnitudes
+    double* rMag = nullptr;             // Right spectrum magnitudes
+    double lRMS = 0;                    // RMS of left audio channel
+    double rRMS = 0;                    // RMS of right audio channel
+};
+
+struct EffectParameters {
+    unsigned long periodMS = 0;         // Period of the effect or time between its steps
+    unsigned long holdMS = 0;           // Hold or duration time, where used
+    uint8_t width = 0;                  // Width of any features, where used
+    uint8_t probability = 0;            // Likelihood of random events per step out of 255, where used
+    uint8_t count = 0;                  // Number of features (like bumps), where used
+};
+
+typedef void (*EffectRender)(EffectState* state, const EffectInput& input, const EffectParameters& params);
+typedef void (*EffectStart)(EffectState* state);
+
+struct EffectDescriptor {
+    ledFSMstates state;                 // State described, must match the entry's index
+    EffectRender render;
+    EffectStart start;                  // Resets the effect's state, null if it has none
+    EffectParameters params;
+    AudioProcessing audio;              // Audio processing needed while the effect runs
+    bool invertible;                    // If the effect can be shown inverted
+    ledFSMstates previous;
+    ledFSMstates next;
+};
+
+extern const EffectDescriptor* const LEDeffects;
+
 void initializeLED(IS31FL3236 drvrs[]);
 void remapLED(IS31FL3236 drvrs[]);
+void setDimmerLED(uint16_t level);
+void targetLED(LEDFrame* frame);
 void rotateLED(ledInd_t amount, bool clockwise = true);
+void resetRotationLED();
+void setTransitionLED(LEDTransition kind, unsigned long durationMS);
+int addLayerLED(ledFSMstates effect, LEDBlend mode, uint16_t opacity = 256);
+int removeLayerLED(int layer);
 
 AudioProcessing LEDfsm(uint8_t buttons, double lMag[], double rMag[], double lRMS, double rRMS,
      ledFSMstates overrideState = ledFSMstates::SOLID, bool override = false);
 
-bool checkReset(unsigned long mark, unsigned long stepPeriod, unsigned long curTime);
+void advanceClock(EffectClock* clock, unsigned long elapsedUS);
+bool stepDue(EffectClock* clock, unsigned long stepMS);
+bool paceDue(EffectClock* clock, unsigned long stepMS);
 ledInd_t constrainIndex(ledInd_t ind, ledInd_t limit = NUM_LED);
 void paintColumns(ledlevel_t intensities[]);
 void paintRows(ledlevel_t intensities[]);
-void copyGammaIntoBuffer(bool invert);
+void paintAxis(const ledlevel_t intensities[], uint8_t num, uint8_t LEDGeometry::*position);
 
-void breathingLED(unsigned long periodMS);
+void breathingLED(PacedState* state, unsigned long elapsedUS, unsigned long periodMS);
 void uniformLED(ledlevel_t intensity);
-void spinningLED(unsigned long periodMS, bool clockwise = true);
-void sweepLED(unsigned long periodMS, unsigned long holdMS, bool toggleCorner);
-void swayLED(unsigned long periodMS, unsigned long holdMS, bool toggleCorner);
-void waveVerLED(unsigned long periodMS, bool upwards = true);
-void waveHorLED(unsigned long periodMS, bool rightwards = true);
-void cloudLED(unsigned long stepMS);
-void trackingLED(unsigned long stepMS, unsigned long swapDurMS = 500, unsigned int widthSwap = 3, uint8_t probOfSwap = 3);
-void bumpsLED(unsigned long stepMS, uint8_t probOfStart = 3);
-void audioUniformLED(unsigned long stepMS, double leftRMS, double rightRMS);
-void audioBalanceLED(unsigned long stepMS, double leftRMS, double rightRMS);
+void uniformFineLED(uint16_t level);
+uint16_t fineLevelLED(ledInd_t ind);
+void setFineLED(ledInd_t ind, uint16_t level);
+void spinningLED(SpinningState* state, unsigned long elapsedUS, unsigned long periodMS, bool clockwise = true);
+void sweepLED(SweepState* state, unsigned long elapsedUS, unsigned long periodMS, unsigned long holdMS, 
+    bool toggleCorner);
+void plasmaLED(PacedState* state, unsigned long elapsedUS, unsigned long periodMS);
+void animationLED(AnimationState* state, unsigned long elapsedUS, const uint8_t data[], uint32_t size);
+void swayLED(SweepState* state, unsigned long elapsedUS, unsigned long periodMS, unsigned long holdMS, 
+    bool toggleCorner);
+void waveVerLED(WaveVerState* state, unsigned long elapsedUS, unsigned long periodMS, bool upwards = true);
+void waveHorLED(WaveHorState* state, unsigned long elapsedUS, unsigned long periodMS, bool rightwards = true);
+void cloudLED(CloudState* state, unsigned long elapsedUS, unsigned long stepMS);
+void trackingLED(TrackingState* state, unsigned long elapsedUS, unsigned long stepMS, unsigned long swapDurMS = 500, 
+    unsigned int widthSwap = 3, uint8_t probOfSwap = 3);
+void bumpsLED(BumpsState* state, unsigned long elapsedUS, unsigned long stepMS, uint8_t numBumps = 3, 
+    uint8_t probOfStart = 3);
+void audioUniformLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+    double rightRMS);
+void audioBalanceLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+    double rightRMS);
 
 void filterSpectrum(double lIn[], double rIn[], double lOut[], double rOut[]);
-void audioHoriSpectrumLED(unsigned long stepMS, double left[], double right[], bool leftToRight = true);
-void audioSplitSpectrumLED(unsigned long stepMS, double left[], double right[], bool bottomToTop = true);
-void audioSplitSpectrumSpinLED(unsigned long stepMS, double left[], double right[], bool clockwise = true);
-void audioVertVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool bottomToTop = true);
-void audioHoriVolLED(unsigned long stepMS, double leftRMS, double rightRMS, bool leftToRight = true);
-void audioHoriSplitVolLED(unsigned long stepMS, double leftRMS, double rightRMS);
+void audioHoriSpectrumLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double left[], 
+    double right[], bool leftToRight = true);
+void audioSplitSpectrumLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double left[], 
+    double right[], bool bottomToTop = true);
+void audioSplitSpectrumSpinLED(PacedState* state, unsigned long elapsedUS, unsigned long stepMS, double left[], 
+    double right[], bool clockwise = true);
+void placePeak(LEDParticle* peak, ledInd_t location, unsigned long fallMS, bool fallsUp);
+void audioVertVolLED(VolumeState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+    double rightRMS, bool bottomToTop = true);
+void audioHoriVolLED(VolumeState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+    double rightRMS, bool leftToRight = true);
+void audioHoriSplitVolLED(SplitVolumeState* state, unsigned long elapsedUS, unsigned long stepMS, double leftRMS, 
+    double rightRMS);
 
 float getOverallRMS(float left, float right, bool clamp = true);
 #endif
\ No newline at end of file
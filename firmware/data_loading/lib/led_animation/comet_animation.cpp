@@ -0,0 +1,74 @@
+#include <Arduino.h>
+
+#include "comet_animation.hpp"
+
+// Generated by led_animation_encoder.py from comet.txt, edit that and regenerate instead
+const uint8_t COMET_ANIMATION[] = {
+    0x4C, 0x41, 0x01, 0x48, 0x30, 0x00, 0x01, 0x00, 0x01, 0x1E, 0x00, 0x80, 0x3F, 0x68, 0x06, 0x80,
+    0x0F, 0x4F, 0x06, 0x80, 0x1E, 0x44, 0x06, 0x86, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x00,
+    0x1E, 0x00, 0x83, 0x21, 0x2A, 0x34, 0x3F, 0x25, 0x80, 0x0C, 0x0F, 0x80, 0x1B, 0x04, 0x42, 0x06,
+    0x83, 0x09, 0x0D, 0x12, 0x19, 0x00, 0x1E, 0x00, 0x86, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F,
+    0x22, 0x80, 0x09, 0x0F, 0x80, 0x18, 0x07, 0x42, 0x06, 0x80, 0x09, 0x00, 0x1E, 0x00, 0x89, 0x06,
+    0x06, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x1F, 0x50, 0x06, 0x80, 0x15, 0x07, 0x80,
+    0x1E, 0x01, 0x80, 0x06, 0x00, 0x1E, 0x00, 0x01, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21,
+    0x2A, 0x34, 0x3F, 0x2D, 0x80, 0x12, 0x07, 0x80, 0x1B, 0x02, 0x00, 0x1E, 0x00, 0x04, 0x42, 0x06,
+    0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x2A, 0x80, 0x0F, 0x07, 0x80, 0x18, 0x02,
+    0x00, 0x1E, 0x00, 0x07, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x27,
+    0x80, 0x0C, 0x07, 0x80, 0x15, 0x02, 0x00, 0x1E, 0x00, 0x0A, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12,
+    0x19, 0x21, 0x2A, 0x34, 0x3F, 0x24, 0x80, 0x09, 0x07, 0x80, 0x12, 0x02, 0x00, 0x1E, 0x00, 0x09,
+    0x80, 0x1E, 0x02, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x21, 0x48,
+    0x06, 0x80, 0x0F, 0x02, 0x00, 0x1E, 0x00, 0x09, 0x80, 0x1B, 0x05, 0x42, 0x06, 0x87, 0x09, 0x0D,
+    0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x27, 0x80, 0x0C, 0x02, 0x00, 0x1E, 0x00, 0x09, 0x80, 0x18,
+    0x08, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x24, 0x80, 0x09, 0x02,
+    0x00, 0x1E, 0x00, 0x09, 0x80, 0x15, 0x0B, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A,
+    0x34, 0x3F, 0x21, 0x43, 0x06, 0x00, 0x1E, 0x00, 0x09, 0x80, 0x12, 0x0E, 0x42, 0x06, 0x87, 0x09,
+    0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x22, 0x00, 0x1E, 0x00, 0x09, 0x80, 0x0F, 0x0C, 0x80,
+    0x1E, 0x03, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x1F, 0x00, 0x1E,
+    0x00, 0x09, 0x80, 0x0C, 0x0C, 0x80, 0x1B, 0x06, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21,
+    0x2A, 0x34, 0x3F, 0x1C, 0x00, 0x1E, 0x00, 0x09, 0x80, 0x09, 0x0C, 0x80, 0x18, 0x09, 0x42, 0x06,
+    0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x19, 0x00, 0x1E, 0x00, 0x09, 0x4D, 0x06,
+    0x80, 0x15, 0x0C, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x16, 0x00,
+    0x1E, 0x00, 0x17, 0x80, 0x12, 0x0F, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34,
+    0x3F, 0x13, 0x00, 0x1E, 0x00, 0x17, 0x80, 0x0F, 0x0F, 0x80, 0x1E, 0x01, 0x42, 0x06, 0x87, 0x09,
+    0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x10, 0x00, 0x1E, 0x00, 0x17, 0x80, 0x0C, 0x0F, 0x80,
+    0x1B, 0x04, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x0D, 0x00, 0x1E,
+    0x00, 0x17, 0x80, 0x09, 0x0F, 0x80, 0x18, 0x07, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21,
+    0x2A, 0x34, 0x3F, 0x0A, 0x00, 0x1E, 0x00, 0x17, 0x50, 0x06, 0x80, 0x15, 0x0A, 0x42, 0x06, 0x87,
+    0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x07, 0x00, 0x1E, 0x00, 0x28, 0x80, 0x12, 0x0D,
+    0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x04, 0x00, 0x1E, 0x00, 0x28,
+    0x80, 0x0F, 0x0C, 0x80, 0x1E, 0x02, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34,
+    0x3F, 0x01, 0x00, 0x1E, 0x00, 0x80, 0x3F, 0x27, 0x80, 0x0C, 0x0C, 0x80, 0x1B, 0x05, 0x42, 0x06,
+    0x86, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x00, 0x1E, 0x00, 0x83, 0x21, 0x2A, 0x34, 0x3F,
+    0x24, 0x80, 0x09, 0x0C, 0x80, 0x18, 0x08, 0x42, 0x06, 0x83, 0x09, 0x0D, 0x12, 0x19, 0x00, 0x1E,
+    0x00, 0x86, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x21, 0x4D, 0x06, 0x80, 0x15, 0x0B, 0x42,
+    0x06, 0x80, 0x09, 0x00, 0x1E, 0x00, 0x89, 0x06, 0x06, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34,
+    0x3F, 0x2C, 0x80, 0x12, 0x0E, 0x80, 0x06, 0x00, 0x1E, 0x00, 0x01, 0x42, 0x06, 0x87, 0x09, 0x0D,
+    0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x29, 0x80, 0x0F, 0x0C, 0x80, 0x1E, 0x01, 0x00, 0x1E, 0x00,
+    0x04, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x26, 0x80, 0x0C, 0x0C,
+    0x80, 0x1B, 0x01, 0x00, 0x1E, 0x00, 0x07, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A,
+    0x34, 0x3F, 0x23, 0x80, 0x09, 0x0C, 0x80, 0x18, 0x01, 0x00, 0x1E, 0x00, 0x0A, 0x42, 0x06, 0x87,
+    0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x20, 0x4D, 0x06, 0x80, 0x15, 0x01, 0x00, 0x1E,
+    0x00, 0x0D, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x2B, 0x80, 0x12,
+    0x01, 0x00, 0x1E, 0x00, 0x0D, 0x80, 0x1E, 0x01, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21,
+    0x2A, 0x34, 0x3F, 0x28, 0x80, 0x0F, 0x01, 0x00, 0x1E, 0x00, 0x0D, 0x80, 0x1B, 0x04, 0x42, 0x06,
+    0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x25, 0x80, 0x0C, 0x01, 0x00, 0x1E, 0x00,
+    0x0D, 0x80, 0x18, 0x07, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x22,
+    0x80, 0x09, 0x01, 0x00, 0x1E, 0x00, 0x0D, 0x80, 0x15, 0x0A, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12,
+    0x19, 0x21, 0x2A, 0x34, 0x3F, 0x1F, 0x42, 0x06, 0x00, 0x1E, 0x00, 0x0D, 0x80, 0x12, 0x0D, 0x42,
+    0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x1F, 0x00, 0x1E, 0x00, 0x0D, 0x80,
+    0x0F, 0x0C, 0x80, 0x1E, 0x02, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F,
+    0x1C, 0x00, 0x1E, 0x00, 0x0D, 0x80, 0x0C, 0x0C, 0x80, 0x1B, 0x05, 0x42, 0x06, 0x87, 0x09, 0x0D,
+    0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x19, 0x00, 0x1E, 0x00, 0x0D, 0x80, 0x09, 0x0C, 0x80, 0x18,
+    0x08, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x16, 0x00, 0x1E, 0x00,
+    0x0D, 0x4D, 0x06, 0x80, 0x15, 0x0B, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34,
+    0x3F, 0x13, 0x00, 0x1E, 0x00, 0x1B, 0x80, 0x12, 0x0E, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19,
+    0x21, 0x2A, 0x34, 0x3F, 0x10, 0x00, 0x1E, 0x00, 0x1B, 0x80, 0x0F, 0x0C, 0x80, 0x1E, 0x03, 0x42,
+    0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x0D, 0x00, 0x1E, 0x00, 0x1B, 0x80,
+    0x0C, 0x0C, 0x80, 0x1B, 0x06, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F,
+    0x0A, 0x00, 0x1E, 0x00, 0x1B, 0x80, 0x09, 0x0C, 0x80, 0x18, 0x09, 0x42, 0x06, 0x87, 0x09, 0x0D,
+    0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x07, 0x00, 0x1E, 0x00, 0x1B, 0x4D, 0x06, 0x80, 0x15, 0x0C,
+    0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x04, 0x00, 0x1E, 0x00, 0x29,
+    0x80, 0x12, 0x0F, 0x42, 0x06, 0x87, 0x09, 0x0D, 0x12, 0x19, 0x21, 0x2A, 0x34, 0x3F, 0x01,
+};
+
+const uint32_t COMET_ANIMATION_SIZE = sizeof(COMET_ANIMATION);
@@ -0,0 +1,10 @@
+#ifndef COMET_ANIMATION_HEADER
+#define COMET_ANIMATION_HEADER
+
+#include <Arduino.h>
+
+// Generated by led_animation_encoder.py from comet.txt, edit that and regenerate instead
+extern const uint8_t COMET_ANIMATION[];
+extern const uint32_t COMET_ANIMATION_SIZE;
+
+#endif
@@ -0,0 +1,173 @@
+#include <Arduino.h>
+
+#include "led.hpp"
+#include "led_animation.hpp"
+#include "render_profiler.hpp"
+
+#ifdef DEBUG
+#include "comet_animation.hpp" // Played by the benchmark
+#endif
+
+const int LED_ANIMATION_FAIL = -1;
+const int LED_ANIMATION_SUCCESS = 0;
+
+const uint8_t ANIMATION_VERSION = 1;
+const uint32_t ANIMATION_HEADER_SIZE = 8;
+const uint32_t ANIMATION_FRAME_HEADER_SIZE = 3;
+
+const uint8_t ANIMATION_LOOP = 0x01;        // Header flag, go back to the first frame after the last
+const uint8_t ANIMATION_KEYFRAME = 0x01;    // Frame flag, doesn't depend on the frame before
+
+const uint8_t ANIMATION_CODE_KIND = 0xC0;   // Bits of a code giving what it does
+const uint8_t ANIMATION_CODE_COUNT = 0x3F;  // Bits of a code giving the LEDs it covers, less one
+const uint8_t ANIMATION_SKIP = 0x00;
+const uint8_t ANIMATION_RUN = 0x40;
+const uint8_t ANIMATION_LITERAL = 0x80;
+
+/**
+ * \brief Reads how long the next frame is shown for, ready for the clock
+ * 
+ * \return If there is a whole frame header there
+ */
+bool peekDuration(AnimationPlayer* player) {
+    if ((player->offset + ANIMATION_FRAME_HEADER_SIZE) > player->size) return false;
+
+    const uint8_t* header = &player->data[player->offset];
+    player->durationMS = header[1] | (header[2] << 8);
+    return true;
+}
+
+/**
+ * \brief Stops a player on data that can't be played, it decodes no more frames
+ */
+int stopAnimation(AnimationPlayer* player) {
+    player->frames = 0;
+    player->frame = 0;
+    player->durationMS = 0;
+    return LED_ANIMATION_FAIL;
+}
+
+/**
+ * \brief Readies a player to play an animation from its first frame
+ * 
+ * \param player Player to start
+ * \param data Animation data, read in place so it must stay put while it is played
+ * \param size Bytes of data
+ * \return If the data is an animation that can be played
+ */
+int startAnimation(AnimationPlayer* player, const uint8_t data[], uint32_t size) {
+    player->data = data;
+    player->size = size;
+    player->offset = ANIMATION_HEADER_SIZE;
+
+    if ((data == nullptr) || (size < (ANIMATION_HEADER_SIZE + ANIMATION_FRAME_HEADER_SIZE)))
+        return stopAnimation(player);
+    if ((data[0] != 'L') || (data[1] != 'A') || (data[2] != ANIMATION_VERSION) || (data[3] != NUM_LED))
+        return stopAnimation(player);
+
+    player->frames = data[4] | (data[5] << 8);
+    player->frame = 0;
+    player->loop = (data[6] & ANIMATION_LOOP) != 0;
+    if ((player->frames == 0) || !peekDuration(player)) return stopAnimation(player);
+    if ((data[player->offset] & ANIMATION_KEYFRAME) == 0) return stopAnimation(player); // Nothing to build on
+
+    return LED_ANIMATION_SUCCESS;
+}
+
+/**
+ * \brief Decodes the next frame of an animation into the targeted frame
+ * 
+ * \param player Player of the animation
+ * 
+ * \note LEDs a frame leaves as they were keep whatever the targeted frame holds, so the same frame
+ *      must be targeted from the first frame on
+ * 
+ * \return If a frame was decoded, fails once an animation that doesn't loop has ended or on bad data
+ */
+int decodeFrameAnimation(AnimationPlayer* player) {
+    if (player->frame >= player->frames) return LED_ANIMATION_FAIL;
+    if (!peekDuration(player)) return stopAnimation(player);
+
+    const uint8_t* data = player->data;
+    uint32_t offset = player->offset;
+    bool keyframe = (data[offset] & ANIMATION_KEYFRAME) != 0;
+    offset = offset + ANIMATION_FRAME_HEADER_SIZE;
+
+    ledInd_t led = 0;
+    while (led < NUM_LED) {
+        if (offset >= player->size) return stopAnimation(player);
+        uint8_t code = data[offset];
+        offset++;
+
+        uint8_t kind = code & ANIMATION_CODE_KIND;
+        ledInd_t count = (code & ANIMATION_CODE_COUNT) + 1;
+        if (count > (NUM_LED - led)) return stopAnimation(player);
+
+        switch (kind) {
+        case ANIMATION_SKIP:
+            if (keyframe) return stopAnimation(player);
+            led = led + count;
+            break;
+        case ANIMATION_RUN:
+            if (offset >= player->size) return stopAnimation(player);
+            for (ledInd_t i = 0; i < count; i++) setFineLED(led + i, data[offset] << 8);
+            offset++;
+            led = led + count;
+            break;
+        case ANIMATION_LITERAL:
+            if ((offset + count) > player->size) return stopAnimation(player);
+            for (ledInd_t i = 0; i < count; i++) setFineLED(led + i, data[offset + i] << 8);
+            offset = offset + count;
+            led = led + count;
+            break;
+        default:
+            return stopAnimation(player);
+        }
+    }
+
+    player->offset = offset;
+    player->frame++;
+    if (player->frame >= player->frames) {
+        if (!player->loop) {
+            player->durationMS = 0;
+            return LED_ANIMATION_SUCCESS; // Holds the last frame
+        }
+        player->frame = 0;
+        player->offset = ANIMATION_HEADER_SIZE;
+    }
+    if (!peekDuration(player)) return stopAnimation(player);
+
+    return LED_ANIMATION_SUCCESS;
+}
+
+#ifdef DEBUG
+/**
+ * \brief Measures and prints the time taken to decode the frames of an animation
+ */
+void benchmarkAnimationLED() {
+    const unsigned int RUNS = 20; // Times through the whole animation
+
+    // Decoded into a frame of its own so nothing shown is disturbed
+    static LEDFrame frame;
+    LEDFrame* previous = LEDtarget;
+    targetLED(&frame);
+
+    AnimationPlayer player;
+    startAnimation(&player, COMET_ANIMATION, COMET_ANIMATION_SIZE);
+    unsigned int frames = RUNS * player.frames;
+    unsigned int decoded = 0;
+    float frameUS = timeRunsUS(frames, [&](unsigned int) {
+        if (decodeFrameAnimation(&player) == LED_ANIMATION_SUCCESS) decoded++;
+    });
+
+    SerialUSB.println("LED ANIMATION TIME (bytes, frames, us per frame)");
+    SerialUSB.print(COMET_ANIMATION_SIZE);
+    SerialUSB.print("\t");
+    SerialUSB.print(player.frames);
+    SerialUSB.print("\t");
+    if ((frames > 0) && (decoded == frames)) SerialUSB.println(frameUS);
+    else SerialUSB.println("FAILED");
+
+    targetLED(previous);
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef LED_ANIMATION_HEADER
+#define LED_ANIMATION_HEADER
+
+#include <Arduino.h>
+
+#include "led.hpp"
+
+/* LED animation playback
+
+    Plays compressed animations made by `tools/led_animation_encoder.py`,
+    read in place from wherever they are kept (arrays in flash, read
+    through the XIP cache, or a buffer). Frames are decoded one at a
+    time straight into the targeted frame, the player only keeping its
+    place in the data, so decoding costs a pass over one frame's codes
+    whatever the animation.
+
+    Data starts with an 8 byte header:
+        0-1     "LA"
+        2       Format version (1)
+        3       Number of LEDs, must match `NUM_LED`
+        4-5     Number of frames (little endian)
+        6       Flags, bit 0 set to loop
+        7       Reserved (0)
+
+    Then each frame, in order:
+        0       Flags, bit 0 set for a keyframe (doesn't depend on the frame before)
+        1-2     Time it is shown for (ms, little endian)
+        3...    Codes covering every LED in order, the top two bits of each giving its kind
+                and the rest one less than the number of LEDs it covers (1 to 64):
+                    00  LEDs left as they were in the frame before (not in keyframes)
+                    01  LEDs all set to the level in the following byte
+                    10  LEDs each set to their own level in the following bytes
+                    11  Reserved
+
+    Levels are gamma levels, decoded frames have no fractions.
+*/
+
+extern const int LED_ANIMATION_FAIL;
+extern const int LED_ANIMATION_SUCCESS;
+
+int startAnimation(AnimationPlayer* player, const uint8_t data[], uint32_t size);
+int decodeFrameAnimation(AnimationPlayer* player);
+
+#ifdef DEBUG
+void benchmarkAnimationLED();
+#endif
+
+#endif
@@ -0,0 +1,378 @@
+#include <Arduino.h>
+
+#include "led.hpp"
+#include "led_canvas.hpp"
+#include "render_profiler.hpp"
+
+const int LED_CANVAS_FAIL = -1;
+const int LED_CANVAS_SUCCESS = 0;
+
+const int32_t CANVAS_MAX_LEVEL = (NUM_GAMMA - 1) << 8; // Brightest level a shape can reach (Q8 gamma levels)
+
+/*  Canvas tables
+
+    The sine wave for plasma is worked out at compile time like the
+    other LED tables and stays in flash. Where each LED sits on the
+    canvas comes from the LED geometry, found once when starting up.
+*/
+constexpr float canvasSineTurns(float turns) {
+    // Taylor series about zero, good to well under a step of the table over half a turn either way
+    float x = ((turns > 0.5f) ? (turns - 1.0f) : turns) * 6.2831853f;
+    float term = x;
+    float sum = x;
+    for (uint_fast8_t n = 1; n < 10; n++) {
+        term = -term * x * x / ((2.0f * n) * ((2.0f * n) + 1.0f));
+        sum = sum + term;
+    }
+    return sum;
+}
+
+struct CanvasSineTable {
+    int8_t value[256];                  // Sine over a turn of 256 steps, from -127 to 127
+
+    constexpr CanvasSineTable() : value() {
+        for (unsigned int i = 0; i < 256; i++) {
+            float v = canvasSineTurns(i / 256.0f) * 127.0f;
+            value[i] = (int8_t)((v < 0) ? (v - 0.5f) : (v + 0.5f));
+        }
+    }
+};
+
+constexpr CanvasSineTable CANVAS_SINE; // Stays in flash
+
+struct CanvasSampler {
+    CanvasPoint led[NUM_LED];
+
+    CanvasSampler() {
+        for (ledInd_t i = 0; i < NUM_LED; i++) {
+            led[i].x = ((int32_t)LEDgeometry[i].col * ((CANVAS_WIDTH - 1) << 8)) / (NUM_COL - 1);
+            led[i].y = ((int32_t)LEDgeometry[i].row * ((CANVAS_HEIGHT - 1) << 8)) / (NUM_ROW - 1);
+        }
+    }
+};
+
+const CanvasSampler CANVAS_SAMPLER; // The geometry table is in flash, so it is ready before this is made
+const CanvasPoint* const LEDcanvasPoint = CANVAS_SAMPLER.led;
+
+/**
+ * \brief Integer square root, rounded down
+ */
+inline uint16_t canvasSqrt(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > value) bit >>= 2;
+
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value = value - (root + bit);
+            root = (root >> 1) + bit;
+        }
+        else root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**
+ * \brief Finds the distance between two points on the canvas
+ * 
+ * \note Points are expected to be on or near the canvas, far enough off it and the square overflows
+ * \return Distance (Q8 cells)
+ */
+inline uint16_t canvasDistance(CanvasPoint a, CanvasPoint b) {
+    int32_t dx = a.x - b.x;
+    int32_t dy = a.y - b.y;
+    return canvasSqrt((uint32_t)((dx * dx) + (dy * dy)));
+}
+
+/**
+ * \brief Finds how far a point is along the line from one point to another, as if projected onto it
+ * 
+ * \return Fraction of the way along, clamped to the ends (Q16, 0 to 65536)
+ */
+inline int32_t canvasAlong(CanvasPoint from, CanvasPoint to, CanvasPoint point) {
+    int32_t dx = to.x - from.x;
+    int32_t dy = to.y - from.y;
+    int32_t lengthSq = (dx * dx) + (dy * dy);
+    if (lengthSq == 0) return 0;
+
+    int32_t along = ((point.x - from.x) * dx) + ((point.y - from.y) * dy);
+    if (along <= 0) return 0;
+    if (along >= lengthSq) return 1L << 16;
+    return ((int64_t)along << 16) / lengthSq;
+}
+
+/**
+ * \brief Interpolates between a shape's two levels
+ * 
+ * \param weight Fraction of the way from the first to the second (Q8, 0 to 256)
+ */
+inline int32_t canvasLevel(const CanvasShape* shape, int32_t weight) {
+    return shape->level[0] + ((((int32_t)shape->level[1] - shape->level[0]) * weight) >> 8);
+}
+
+uint16_t shadeGradient(const CanvasShape* shape, CanvasPoint point) {
+    return canvasLevel(shape, canvasAlong(shape->from, shape->to, point) >> 8);
+}
+
+uint16_t shadeLine(const CanvasShape* shape, CanvasPoint point) {
+    // Nearest point on the line, found finely enough that LEDs on a long line are right on it
+    int32_t along = canvasAlong(shape->from, shape->to, point);
+    CanvasPoint nearest;
+    nearest.x = shape->from.x + (((int64_t)(shape->to.x - shape->from.x) * along) >> 16);
+    nearest.y = shape->from.y + (((int64_t)(shape->to.y - shape->from.y) * along) >> 16);
+
+    // Fades out linearly either side, so lines between LEDs still show on the ones either side of them
+    int32_t distance = canvasDistance(point, nearest);
+    if ((shape->size <= 0) || (distance >= shape->size)) return shape->level[1];
+    return canvasLevel(shape, (distance << 8) / shape->size);
+}
+
+uint16_t shadeRadial(const CanvasShape* shape, CanvasPoint point) {
+    int32_t distance = canvasDistance(point, shape->from);
+    if ((shape->size <= 0) || (distance >= shape->size)) return shape->level[1];
+    return canvasLevel(shape, (distance << 8) / shape->size);
+}
+
+uint16_t shadePlasma(const CanvasShape* shape, CanvasPoint point) {
+    if (shape->size <= 0) return shape->level[0];
+
+    // Sum of waves across, up, diagonally and out from the middle, each moving at its own pace
+    CanvasPoint middle = canvasPoint(CANVAS_WIDTH - 1, CANVAS_HEIGHT - 1);
+    middle.x = middle.x / 2;
+    middle.y = middle.y / 2;
+
+    uint8_t across = (((int32_t)point.x << 8) / shape->size) + shape->phase;
+    uint8_t up = (((int32_t)point.y << 8) / shape->size) - (2 * shape->phase);
+    uint8_t diagonal = (((int32_t)(point.x + point.y) << 7) / shape->size) + (3 * shape->phase);
+    uint8_t out = (((int32_t)canvasDistance(point, middle) << 8) / shape->size) - shape->phase;
+
+    int32_t sum = CANVAS_SINE.value[across] + CANVAS_SINE.value[up] + CANVAS_SINE.value[diagonal] +
+        CANVAS_SINE.value[out];
+    return canvasLevel(shape, ((sum + (4 * 127)) << 8) / (8 * 127));
+}
+
+/**
+ * \brief Removes all the shapes from a canvas
+ * 
+ * \param canvas Canvas to clear
+ * \param background Level shown where there are no shapes (Q8 gamma levels)
+ */
+void clearCanvas(LEDCanvas* canvas, uint16_t background) {
+    canvas->count = 0;
+    canvas->background = background;
+}
+
+/**
+ * \brief Takes the next free shape of a canvas
+ * 
+ * \return The shape, reset to its defaults, or null if the canvas is full
+ */
+CanvasShape* nextShape(LEDCanvas* canvas, CanvasShader shader, LEDBlend mode) {
+    if (canvas->count >= MAX_CANVAS_SHAPES) return nullptr;
+
+    CanvasShape* shape = &canvas->shape[canvas->count];
+    canvas->count++;
+
+    *shape = CanvasShape();
+    shape->shader = shader;
+    shape->mode = mode;
+    return shape;
+}
+
+/**
+ * \brief Draws a custom shader over the whole canvas
+ * 
+ * \param canvas Canvas to draw on
+ * \param shader Finds the level at each LED, given the shape holding `context`
+ * \param context Anything the shader needs, must last until the canvas is rendered
+ * \param mode How it combines with the shapes below it
+ * \return If the shape was drawn, fails if the canvas is full
+ */
+int drawShaderCanvas(LEDCanvas* canvas, CanvasShader shader, const void* context, LEDBlend mode) {
+    if (shader == nullptr) return LED_CANVAS_FAIL;
+
+    CanvasShape* shape = nextShape(canvas, shader, mode);
+    if (shape == nullptr) return LED_CANVAS_FAIL;
+
+    shape->context = context;
+    return LED_CANVAS_SUCCESS;
+}
+
+/**
+ * \brief Draws a gradient along a line, levels are held past its ends
+ * 
+ * \param canvas Canvas to draw on
+ * \param from Start of the gradient
+ * \param to End of the gradient
+ * \param fromLevel Level at the start (Q8 gamma levels)
+ * \param toLevel Level at the end (Q8 gamma levels)
+ * \param mode How it combines with the shapes below it
+ * \return If the shape was drawn, fails if the canvas is full
+ */
+int drawGradientCanvas(LEDCanvas* canvas, CanvasPoint from, CanvasPoint to, uint16_t fromLevel, uint16_t toLevel,
+        LEDBlend mode) {
+    CanvasShape* shape = nextShape(canvas, shadeGradient, mode);
+    if (shape == nullptr) return LED_CANVAS_FAIL;
+
+    shape->from = from;
+    shape->to = to;
+    shape->level[0] = fromLevel;
+    shape->level[1] = toLevel;
+    return LED_CANVAS_SUCCESS;
+}
+
+/**
+ * \brief Draws a line between two points, fading out either side of it
+ * 
+ * \param canvas Canvas to draw on
+ * \param from Start of the line
+ * \param to End of the line
+ * \param width Distance either side of the line that it fades out over (Q8 cells)
+ * \param level Level on the line (Q8 gamma levels)
+ * \param mode How it combines with the shapes below it
+ * \return If the shape was drawn, fails if the canvas is full
+ */
+int drawLineCanvas(LEDCanvas* canvas, CanvasPoint from, CanvasPoint to, int16_t width, uint16_t level,
+        LEDBlend mode) {
+    CanvasShape* shape = nextShape(canvas, shadeLine, mode);
+    if (shape == nullptr) return LED_CANVAS_FAIL;
+
+    shape->from = from;
+    shape->to = to;
+    shape->size = width;
+    shape->level[0] = level;
+    shape->level[1] = 0;
+    return LED_CANVAS_SUCCESS;
+}
+
+/**
+ * \brief Draws a field changing with the distance from a point
+ * 
+ * \param canvas Canvas to draw on
+ * \param centre Middle of the field
+ * \param radius Distance from the middle to its edge (Q8 cells)
+ * \param innerLevel Level at the middle (Q8 gamma levels)
+ * \param outerLevel Level at the edge and beyond (Q8 gamma levels)
+ * \param mode How it combines with the shapes below it
+ * \return If the shape was drawn, fails if the canvas is full
+ */
+int drawRadialCanvas(LEDCanvas* canvas, CanvasPoint centre, int16_t radius, uint16_t innerLevel, uint16_t outerLevel,
+        LEDBlend mode) {
+    CanvasShape* shape = nextShape(canvas, shadeRadial, mode);
+    if (shape == nullptr) return LED_CANVAS_FAIL;
+
+    shape->from = centre;
+    shape->size = radius;
+    shape->level[0] = innerLevel;
+    shape->level[1] = outerLevel;
+    return LED_CANVAS_SUCCESS;
+}
+
+/**
+ * \brief Draws plasma, overlapping waves that swirl as the phase moves on
+ * 
+ * \param canvas Canvas to draw on
+ * \param wavelength Length of the waves (Q8 cells)
+ * \param phase Where it is in its cycle (256 per cycle)
+ * \param lowLevel Level at the troughs (Q8 gamma levels)
+ * \param highLevel Level at the crests (Q8 gamma levels)
+ * \param mode How it combines with the shapes below it
+ * \return If the shape was drawn, fails if the canvas is full
+ */
+int drawPlasmaCanvas(LEDCanvas* canvas, int16_t wavelength, uint8_t phase, uint16_t lowLevel, uint16_t highLevel,
+        LEDBlend mode) {
+    CanvasShape* shape = nextShape(canvas, shadePlasma, mode);
+    if (shape == nullptr) return LED_CANVAS_FAIL;
+
+    shape->size = wavelength;
+    shape->phase = phase;
+    shape->level[0] = lowLevel;
+    shape->level[1] = highLevel;
+    return LED_CANVAS_SUCCESS;
+}
+
+/**
+ * \brief Combines a shape's level with the level below it
+ */
+inline int32_t combineCanvasLevel(int32_t below, int32_t level, LEDBlend mode) {
+    switch (mode) {
+    case LEDBlend::BLEND_ADD:
+        return below + level;
+    case LEDBlend::BLEND_MAX:
+        return (level > below) ? level : below;
+    case LEDBlend::BLEND_MULTIPLY:
+        if (level > CANVAS_MAX_LEVEL) level = CANVAS_MAX_LEVEL;
+        return (below * level) / CANVAS_MAX_LEVEL;
+    default: // Alpha
+        return level;
+    }
+}
+
+/**
+ * \brief Draws the canvas onto the targeted LEDs, working out each one from the shapes where it sits
+ * 
+ * \param canvas Canvas to show
+ */
+void renderCanvasLED(const LEDCanvas* canvas) {
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        int32_t level = canvas->background;
+        for (uint_fast8_t s = 0; s < canvas->count; s++) {
+            const CanvasShape* shape = &canvas->shape[s];
+            level = combineCanvasLevel(level, shape->shader(shape, LEDcanvasPoint[i]), shape->mode);
+        }
+
+        if (level > CANVAS_MAX_LEVEL) level = CANVAS_MAX_LEVEL;
+        setFineLED(i, level);
+    }
+}
+
+#ifdef DEBUG
+/**
+ * \brief Measures and prints the time taken to render canvases with different numbers of shapes
+ */
+void benchmarkCanvasLED() {
+    const unsigned int RUNS = 50; // Fewer than the other benchmarks, a canvas of many shapes is slow to draw
+    const uint8_t COUNTS[] = {1, 4, 8};
+
+    // Drawn into a frame of its own so nothing shown is disturbed
+    static LEDFrame frame;
+    LEDFrame* previous = LEDtarget;
+    targetLED(&frame);
+
+    SerialUSB.println("LED CANVAS TIME (shapes, us per frame)");
+    for (uint_fast8_t c = 0; c < (sizeof(COUNTS) / sizeof(COUNTS[0])); c++) {
+        float frameUS = timeRunsUS(RUNS, [&](unsigned int r) {
+            // Drawing is included since effects redraw their canvas every frame
+            LEDCanvas canvas;
+            clearCanvas(&canvas, 10 << 8);
+            for (uint_fast8_t s = 0; s < COUNTS[c]; s++) {
+                switch (s % 4) {
+                case 0:
+                    drawPlasmaCanvas(&canvas, 8 << 8, r, 0, 40 << 8);
+                    break;
+                case 1:
+                    drawLineCanvas(&canvas, canvasPoint(0, 0), canvasPoint(CANVAS_WIDTH - 1, CANVAS_HEIGHT - 1),
+                        384, 63 << 8);
+                    break;
+                case 2:
+                    drawRadialCanvas(&canvas, canvasPoint(CANVAS_WIDTH / 2, CANVAS_HEIGHT / 2), 12 << 8, 63 << 8,
+                        32 << 8, LEDBlend::BLEND_MULTIPLY);
+                    break;
+                default:
+                    drawGradientCanvas(&canvas, canvasPoint(0, 0), canvasPoint(CANVAS_WIDTH - 1, 0), 0, 20 << 8,
+                        LEDBlend::BLEND_ADD);
+                    break;
+                }
+            }
+            renderCanvasLED(&canvas);
+        });
+
+        SerialUSB.print(COUNTS[c]);
+        SerialUSB.print("\t");
+        SerialUSB.println(frameUS);
+    }
+
+    targetLED(previous);
+}
+#endif
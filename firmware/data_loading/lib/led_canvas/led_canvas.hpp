@@ -0,0 +1,96 @@
+#ifndef LED_CANVAS_HEADER
+#define LED_CANVAS_HEADER
+
+#include <Arduino.h>
+
+#include "led.hpp"
+
+/* LED canvas
+
+    A flat 2D surface laid over the board that effects can draw shapes
+    on (lines, gradients, radial fields, plasma) without caring how the
+    LEDs are wired around the edge. The canvas is `CANVAS_WIDTH` by
+    `CANVAS_HEIGHT` cells with the bottom left LED at the origin and the
+    top right one on the far corner, points on it are fixed point with
+    eight fractional bits (Q8 cells) so shapes sit between the cells.
+
+    Nothing is ever rasterized. Drawing only records the shape and its
+    parameters, then `renderCanvasLED` works out each LED's level from
+    the shapes at where that LED sits on the canvas (found once, when
+    starting up). The cost is the number of LEDs times the number of
+    shapes, however large the canvas or the shapes are.
+
+    Shapes are evaluated in the order drawn, each combined with the
+    levels so far like layers are (`LEDBlend`), on top of a uniform
+    background. Custom shaders can be drawn like any other shape.
+*/
+
+constexpr uint8_t CANVAS_WIDTH = NUM_COL;   // Cells across the canvas, the LED columns
+constexpr uint8_t CANVAS_HEIGHT = NUM_ROW;  // Cells up the canvas, the LED rows
+constexpr uint8_t MAX_CANVAS_SHAPES = 8;    // Shapes a canvas can hold
+
+extern const int LED_CANVAS_FAIL;
+extern const int LED_CANVAS_SUCCESS;
+
+struct CanvasPoint {
+    int16_t x = 0;                      // Distance from the left (Q8 cells)
+    int16_t y = 0;                      // Distance from the bottom (Q8 cells)
+};
+
+extern const CanvasPoint* const LEDcanvasPoint; // Where each LED sits on the canvas
+
+struct CanvasShape;
+
+/**
+ * \brief Finds the level of a shape at a point on the canvas
+ * 
+ * \param shape Shape being drawn, with its parameters
+ * \param point Point on the canvas
+ * \return Level of the shape there (Q8 gamma levels)
+ */
+typedef uint16_t (*CanvasShader)(const CanvasShape* shape, CanvasPoint point);
+
+struct CanvasShape {
+    CanvasShader shader = nullptr;
+    LEDBlend mode = LEDBlend::BLEND_MAX; // How it combines with the shapes below it
+    CanvasPoint from;                   // Start of a line or gradient, centre of a radial field
+    CanvasPoint to;                     // End of a line or gradient
+    int16_t size = 0;                   // Width of a line, radius of a field or wavelength of plasma (Q8 cells)
+    uint16_t level[2] = {0};            // Levels the shape spans from and to (Q8 gamma levels)
+    uint8_t phase = 0;                  // Phase of animated shapes (256 per cycle)
+    const void* context = nullptr;      // Anything else a custom shader needs
+};
+
+struct LEDCanvas {
+    CanvasShape shape[MAX_CANVAS_SHAPES];
+    uint8_t count = 0;                  // Shapes drawn
+    uint16_t background = 0;            // Level below all the shapes (Q8 gamma levels)
+};
+
+/**
+ * \brief Makes a point on the canvas from whole cells
+ */
+inline CanvasPoint canvasPoint(int16_t x, int16_t y) {
+    CanvasPoint point;
+    point.x = x << 8;
+    point.y = y << 8;
+    return point;
+}
+
+void clearCanvas(LEDCanvas* canvas, uint16_t background = 0);
+int drawShaderCanvas(LEDCanvas* canvas, CanvasShader shader, const void* context, LEDBlend mode);
+int drawGradientCanvas(LEDCanvas* canvas, CanvasPoint from, CanvasPoint to, uint16_t fromLevel, uint16_t toLevel,
+    LEDBlend mode = LEDBlend::BLEND_ALPHA);
+int drawLineCanvas(LEDCanvas* canvas, CanvasPoint from, CanvasPoint to, int16_t width, uint16_t level,
+    LEDBlend mode = LEDBlend::BLEND_MAX);
+int drawRadialCanvas(LEDCanvas* canvas, CanvasPoint centre, int16_t radius, uint16_t innerLevel, uint16_t outerLevel,
+    LEDBlend mode = LEDBlend::BLEND_ALPHA);
+int drawPlasmaCanvas(LEDCanvas* canvas, int16_t wavelength, uint8_t phase, uint16_t lowLevel, uint16_t highLevel,
+    LEDBlend mode = LEDBlend::BLEND_ALPHA);
+void renderCanvasLED(const LEDCanvas* canvas);
+
+#ifdef DEBUG
+void benchmarkCanvasLED();
+#endif
+
+#endif
@@ -0,0 +1,235 @@
+#include <Arduino.h>
+
+#include "led.hpp"
+#include "led_compositor.hpp"
+#include "render_profiler.hpp"
+
+const ledInd_t WIPE_EDGE        = 8; // Width of the soft edge of a wipe (LEDs)
+const ledInd_t DISSOLVE_EDGE    = 4; // Number of LEDs changing over together during a dissolve
+
+/**
+ * \brief Order LEDs change over in during a dissolve, shuffled by the compiler
+ */
+struct DissolveOrder {
+    uint8_t rank[NUM_LED];
+
+    constexpr DissolveOrder() : rank() {
+        for (ledInd_t i = 0; i < NUM_LED; i++) rank[i] = i;
+
+        // Fisher-Yates shuffle using a fixed LCG so the order is the same every build
+        uint32_t seed = 0x2545F491UL;
+        for (ledInd_t i = NUM_LED - 1; i > 0; i--) {
+            seed = (seed * 1664525UL) + 1013904223UL;
+            ledInd_t j = (seed >> 16) % (i + 1);
+            uint8_t temp = rank[i];
+            rank[i] = rank[j];
+            rank[j] = temp;
+        }
+    }
+};
+
+constexpr DissolveOrder DISSOLVE_ORDER; // Stays in flash
+
+/**
+ * \brief Finds how far an LED is through a blend that sweeps across the LEDs in order
+ * 
+ * \param progress Progress of the blend (Q8)
+ * \param position Place of the LED in the order of the sweep
+ * \param edge Number of LEDs the edge of the sweep is spread across
+ * \return Blend of the LED (Q8)
+ */
+inline int16_t sweepWeight(uint16_t progress, ledInd_t position, ledInd_t edge) {
+    // The edge starts just before the first LED and finishes just past the last one
+    int32_t weight = (((int32_t)progress * (NUM_LED + edge)) - ((int32_t)position << 8)) / edge;
+    if (weight < 0) return 0;
+    if (weight > 256) return 256;
+    return weight;
+}
+
+/**
+ * \brief Reads the level of an LED in a frame, including its fraction (Q8 gamma levels)
+ */
+inline int32_t frameLevel(const LEDFrame* frame, ledInd_t ind) {
+    return ((int32_t)frame->gamma[ind] << 8) | frame->fraction[ind];
+}
+
+/**
+ * \brief Records a level (Q8 gamma levels) to an LED in a frame
+ */
+inline void storeLevel(LEDFrame* frame, ledInd_t ind, int32_t level) {
+    frame->gamma[ind] = level >> 8;
+    frame->fraction[ind] = level & 0xFF;
+}
+
+/**
+ * \brief Inverts a level (Q8 gamma levels), like is done when showing the LEDs inverted
+ */
+inline int32_t invertLevel(int32_t level) {
+    const int32_t MAX_LEVEL = (NUM_GAMMA - 1) << 8;
+    if (level >= MAX_LEVEL) return 0;
+    return MAX_LEVEL - level;
+}
+
+/**
+ * \brief Blends two frames part way through a transition from one to the other
+ * 
+ * \param from Frame being transitioned away from
+ * \param fromInverted If the outgoing frame is to be shown inverted
+ * \param to Frame being transitioned to
+ * \param toInverted If the incoming frame is to be shown inverted
+ * \param out Frame to record the blend to, left unrotated and to be shown uninverted
+ * \param kind Kind of transition
+ * \param progress How far through the transition it is (Q8, 0 to 256)
+ * 
+ * \note Only a handful of integer operations per LED, it is cheap next to rendering the effects themselves
+ */
+void blendTransitionLED(const LEDFrame* from, bool fromInverted, const LEDFrame* to, bool toInverted, 
+        LEDFrame* out, LEDTransition kind, uint16_t progress) {
+    if (progress > 256) progress = 256;
+
+    // Rotating clockwise shows each LED the level from behind it
+    ledInd_t fromSource = constrainIndex(-from->rotation);
+    ledInd_t toSource = constrainIndex(-to->rotation);
+
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        int32_t fromLevel = frameLevel(from, fromSource);
+        int32_t toLevel = frameLevel(to, toSource);
+        if (fromInverted) fromLevel = invertLevel(fromLevel);
+        if (toInverted) toLevel = invertLevel(toLevel);
+
+        int16_t weight;
+        switch (kind) {
+        case LEDTransition::FADE:
+            weight = progress;
+            break;
+        case LEDTransition::WIPE:
+            weight = sweepWeight(progress, i, WIPE_EDGE);
+            break;
+        case LEDTransition::DISSOLVE:
+            weight = sweepWeight(progress, DISSOLVE_ORDER.rank[i], DISSOLVE_EDGE);
+            break;
+        default: // Cut
+            weight = 256;
+            break;
+        }
+
+        storeLevel(out, i, fromLevel + (((toLevel - fromLevel) * weight) >> 8));
+
+        fromSource++;
+        if (fromSource == NUM_LED) fromSource = 0;
+        toSource++;
+        if (toSource == NUM_LED) toSource = 0;
+    }
+
+    out->rotation = 0;
+}
+
+/**
+ * \brief Blends a layer's level onto the level below it
+ * 
+ * \param below Level of everything below the layer (Q8 gamma levels)
+ * \param level Level of the layer (Q8 gamma levels)
+ * \param mode How the levels combine
+ * \param opacity Opacity of the layer (Q8)
+ * \return Resulting level (Q8 gamma levels)
+ */
+inline int32_t blendLevel(int32_t below, int32_t level, LEDBlend mode, uint16_t opacity) {
+    const int32_t MAX_LEVEL = (NUM_GAMMA - 1) << 8;
+
+    int32_t combined;
+    switch (mode) {
+    case LEDBlend::BLEND_ADD:
+        combined = below + level;
+        if (combined > MAX_LEVEL) combined = MAX_LEVEL;
+        break;
+    case LEDBlend::BLEND_MAX:
+        combined = (level > below) ? level : below;
+        break;
+    case LEDBlend::BLEND_MULTIPLY:
+        if (level > MAX_LEVEL) level = MAX_LEVEL;
+        combined = (below * level) / MAX_LEVEL;
+        break;
+    default: // Alpha
+        combined = level;
+        break;
+    }
+
+    return below + (((combined - below) * opacity) >> 8);
+}
+
+/**
+ * \brief Composites layers of frames on top of a base frame
+ * 
+ * \param base Bottom frame
+ * \param baseInverted If the bottom frame is to be shown inverted
+ * \param layers Layers to place over the base, from the bottom up
+ * \param num Number of layers, at most `MAX_LED_LAYERS - 1`
+ * \param out Frame to record the result to, left unrotated and to be shown uninverted
+ * 
+ * \note Done in one pass over the LEDs regardless of the number of layers
+ */
+void compositeLayersLED(const LEDFrame* base, bool baseInverted, const LEDLayerView layers[], uint8_t num, 
+        LEDFrame* out) {
+    if (num > (MAX_LED_LAYERS - 1)) num = MAX_LED_LAYERS - 1;
+
+    // Rotating clockwise shows each LED the level from behind it
+    ledInd_t baseSource = constrainIndex(-base->rotation);
+    ledInd_t sources[MAX_LED_LAYERS - 1];
+    for (uint_fast8_t l = 0; l < num; l++) sources[l] = constrainIndex(-layers[l].frame->rotation);
+
+    for (ledInd_t i = 0; i < NUM_LED; i++) {
+        int32_t level = frameLevel(base, baseSource);
+        if (baseInverted) level = invertLevel(level);
+
+        for (uint_fast8_t l = 0; l < num; l++) {
+            level = blendLevel(level, frameLevel(layers[l].frame, sources[l]), layers[l].mode, layers[l].opacity);
+
+            sources[l]++;
+            if (sources[l] == NUM_LED) sources[l] = 0;
+        }
+
+        storeLevel(out, i, level);
+
+        baseSource++;
+        if (baseSource == NUM_LED) baseSource = 0;
+    }
+
+    out->rotation = 0;
+}
+
+#ifdef DEBUG
+/**
+ * \brief Measures and prints the time taken to composite each number of layers
+ * 
+ * \note Counts the FSM's effect as a layer, so one layer is a plain copy through the kernel
+ */
+void benchmarkCompositeLED() {
+    const unsigned int RUNS = 200;
+
+    static LEDFrame frames[MAX_LED_LAYERS];
+    static LEDFrame out;
+    for (uint_fast8_t f = 0; f < MAX_LED_LAYERS; f++) {
+        for (ledInd_t i = 0; i < NUM_LED; i++) frames[f].gamma[i] = (i * (f + 1)) % NUM_GAMMA;
+        frames[f].rotation = f;
+    }
+
+    // Uses a mix of the blend modes, they cost about the same
+    LEDLayerView layers[MAX_LED_LAYERS - 1];
+    for (uint_fast8_t l = 0; l < (MAX_LED_LAYERS - 1); l++) {
+        layers[l].frame = &frames[l + 1];
+        layers[l].mode = (LEDBlend)(l % LEDBlend::NUM_BLENDS);
+        layers[l].opacity = 192;
+    }
+
+    SerialUSB.println("LED COMPOSITE TIME (layers, us per frame)");
+    for (uint_fast8_t num = 1; num <= MAX_LED_LAYERS; num++) {
+        float frameUS = timeRunsUS(RUNS, [&](unsigned int) {
+            compositeLayersLED(&frames[0], false, layers, num - 1, &out);
+        });
+
+        SerialUSB.print(num);
+        SerialUSB.print("\t");
+        SerialUSB.println(frameUS);
+    }
+}
+#endif
@@ -0,0 +1,38 @@
+#ifndef LED_COMPOSITOR_HEADER
+#define LED_COMPOSITOR_HEADER
+
+#include <Arduino.h>
+
+#include "led.hpp"
+
+/* LED frame compositing
+
+    Combines LED frames drawn by separate effects into the frame that
+    gets shown. Used by the LED FSM to blend between the outgoing and
+    incoming effects when changing states, so both can keep running
+    while one replaces the other rather than snapping across, and to
+    stack layers of effects on top of each other.
+
+    Each source frame's rotation (and inversion, if asked for) is taken
+    into account while reading it, the output frame is unrotated. All
+    blending is done in fixed point with eight fractional bits (Q8), a
+    full blend being 256. Levels are blended with their fractions (also
+    Q8), so blends land between the gamma levels rather than stepping.
+*/
+
+struct LEDLayerView {
+    const LEDFrame* frame = nullptr;
+    LEDBlend mode = LEDBlend::BLEND_ALPHA;
+    uint16_t opacity = 256;             // Q8, 256 being opaque
+};
+
+void blendTransitionLED(const LEDFrame* from, bool fromInverted, const LEDFrame* to, bool toInverted, 
+    LEDFrame* out, LEDTransition kind, uint16_t progress);
+void compositeLayersLED(const LEDFrame* base, bool baseInverted, const LEDLayerView layers[], uint8_t num, 
+    LEDFrame* out);
+
+#ifdef DEBUG
+void benchmarkCompositeLED();
+#endif
+
+#endif
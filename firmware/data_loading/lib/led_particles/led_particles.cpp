@@ -0,0 +1,145 @@
+#include <Arduino.h>
+
+#include "led.hpp"
+#include "led_particles.hpp"
+#include "render_profiler.hpp"
+
+const unsigned long MAX_PARTICLE_STEP_MS = 1000; // Longest time moved in one step, keeps the position maths in range
+
+/**
+ * \brief Moves particles on by the time passed, ageing them
+ * 
+ * \param particles Particles to move
+ * \param num Number of particles
+ * \param elapsedMS Time passed since they were last moved (ms)
+ * \param length Number of LEDs in the line they are on
+ * \param wrap If the line wraps around (like the perimeter), otherwise particles stop at its ends
+ */
+void stepParticlesLED(LEDParticle particles[], uint8_t num, unsigned long elapsedMS, ledInd_t length, bool wrap) {
+    const int32_t SPAN = (int32_t)length << 16;
+    if (elapsedMS > MAX_PARTICLE_STEP_MS) elapsedMS = MAX_PARTICLE_STEP_MS;
+
+    for (uint_fast8_t p = 0; p < num; p++) {
+        LEDParticle& particle = particles[p];
+        if (particle.lifeMS == 0) continue;
+
+        // Particles that run out of motion part way through only move for what was left, then settle on an LED
+        unsigned long movingMS = elapsedMS;
+        bool stopping = false;
+        if (particle.moveMS != PARTICLE_FOREVER) {
+            if (particle.moveMS <= elapsedMS) {
+                movingMS = particle.moveMS;
+                stopping = true;
+            }
+            else particle.moveMS = particle.moveMS - elapsedMS;
+        }
+
+        particle.position = particle.position + (particle.velocity * (int32_t)movingMS);
+        if (stopping) {
+            particle.moveMS = 0;
+            particle.velocity = 0;
+            particle.position = (int32_t)particleIndex(&particle) << 16;
+        }
+
+        if (wrap) {
+            if ((particle.position < 0) || (particle.position >= SPAN)) {
+                particle.position = particle.position % SPAN;
+                if (particle.position < 0) particle.position = particle.position + SPAN;
+            }
+        }
+        else {
+            // Kept to positions that are still shown on the line
+            if (particle.position < -0x8000) particle.position = -0x8000;
+            if (particle.position > (SPAN - 0x8001)) particle.position = SPAN - 0x8001;
+        }
+
+        if (particle.lifeMS != PARTICLE_FOREVER) {
+            if (particle.lifeMS > elapsedMS) particle.lifeMS = particle.lifeMS - elapsedMS;
+            else particle.lifeMS = 0;
+        }
+    }
+}
+
+/**
+ * \brief Combines a particle's level with the level below it
+ */
+inline void combineLevel(ledlevel_t* below, ledlevel_t level, LEDBlend mode) {
+    if (mode == LEDBlend::BLEND_ADD) {
+        uint16_t sum = *below + level;
+        *below = (sum > (NUM_GAMMA - 1)) ? (NUM_GAMMA - 1) : sum;
+    }
+    else if (level > *below) *below = level;
+}
+
+/**
+ * \brief Draws particles over a line of levels
+ * 
+ * \param particles Particles to draw, those not in use are skipped
+ * \param num Number of particles
+ * \param levels Levels of the line to draw over, already holding the background
+ * \param length Number of LEDs in the line
+ * \param wrap If the line wraps around (like the perimeter), otherwise profiles are cut off at its ends
+ * \param mode How particles combine with what is below them, `BLEND_ADD` or `BLEND_MAX`
+ */
+void renderParticlesLED(const LEDParticle particles[], uint8_t num, ledlevel_t levels[], ledInd_t length, bool wrap,
+        LEDBlend mode) {
+    for (uint_fast8_t p = 0; p < num; p++) {
+        const LEDParticle& particle = particles[p];
+        if ((particle.lifeMS == 0) || (particle.width == 0)) continue;
+
+        ledInd_t centre = particleIndex(&particle);
+        if (centre >= length) centre = 0; // Only the very end of a wrapped line rounds up past it
+        combineLevel(&levels[centre], particle.profile[0], mode);
+
+        // Spread out both ways from the centre
+        int16_t ahead = centre; // Wider than an index since they can run well past the ends of a line
+        int16_t behind = centre;
+        for (uint_fast8_t d = 1; d < particle.width; d++) {
+            ahead++;
+            behind--;
+            if (wrap) {
+                if (ahead == length) ahead = 0;
+                if (behind < 0) behind = length - 1;
+            }
+            else if ((ahead >= length) && (behind < 0)) break;
+
+            if (ahead < length) combineLevel(&levels[ahead], particle.profile[d], mode);
+            if (behind >= 0) combineLevel(&levels[behind], particle.profile[d], mode);
+        }
+    }
+}
+
+#ifdef DEBUG
+/**
+ * \brief Measures and prints the time taken to move and draw different numbers of particles on the perimeter
+ */
+void benchmarkParticlesLED() {
+    const unsigned int RUNS = 200;
+    const uint8_t COUNTS[] = {3, 16, 64};
+    static const ledlevel_t PROFILE[] = {NUM_GAMMA, 55, 35, 20};
+
+    static LEDParticle particles[64];
+    static ledlevel_t levels[NUM_LED];
+    for (uint_fast8_t p = 0; p < 64; p++) {
+        particles[p].position = (int32_t)(p % NUM_LED) << 16;
+        particles[p].velocity = particleSpeed(1, 10 + p);
+        if ((p % 2) == 0) particles[p].velocity = -particles[p].velocity;
+        particles[p].lifeMS = PARTICLE_FOREVER;
+        particles[p].profile = PROFILE;
+        particles[p].width = sizeof(PROFILE) / sizeof(PROFILE[0]);
+    }
+
+    SerialUSB.println("LED PARTICLE TIME (particles, us per frame)");
+    for (uint_fast8_t c = 0; c < (sizeof(COUNTS) / sizeof(COUNTS[0])); c++) {
+        float frameUS = timeRunsUS(RUNS, [&](unsigned int) {
+            for (ledInd_t i = 0; i < NUM_LED; i++) levels[i] = 10;
+            stepParticlesLED(particles, COUNTS[c], 5, NUM_LED, true);
+            renderParticlesLED(particles, COUNTS[c], levels, NUM_LED, true, LEDBlend::BLEND_MAX);
+        });
+
+        SerialUSB.print(COUNTS[c]);
+        SerialUSB.print("\t");
+        SerialUSB.println(frameUS);
+    }
+}
+#endif
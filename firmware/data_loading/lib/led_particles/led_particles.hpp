@@ -0,0 +1,49 @@
+#ifndef LED_PARTICLES_HEADER
+#define LED_PARTICLES_HEADER
+
+#include <Arduino.h>
+
+#include "led.hpp"
+
+/* LED particle engine
+
+    Moves and draws sets of `LEDParticle` along a line of LED levels,
+    like the perimeter (`LEDgamma`) or the rows or columns given to
+    `paintRows` and `paintColumns`. Lines either wrap around, like the
+    perimeter, or end, in which case particles stop at the ends.
+
+    Drawing goes particle by particle spreading each profile out from
+    its centre, combining with what is already there by the largest
+    level (so the nearest particle wins where they overlap) or by adding
+    them. The cost is the number of particles times their profile width,
+    however close together they are.
+*/
+
+/**
+ * \brief Finds the velocity to cover a distance in a given time
+ * 
+ * \param leds Distance to cover (LEDs)
+ * \param periodMS Time to cover it in (ms)
+ * \return Velocity (Q16 LEDs per ms)
+ */
+inline int32_t particleSpeed(ledInd_t leds, unsigned long periodMS) {
+    if (periodMS == 0) periodMS = 1;
+    return ((int32_t)leds << 16) / (int32_t)periodMS;
+}
+
+/**
+ * \brief Finds the LED a particle is shown on, the nearest to it
+ */
+inline ledInd_t particleIndex(const LEDParticle* particle) {
+    return (particle->position + 0x8000) >> 16;
+}
+
+void stepParticlesLED(LEDParticle particles[], uint8_t num, unsigned long elapsedMS, ledInd_t length, bool wrap);
+void renderParticlesLED(const LEDParticle particles[], uint8_t num, ledlevel_t levels[], ledInd_t length, bool wrap,
+    LEDBlend mode);
+
+#ifdef DEBUG
+void benchmarkParticlesLED();
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+#include <Arduino.h>
+
+#include "led_random.hpp"
+
+uint32_t EFFECT_SEED_STATE = 0x2545F491UL; // Sequence generators are seeded from, never zero
+
+/**
+ * \brief Steps a xorshift32 sequence
+ * 
+ * \param state State of the sequence, must not be zero
+ * \return The new value
+ */
+inline uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * \brief Sets the sequence new generators are seeded from
+ * 
+ * \param seed Seed to use, the same seed gives the same effects
+ * 
+ * \note Only affects generators constructed (effects started) afterwards
+ */
+void seedEffectRandom(uint32_t seed) {
+    EFFECT_SEED_STATE = (seed != 0) ? seed : 0x2545F491UL;
+}
+
+/**
+ * \brief Construct a new EffectRandom object, seeded from the shared sequence
+ */
+EffectRandom::EffectRandom() {
+    seed(xorshift32(&EFFECT_SEED_STATE));
+}
+
+/**
+ * \brief Restarts the generator from a seed
+ * 
+ * \param value Seed to use, zero is replaced since xorshift would be stuck there
+ */
+void EffectRandom::seed(uint32_t value) {
+    state = (value != 0) ? value : 0x2545F491UL;
+}
+
+/**
+ * \brief Draws the next 32 bit number
+ */
+uint32_t EffectRandom::next() {
+    return xorshift32(&state);
+}
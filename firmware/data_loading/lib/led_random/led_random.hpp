@@ -0,0 +1,89 @@
+#ifndef LED_RANDOM_HEADER
+#define LED_RANDOM_HEADER
+
+#include <Arduino.h>
+
+/* Random numbers for LED effects
+
+    Each effect that needs random numbers keeps its own small generator
+    (xorshift32) in its state, so effects don't disturb each other and
+    a step costs a few shifts and XORs rather than a call to `random()`.
+    Generators take their seed from a shared sequence when constructed,
+    which is fixed by `seedEffectRandom` (`initializeLED` seeds it with a
+    constant), so with the same seed effects play out the same way every
+    time (useful for comparing changes and the render profiler's timings).
+
+    Drawing several different indices (like LEDs to change in a step) is
+    done with a partial Fisher-Yates shuffle over an order of the indices
+    kept between steps. Each draw takes the next place in the order and
+    swaps a random later index into it, so draws are always unique and
+    take a fixed time rather than retrying until they miss the others.
+*/
+
+void seedEffectRandom(uint32_t seed);
+
+class EffectRandom {
+private:
+    uint32_t state;
+
+public:
+    EffectRandom();
+
+    void seed(uint32_t value);
+    uint32_t next();
+
+    /**
+     * \brief Draws a number from 0 up to (but not including) a limit
+     * 
+     * \note Scaled by a multiply rather than a division, the bias is negligible for limits this small
+     */
+    uint16_t below(uint16_t limit) {
+        return ((next() >> 16) * limit) >> 16;
+    }
+
+    /**
+     * \brief Rolls for something happening with a given likelihood
+     * 
+     * \param probability Likelihood out of 256
+     */
+    bool chance(uint8_t probability) {
+        return (next() >> 24) < probability;
+    }
+};
+
+template<uint8_t N> class RandomOrder {
+private:
+    uint8_t order[N];
+    uint8_t drawn = 0;                  // Places of the order used since `begin`
+
+public:
+    RandomOrder() {
+        for (uint_fast8_t i = 0; i < N; i++) order[i] = i;
+    }
+
+    /**
+     * \brief Starts a new set of draws, any index can come up again
+     */
+    void begin() {
+        drawn = 0;
+    }
+
+    /**
+     * \brief Draws an index (0 to N - 1) not yet drawn since `begin`
+     * 
+     * \param random Generator to draw with
+     * \return The index, or N if every index has been drawn
+     */
+    uint8_t next(EffectRandom* random) {
+        if (drawn >= N) return N;
+
+        uint8_t swap = drawn + random->below(N - drawn);
+        uint8_t index = order[swap];
+        order[swap] = order[drawn];
+        order[drawn] = index;
+        drawn++;
+        return index;
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include <Arduino.h>
+
+#include "i2c_bus.hpp"
+#include "register_shadow.hpp"
+
+const int SHADOW_TRANSFER_FAIL = -1;
+const int SHADOW_TRANSFER_SUCCESS = 0;
+
+bool RegisterShadow::test(const uint32_t* set, uint_fast8_t reg) {
+    return (set[reg / 32] & (1UL << (reg % 32))) != 0;
+}
+
+void RegisterShadow::assign(uint32_t* set, uint_fast8_t reg, bool state) {
+    if (state) set[reg / 32] |= (1UL << (reg % 32));
+    else set[reg / 32] &= ~(1UL << (reg % 32));
+}
+
+/**
+ * \brief Adds a range of registers to be handled by the shadow
+ * 
+ * \param first First register of the range
+ * \param last Last register of the range (inclusive)
+ */
+void RegisterShadow::track(uint8_t first, uint8_t last) {
+    for (uint_fast8_t reg = first; (reg <= last) && (reg < SIZE); reg++) assign(tracked, reg, true);
+}
+
+/**
+ * \brief Checks if a register is handled by the shadow
+ */
+bool RegisterShadow::tracks(uint8_t reg) {
+    return (reg < SIZE) && test(tracked, reg);
+}
+
+/**
+ * \brief Stages a new value for a register, only marking it to be written if it differs from the hardware
+ * 
+ * \param reg Register to update, must be tracked
+ * \param val New value
+ */
+void RegisterShadow::stage(uint8_t reg, uint8_t val) {
+    if (!tracks(reg)) return;
+
+    if (test(known, reg) && (values[reg] == val)) {
+        assign(dirty, reg, false); // Staging back to the hardware value cancels a pending write
+        return;
+    }
+    values[reg] = val;
+    assign(dirty, reg, true);
+}
+
+/**
+ * \brief Records a register value known to be in the hardware (for example read back from it)
+ * 
+ * \param reg Register the value is for, must be tracked
+ * \param val Value in the hardware
+ */
+void RegisterShadow::setKnown(uint8_t reg, uint8_t val) {
+    if (!tracks(reg)) return;
+
+    values[reg] = val;
+    assign(known, reg, true);
+    assign(dirty, reg, false);
+}
+
+/**
+ * \brief Returns the staged or last known value of a register
+ */
+uint8_t RegisterShadow::get(uint8_t reg) {
+    if (reg >= SIZE) return 0;
+    return values[reg];
+}
+
+/**
+ * \brief Checks if there are any staged values yet to be written
+ */
+bool RegisterShadow::pending() {
+    for (uint_fast8_t i = 0; i < WORDS; i++) {
+        if (dirty[i] != 0) return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Finds the next range of registers to write
+ * 
+ * \param from Register to start searching from
+ * \param first Location to record the first register of the run
+ * \param last Location to record the last register of the run (inclusive)
+ * 
+ * \note Runs include known registers between staged ones when that saves a transaction
+ * \return If a run was found
+ */
+bool RegisterShadow::nextRun(uint8_t from, uint8_t* first, uint8_t* last) {
+    uint_fast8_t reg = from;
+    while ((reg < SIZE) && !test(dirty, reg)) reg++;
+    if (reg >= SIZE) return false;
+
+    uint_fast8_t end = reg;
+    uint_fast8_t scan = reg + 1;
+    while ((scan < SIZE) && ((scan - reg) < MAX_RUN)) {
+        if (test(dirty, scan)) end = scan;
+        else if (!test(known, scan) || ((scan - end) > MERGE_GAP)) break;
+        scan++;
+    }
+
+    *first = reg;
+    *last = end;
+    return true;
+}
+
+/**
+ * \brief Records a run of registers as written to the hardware
+ */
+void RegisterShadow::markWritten(uint8_t first, uint8_t last) {
+    for (uint_fast8_t reg = first; reg <= last; reg++) {
+        assign(known, reg, true);
+        assign(dirty, reg, false);
+    }
+}
+
+/**
+ * \brief Records a run of registers as having failed to write, leaving them to be written again
+ */
+void RegisterShadow::markFailed(uint8_t first, uint8_t last) {
+    for (uint_fast8_t reg = first; reg <= last; reg++) {
+        assign(known, reg, false);
+        assign(dirty, reg, true);
+    }
+}
+
+/**
+ * \brief Writes all staged values to the device
+ * 
+ * \param bus Manager of the bus the device is on
+ * \param device Index of the device on the bus
+ * \param priority Priority of the writes
+ * \param written Location to record the number of registers written, can be null
+ * \return Return status of the transfers
+ */
+int RegisterShadow::flush(I2CBusManager* bus, uint8_t device, PriorityI2C priority, uint_fast8_t* written) {
+    int result = SHADOW_TRANSFER_SUCCESS;
+    uint_fast8_t count = 0;
+    uint8_t first = 0;
+    uint8_t last = 0;
+    uint8_t data[MAX_RUN + 1];
+
+    uint_fast8_t from = 0;
+    while ((from < SIZE) && nextRun(from, &first, &last)) {
+        // Sequential write starting at the first register
+        uint_fast8_t len = 0;
+        data[len++] = first;
+        for (uint_fast8_t reg = first; reg <= last; reg++) data[len++] = values[reg];
+
+        if (bus->write(device, data, len, priority) == I2C_BUS_SUCCESS) {
+            markWritten(first, last);
+            count = count + len - 1;
+        }
+        else {
+            markFailed(first, last);
+            result = SHADOW_TRANSFER_FAIL;
+        }
+        from = last + 1;
+    }
+
+    if (written != nullptr) *written = count;
+    return result;
+}
+
+/**
+ * \brief Forgets what is in the hardware, everything previously known is written again on the next flush
+ * 
+ * \note Use when the device may have been reset or lost power
+ */
+void RegisterShadow::invalidate() {
+    for (uint_fast8_t i = 0; i < WORDS; i++) {
+        dirty[i] |= known[i];
+        known[i] = 0;
+    }
+}
+
+/**
+ * \brief Records all tracked registers as holding the same value, such as after a reset to defaults
+ * 
+ * \param val Value of all the registers
+ */
+void RegisterShadow::reset(uint8_t val) {
+    for (uint_fast8_t reg = 0; reg < SIZE; reg++) {
+        if (test(tracked, reg)) values[reg] = val;
+    }
+    for (uint_fast8_t i = 0; i < WORDS; i++) {
+        known[i] = tracked[i];
+        dirty[i] = 0;
+    }
+}
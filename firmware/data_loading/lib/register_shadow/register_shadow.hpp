@@ -0,0 +1,61 @@
+#ifndef REGISTER_SHADOW_HEADER
+#define REGISTER_SHADOW_HEADER
+
+#include <Arduino.h>
+
+#include "i2c_bus.hpp"
+
+/* Shadow copy of a device's configuration registers
+
+    Tracks the last value known to be in each of a device's writable
+    configuration registers so writes that wouldn't change anything can
+    be skipped. New values are staged first and then flushed, with staged
+    registers that are close together sent as a single sequential write.
+    Short runs of unchanged (but known) registers between them are
+    rewritten with their known value when that is cheaper than starting
+    another transaction.
+
+    Only registers that hold what was last written to them should be
+    tracked. Registers that are modified by the device, trigger actions,
+    or are read only must be written directly by the device.
+
+    Covers register addresses 0x00 to 0x7F.
+*/
+
+extern const int SHADOW_TRANSFER_FAIL;
+extern const int SHADOW_TRANSFER_SUCCESS;
+
+class RegisterShadow {
+private:
+    static const uint_fast8_t SIZE = 128;
+    static const uint_fast8_t WORDS = SIZE / 32;
+    static const uint_fast8_t MERGE_GAP = 3;    // Known registers worth rewriting to join two runs (about a transaction's overhead)
+    static const uint_fast8_t MAX_RUN = 48;     // Most registers sent in one write
+
+    uint8_t values[SIZE] = {0};     // Staged or last known value of each register
+    uint32_t tracked[WORDS] = {0};  // Registers handled by the shadow
+    uint32_t known[WORDS] = {0};    // Registers whose hardware value matches `values`
+    uint32_t dirty[WORDS] = {0};    // Registers with a staged value yet to be written
+
+    static bool test(const uint32_t* set, uint_fast8_t reg);
+    static void assign(uint32_t* set, uint_fast8_t reg, bool state);
+
+public:
+    void track(uint8_t first, uint8_t last);
+    bool tracks(uint8_t reg);
+
+    void stage(uint8_t reg, uint8_t val);
+    void setKnown(uint8_t reg, uint8_t val);
+    uint8_t get(uint8_t reg);
+    bool pending();
+
+    bool nextRun(uint8_t from, uint8_t* first, uint8_t* last);
+    void markWritten(uint8_t first, uint8_t last);
+    void markFailed(uint8_t first, uint8_t last);
+    int flush(I2CBusManager* bus, uint8_t device, PriorityI2C priority, uint_fast8_t* written = nullptr);
+
+    void invalidate();
+    void reset(uint8_t val);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include <Arduino.h>
+
+#include "render_profiler.hpp"
+
+#ifdef RENDER_PROFILER
+
+const char* PROFILE_STAGE_NAMES[] = {"FSM", "TRANSITION", "COMPOSITE", "REMAP", "QUEUE DUTIES"};
+
+struct ProfileStats {
+    unsigned long count = 0;
+    uint64_t totalUS = 0;               // Wide enough to never overflow between dumps
+    unsigned long minUS = 0xFFFFFFFFUL;
+    unsigned long maxUS = 0;
+    unsigned long bucket[NUM_PROFILE_BUCKETS] = {0}; // Times in powers of two of microseconds
+};
+
+ProfileStats profileStats[NUM_PROFILE_STAGES + 1]; // The extra one takes the measurements of the overhead
+
+/**
+ * \brief Finds the histogram bucket of a time, the number of bits it takes
+ */
+inline uint_fast8_t profileBucket(unsigned long elapsedUS) {
+    uint_fast8_t bucket = 0;
+    while ((elapsedUS != 0) && (bucket < (NUM_PROFILE_BUCKETS - 1))) {
+        elapsedUS >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * \brief Records the time a stage took
+ * 
+ * \param stage Stage timed, a `ProfileStage` or an effect's state
+ * \param elapsedUS Time it took
+ */
+void recordProfile(uint8_t stage, unsigned long elapsedUS) {
+    if (stage > NUM_PROFILE_STAGES) return;
+    ProfileStats& stats = profileStats[stage];
+
+    stats.count++;
+    stats.totalUS = stats.totalUS + elapsedUS;
+    if (elapsedUS < stats.minUS) stats.minUS = elapsedUS;
+    if (elapsedUS > stats.maxUS) stats.maxUS = elapsedUS;
+    stats.bucket[profileBucket(elapsedUS)]++;
+}
+
+/**
+ * \brief Measures the time taken by a measurement of nothing, what every measurement adds
+ * 
+ * \return Average overhead (us)
+ */
+float measureProfileOverhead() {
+    const unsigned int RUNS = 100;
+
+    // Recorded past the last stage so the statistics printed are left alone, otherwise the same work
+    return timeRunsUS(RUNS, [](unsigned int) {
+        PROFILE_START(empty);
+        PROFILE_END(empty, NUM_PROFILE_STAGES);
+    });
+}
+
+/**
+ * \brief Prints the statistics and histogram of each stage that was timed
+ */
+void printProfile() {
+    SerialUSB.print("RENDER PROFILE (stage, count, min us, average us, max us, histogram from <1 us in powers of 2)");
+    SerialUSB.print("\tOVERHEAD US ");
+    SerialUSB.println(measureProfileOverhead());
+
+    for (uint_fast8_t s = 0; s < NUM_PROFILE_STAGES; s++) {
+        const ProfileStats& stats = profileStats[s];
+        if (stats.count == 0) continue;
+
+        if (s < PROFILE_FSM) {
+            SerialUSB.print("STATE ");
+            SerialUSB.print(s);
+        }
+        else SerialUSB.print(PROFILE_STAGE_NAMES[s - PROFILE_FSM]);
+        SerialUSB.print("\t");
+        SerialUSB.print(stats.count);
+        SerialUSB.print("\t");
+        SerialUSB.print(stats.minUS);
+        SerialUSB.print("\t");
+        SerialUSB.print((float)stats.totalUS / stats.count);
+        SerialUSB.print("\t");
+        SerialUSB.print(stats.maxUS);
+
+        // Trailing empty buckets are left off
+        uint_fast8_t last = NUM_PROFILE_BUCKETS;
+        while ((last > 0) && (stats.bucket[last - 1] == 0)) last--;
+        for (uint_fast8_t b = 0; b < last; b++) {
+            SerialUSB.print((b == 0) ? "\t" : " ");
+            SerialUSB.print(stats.bucket[b]);
+        }
+        SerialUSB.println();
+    }
+}
+
+/**
+ * \brief Clears the statistics of every stage
+ */
+void resetProfile() {
+    for (uint_fast8_t s = 0; s <= NUM_PROFILE_STAGES; s++) profileStats[s] = ProfileStats();
+}
+
+#endif
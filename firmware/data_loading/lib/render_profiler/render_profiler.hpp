@@ -0,0 +1,93 @@
+#ifndef RENDER_PROFILER_HEADER
+#define RENDER_PROFILER_HEADER
+
+#include <Arduino.h>
+
+#include "led.hpp"
+
+/* Render profiler
+
+    Times each stage of getting a frame of LEDs out: the render of each
+    effect (by state, layers included), blending transitions, compositing
+    layers, the whole LED FSM, converting to duties and queueing them to
+    the drivers. Each stage keeps the count, minimum, average and
+    maximum time taken along with a histogram of the times in powers of
+    two of microseconds, bucket 0 holding times under 1 us, bucket 1 of
+    1 us, bucket 2 of 2 to 3 us, bucket 3 of 4 to 7 us and so on, the
+    last bucket taking everything longer.
+
+    Only built with `RENDER_PROFILER` defined (done for the testing
+    environment), otherwise the timing macros are empty and the profiler
+    takes no RAM or time at all. When built it takes about 90 bytes of
+    RAM per stage, and each measurement two reads of the microsecond
+    timer and a few dozen instructions to record (a couple of us all
+    told, the dump prints what it measures on the board). The RP2040's
+    cores have no cycle counter, so times are to the microsecond.
+
+    The DEBUG benchmarks of the LED libraries time their runs with
+    `timeRunsUS` from here too, it is built with either `DEBUG` or
+    `RENDER_PROFILER` defined.
+*/
+
+enum ProfileStage : uint8_t {
+    PROFILE_FSM = ledFSMstates::NUM_LED_STATES, // Stages before this are the renders of each effect, by state
+    PROFILE_TRANSITION,                 // Blending the effects together during a transition
+    PROFILE_COMPOSITE,                  // Compositing layers over the FSM's effect
+    PROFILE_REMAP,                      // Converting the shown frame into driver duties
+    PROFILE_QUEUE_DUTIES,               // Queueing the duties to the drivers
+    NUM_PROFILE_STAGES
+};
+
+#ifdef RENDER_PROFILER
+
+constexpr uint8_t NUM_PROFILE_BUCKETS = 16; // Histogram buckets, the last holding anything from 16 ms up
+
+void recordProfile(uint8_t stage, unsigned long elapsedUS);
+void printProfile();
+void resetProfile();
+
+// Times the code between a start and end of the same name as a stage
+#define PROFILE_START(name) unsigned long name##ProfileUS = micros()
+#define PROFILE_END(name, stage) recordProfile((stage), micros() - name##ProfileUS)
+
+#else
+
+#define PROFILE_START(name)
+#define PROFILE_END(name, stage)
+
+#endif
+
+#if defined(DEBUG) || defined(RENDER_PROFILER)
+#include <Watchdog.h>
+
+constexpr unsigned int PROFILE_BATCH_RUNS = 10; // Runs timed between kicks of the watchdog
+
+/**
+ * \brief Times repeated runs of some code, for benchmarks
+ * 
+ * \param runs Number of times to run it
+ * \param run Code to run, called with the number of the run (from 0)
+ * 
+ * \note Runs are timed in batches with the watchdog kicked between them, so a batch must take well under
+ *      the watchdog timeout but there can be any number of runs
+ * \return Average time of a run (us)
+ */
+template <typename Run> float timeRunsUS(unsigned int runs, Run run) {
+    unsigned long elapsedUS = 0;
+    unsigned int r = 0;
+    while (r < runs) {
+        mbed::Watchdog::get_instance().kick();
+
+        unsigned int end = ((runs - r) > PROFILE_BATCH_RUNS) ? (r + PROFILE_BATCH_RUNS) : runs;
+        unsigned long start = micros();
+        for (; r < end; r++) run(r);
+        elapsedUS = elapsedUS + (micros() - start);
+    }
+
+    if (runs == 0) return 0.0;
+    return (float)elapsedUS / runs;
+}
+
+#endif
+
+#endif
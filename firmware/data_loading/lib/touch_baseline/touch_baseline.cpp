@@ -0,0 +1,187 @@
+#include <Arduino.h>
+
+#include "cap1206.hpp"
+#include "touch_baseline.hpp"
+
+const int TOUCH_BASELINE_FAIL = -1;
+const int TOUCH_BASELINE_SUCCESS = 0;
+
+const unsigned long BASELINE_SAMPLE_PERIOD  =  250UL; // Default period between delta samples (ms)
+const unsigned long BASELINE_TOUCH_HOLDOFF  = 1000UL; // Time after a touch before sampling again, lets the pad settle (ms)
+
+const uint_fast8_t BASELINE_DRIFT_SHIFT     = 3; // Drift filter weight of 1/8, follows over about 2 s of samples
+const uint_fast8_t BASELINE_NOISE_SHIFT     = 4; // Noise filter weight of 1/16
+const uint8_t BASELINE_SETTLE_SAMPLES       = 16; // Samples after calibrating before the filters are trusted
+const uint_fast8_t BASELINE_DRIFT_FRACTION  = 3; // Recalibrate when the drift exceeds this fraction of the threshold
+
+const uint_fast8_t BASELINE_TUNE_SAMPLES    = 40; // Samples between threshold updates
+const uint8_t BASELINE_THRESHOLD_MIN        = 40; // Threshold for a pad with no noise
+const uint8_t BASELINE_NOISE_GAIN           = 6;  // Threshold added per count of noise
+const uint8_t BASELINE_THRESHOLD_HYSTERESIS = 4;  // Smallest change worth writing
+
+/**
+ * \brief Construct a new TouchBaseline object
+ * 
+ * \param cap Sensor to track, must be initialized before updating
+ */
+TouchBaseline::TouchBaseline(Cap1206* cap) {
+    sensor = cap;
+    samplePeriodMS = BASELINE_SAMPLE_PERIOD;
+}
+
+/**
+ * \brief Sets how often the deltas are sampled while the pads are untouched
+ * 
+ * \param periodMS Period between samples (ms), longer follows drift more slowly but uses the bus less
+ */
+void TouchBaseline::setSamplePeriod(unsigned long periodMS) {
+    samplePeriodMS = periodMS;
+}
+
+/**
+ * \brief Samples the pad deltas when it is time, recalibrating pads that drifted
+ * 
+ * \param pads Bit mask of pads currently reported touched, no sampling is done while touched
+ * \note Call after every touch poll
+ * \return Return status of any transfers made
+ */
+int TouchBaseline::update(uint8_t pads) {
+    unsigned long now = millis();
+
+    if ((pads & ((1 << NUM_PADS) - 1)) != 0) {
+        lastTouchMS = now;
+        return TOUCH_BASELINE_SUCCESS;
+    }
+    if ((now - lastTouchMS) < BASELINE_TOUCH_HOLDOFF) return TOUCH_BASELINE_SUCCESS;
+    if ((long)(now - nextSampleMS) < 0) return TOUCH_BASELINE_SUCCESS;
+    nextSampleMS = now + samplePeriodMS;
+
+    int8_t deltas[6];
+    if (sensor->readDeltas(deltas) == CAP1206_TRANSFER_FAIL) return TOUCH_BASELINE_FAIL;
+
+    uint8_t recalibrate = 0;
+    for (uint_fast8_t i = 0; i < NUM_PADS; i++) {
+        uint8_t threshold = sensor->getButtonThreshold(i);
+
+        // A finger close to the pad but not yet reported would throw off the drift
+        if (deltas[i] >= (threshold / 2)) continue;
+
+        int16_t value = deltas[i] * 16;
+        if (samples[i] == 0) drift[i] = value; // Start the filter where the pad is rather than at zero
+        drift[i] = drift[i] + ((value - drift[i]) >> BASELINE_DRIFT_SHIFT);
+
+        int16_t deviation = abs(value - drift[i]);
+        noise[i] = noise[i] + ((deviation - (int16_t)noise[i]) >> BASELINE_NOISE_SHIFT);
+
+        if (samples[i] < 255) samples[i]++;
+        if (samples[i] < BASELINE_SETTLE_SAMPLES) continue;
+
+        if (abs(drift[i]) > ((threshold * 16) / BASELINE_DRIFT_FRACTION)) recalibrate |= 1 << i;
+    }
+
+    if (recalibrate != 0) {
+        if (sensor->setCalibrations(recalibrate) == CAP1206_TRANSFER_FAIL) return TOUCH_BASELINE_FAIL;
+
+        // The noise carries over, it belongs to the pad rather than the calibration
+        for (uint_fast8_t i = 0; i < NUM_PADS; i++) {
+            if ((recalibrate & (1 << i)) == 0) continue;
+            drift[i] = 0;
+            samples[i] = 0;
+            recalibrations[i]++;
+        }
+    }
+
+    samplesSinceTune++;
+    if (samplesSinceTune < BASELINE_TUNE_SAMPLES) return TOUCH_BASELINE_SUCCESS;
+    samplesSinceTune = 0;
+    return tuneThresholds();
+}
+
+/**
+ * \brief Finds the touch threshold suited to the measured noise of a pad
+ * 
+ * \param pad Index of the pad
+ * \return Threshold for the pad (delta counts)
+ */
+uint8_t TouchBaseline::suggestedThreshold(uint8_t pad) {
+    if (pad >= NUM_PADS) return 127;
+
+    uint16_t threshold = BASELINE_THRESHOLD_MIN + (((uint32_t)noise[pad] * BASELINE_NOISE_GAIN) >> 4);
+    if (threshold > 127) threshold = 127;
+    return threshold;
+}
+
+/**
+ * \brief Sets the thresholds of the settled pads from their noise
+ * 
+ * \note Small changes are ignored so the thresholds don't wander with every update
+ * \return Return status of the transfer
+ */
+int TouchBaseline::tuneThresholds() {
+    uint8_t thresholds[6];
+    bool changed = false;
+
+    for (uint_fast8_t i = 0; i < 6; i++) {
+        thresholds[i] = sensor->getButtonThreshold(i);
+        if ((i >= NUM_PADS) || (samples[i] < BASELINE_SETTLE_SAMPLES)) continue;
+
+        uint8_t suggested = suggestedThreshold(i);
+        if (abs(suggested - thresholds[i]) < BASELINE_THRESHOLD_HYSTERESIS) continue;
+        thresholds[i] = suggested;
+        changed = true;
+    }
+
+    if (!changed) return TOUCH_BASELINE_SUCCESS;
+    if (sensor->setButtonThresholds(thresholds) == CAP1206_TRANSFER_FAIL) return TOUCH_BASELINE_FAIL;
+    return TOUCH_BASELINE_SUCCESS;
+}
+
+/**
+ * \brief Returns the filtered delta of an untouched pad
+ * 
+ * \param pad Index of the pad
+ * \return Drift from the calibrated base count (Q4 delta counts)
+ */
+int16_t TouchBaseline::getDrift(uint8_t pad) {
+    if (pad >= NUM_PADS) return 0;
+    return drift[pad];
+}
+
+/**
+ * \brief Returns the average deviation of an untouched pad's delta from its drift
+ * 
+ * \param pad Index of the pad
+ * \return Noise of the pad (Q4 delta counts)
+ */
+uint16_t TouchBaseline::getNoise(uint8_t pad) {
+    if (pad >= NUM_PADS) return 0;
+    return noise[pad];
+}
+
+/**
+ * \brief Returns the number of times a pad was recalibrated for drifting
+ * 
+ * \param pad Index of the pad
+ */
+unsigned long TouchBaseline::getRecalibrations(uint8_t pad) {
+    if (pad >= NUM_PADS) return 0;
+    return recalibrations[pad];
+}
+
+/**
+ * \brief Prints the drift, noise, threshold and recalibrations of each pad
+ */
+void TouchBaseline::printStatistics() {
+    SerialUSB.println("TOUCH BASELINE (pad, drift, noise, threshold, recalibrations)");
+    for (uint_fast8_t i = 0; i < NUM_PADS; i++) {
+        SerialUSB.print(i);
+        SerialUSB.print("\t");
+        SerialUSB.print(drift[i] / 16.0);
+        SerialUSB.print("\t");
+        SerialUSB.print(noise[i] / 16.0);
+        SerialUSB.print("\t");
+        SerialUSB.print(sensor->getButtonThreshold(i));
+        SerialUSB.print("\t");
+        SerialUSB.println(recalibrations[i]);
+    }
+}
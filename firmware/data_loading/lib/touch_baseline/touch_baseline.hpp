@@ -0,0 +1,65 @@
+#ifndef TOUCH_BASELINE_HEADER
+#define TOUCH_BASELINE_HEADER
+
+#include <Arduino.h>
+
+#include "cap1206.hpp"
+
+/* Baseline drift tracking for the CAP1206 pads
+
+    The CAP1206 measures touches as the delta of each pad's count from a
+    base count found when it is calibrated. Temperature, humidity and
+    the like slowly move the untouched count away from the base, which
+    shows up as a delta that creeps away from zero.
+
+    While no pads are touched the deltas are sampled at a low rate (4 Hz
+    unless set otherwise with `setSamplePeriod`) and filtered per pad to
+    follow this drift. Each sample is a blocking read of the deltas, so
+    it is bus traffic even while nothing is touched. Only a pad whose drift grows
+    past a fraction of its touch threshold is recalibrated, the others
+    are left alone and keep sensing.
+
+    The spread of the deltas around the drift is also tracked as a
+    measure of each pad's noise, which sets its touch threshold so noisy
+    pads need a firmer touch and quiet ones stay sensitive.
+
+    Values are kept in fixed point with four fractional bits (Q4).
+*/
+
+extern const int TOUCH_BASELINE_FAIL;
+extern const int TOUCH_BASELINE_SUCCESS;
+
+class TouchBaseline {
+public:
+    static const uint_fast8_t NUM_PADS = 4;
+
+private:
+    Cap1206* sensor;
+
+    int16_t drift[NUM_PADS] = {0};          // Filtered delta of each untouched pad (Q4)
+    uint16_t noise[NUM_PADS] = {0};         // Filtered absolute deviation of the delta from the drift (Q4)
+    uint8_t samples[NUM_PADS] = {0};        // Samples since the pad was last calibrated (saturates)
+    unsigned long recalibrations[NUM_PADS] = {0};
+
+    unsigned long lastTouchMS = 0;
+    unsigned long nextSampleMS = 0;
+    unsigned long samplePeriodMS;
+    uint_fast8_t samplesSinceTune = 0;
+
+    int tuneThresholds();
+
+public:
+    TouchBaseline(Cap1206* cap);
+
+    void setSamplePeriod(unsigned long periodMS);
+    int update(uint8_t pads);
+    uint8_t suggestedThreshold(uint8_t pad);
+
+    int16_t getDrift(uint8_t pad);
+    uint16_t getNoise(uint8_t pad);
+    unsigned long getRecalibrations(uint8_t pad);
+
+    void printStatistics();
+};
+
+#endif
@@ -4,33 +4,89 @@
 
 #include "audio.hpp"
 #include "enumerators.h"
+#include "gesture.hpp"
+#include "i2c_bus.hpp"
 #include "is31fl3236.hpp"
+#include "is31fl3236_group.hpp"
 #include "cap1206.hpp"
 #include "led.hpp"
+#include "led_animation.hpp"
+#include "led_canvas.hpp"
+#include "led_compositor.hpp"
+#include "led_particles.hpp"
+#include "render_profiler.hpp"
+#include "touch_baseline.hpp"
 
 // Duration for watchdog timer, must be sufficient for entire setup (specified in milliseconds)
 const u_int32_t WATCHDOG_TIMEOUT = 100; 
 
-// Period of inactivity (ms) to trigger recalibration on capacitance sensor
-const unsigned long TOUCH_RECALIBRATION_PERIOD  = 10000UL; 
 const unsigned long TOUCH_CHECK_PERIOD          =    10UL;  // Minimum period to poll the touch sensor (ms)
+const unsigned long TOUCH_ALERT_BASELINE_PERIOD =  5000UL;  // Period of baseline samples with the ALERT pin (ms)
+// With the ALERT pin these baseline samples are the only touch traffic while nothing is touched
 // Touch check period should be at most half the cycle time set for the CAP1206 
 
+// Pin connected to the ALERT output of the CAP1206, boards without it connected (-1) poll the sensor instead
+// Revision 1 boards have it on GPIO 21 (set through the build flags)
+#ifndef TOUCH_ALERT_PIN
+#define TOUCH_ALERT_PIN -1
+#endif
+
+const unsigned long DRIVER_RECOVERY_PERIOD      =    20UL;  // Minimum period between attempts to reinitialize a faulty LED driver (ms)
+
+#ifdef DEBUG
+const unsigned long BUS_REPORT_PERIOD           = 10000UL;  // Period to report I2C bus occupancy (ms)
+#endif
+
 const pin_size_t statusLED[] = {17, 18, 19}; // Status LEDs by index (last one is red)
-const pin_size_t button[] = {20, 21}; // User buttons by index
+// User buttons by index, revision 1 boards give GPIO 21 over to the touch sensor's ALERT output
+#if TOUCH_ALERT_PIN == 21
+const pin_size_t button[] = {20};
+#else
+const pin_size_t button[] = {20, 21};
+#endif
+const int NUM_BUTTONS = sizeof(button) / sizeof(button[0]);
 
-TwoWire i2cBus(12, 13);
+TwoWire i2cWire(12, 13);
+I2CBusManager i2cBus(&i2cWire, i2c0); // All bus traffic goes through here, must use the peripheral of `i2cWire`
 
 IS31FL3236 drivers[] = {
     IS31FL3236(0x3C, 15, &i2cBus),
     IS31FL3236(0x3F, 16, &i2cBus)
 };
+IS31FL3236Group driverGroup(drivers, 2, &i2cBus); // Shows frames on both drivers at once
 
-Cap1206 touch(&i2cBus);
+Cap1206 touch(&i2cBus, TOUCH_ALERT_PIN);
+GestureEngine gestures(LEDbutton, TOUCH_CHECK_PERIOD * 1000UL); // Pads are in the same order as `LEDbutton`
+TouchBaseline touchBaseline(&touch); // Recalibrates pads as they drift, sets their thresholds from their noise
 
 // Variables for audio processing
 double left[64], right[64], leftRMS, rightRMS;
 
+/**
+ * \brief Kicks the watchdog, for blocking work during set up
+ */
+void kickWatchdog() {
+    mbed::Watchdog::get_instance().kick();
+}
+
+#ifdef DEBUG
+/**
+ * \brief Runs the LED benchmarks, printing their results
+ * 
+ * \note Takes a while, the benchmarks kick the watchdog as they go
+ */
+void benchmarkLED() {
+    benchmarkCompositeLED(); // Cost of compositing 1 to 4 LED layers
+    kickWatchdog();
+    benchmarkParticlesLED(); // Cost of moving and drawing 3 to 64 particles
+    kickWatchdog();
+    benchmarkCanvasLED(); // Cost of drawing and rendering canvases of 1 to 8 shapes
+    kickWatchdog();
+    benchmarkAnimationLED(); // Cost of decoding an animation frame
+    kickWatchdog();
+}
+#endif
+
 void setup() {
     // Immediately start watchdog in the event there's any glitch
     mbed::Watchdog &watchdog = mbed::Watchdog::get_instance();
@@ -39,7 +95,7 @@ void setup() {
     bool badSetup = false; // Tracks if there was any failed configuration
 
     // Start with LED and button initialization to show system is live before potentially waiting for Serial
-    for (int i = 0; i < 2; i++) pinMode(button[i], INPUT_PULLUP);
+    for (int i = 0; i < NUM_BUTTONS; i++) pinMode(button[i], INPUT_PULLUP);
     for (int i = 0; i < 3; i++) {
         pinMode(statusLED[i], OUTPUT);
         digitalWrite(statusLED[i], HIGH);
@@ -62,16 +118,21 @@ void setup() {
         badSetup = true;
     }
 
+    if (i2cBus.initialize(400000, kickWatchdog) == I2C_BUS_SUCCESS) SerialUSB.println("I2C BUS CONFIGURED SUCCESSFULLY");
+    else {
+        SerialUSB.println("I2C BUS CONFIGURE ERROR");
+        badSetup = true;
+    }
+
     initializeLED(drivers);
     for (int i = 0; i < 2; i++) {
         SerialUSB.print("LED DRIVER ");
         SerialUSB.print(i);
         if (drivers[i].initialize() == IS31_TRANSFER_SUCCESS) SerialUSB.println(" CONFIGURED SUCCESSFULLY");
-        else {
-            SerialUSB.println(" CONFIGURE ERROR");
-            badSetup = true;
-        }
+        else SerialUSB.println(" CONFIGURE ERROR, WILL RETRY"); // Not worth a reboot, it is reinitialized in the loop
+        watchdog.kick();
     }
+    driverGroup.initialize();
     
     bool touchSuccess = touch.initialize() == CAP1206_TRANSFER_SUCCESS;
     if (touchSuccess) SerialUSB.println("TOUCH SENSOR CONFIGURED SUCCESSFULLY");
@@ -79,6 +140,8 @@ void setup() {
         SerialUSB.println("TOUCH SENSOR CONFIGURE ERROR");
         badSetup = true;
     }
+    if (touch.alertEnabled()) touchBaseline.setSamplePeriod(TOUCH_ALERT_BASELINE_PERIOD); // Keep the idle bus quiet
+    watchdog.kick();
 
     // Reboot if any configuration failed
     if (badSetup == true) {
@@ -89,6 +152,13 @@ void setup() {
         }
     }
 
+#ifdef DEBUG
+    SerialUSB.println("SEND 'b' TO RUN THE LED BENCHMARKS");
+#endif
+#ifdef RENDER_PROFILER
+    SerialUSB.println("SEND 'p' TO PRINT THE RENDER PROFILE, 'r' TO RESET IT");
+#endif
+
     SerialUSB.println("\nLAUNCHING!\n");
     for (int i = 0; i < 3; i++) digitalWrite(statusLED[i], LOW);
 
@@ -99,34 +169,148 @@ void loop() {
     static AudioProcessing sampleAudio = AudioProcessing::NO_AUDIO;
 
     // Check pads
-    uint8_t pads = 0; // Bit mask of pressed pads
+    uint8_t pads = 0; // Bit mask of pads reported touched by the sensor
+    uint8_t buttons = 0; // Bit mask of pad actions for the LED FSM, from gestures
+    static uint8_t touchPads = 0; // Target for the asynchronous touch reads
+    static uint8_t heldPads = 0; // Pads touched as of the last successful read
+    static bool touchInFlight = false; // Marks if a touch read is in progress
     static unsigned long nextTouchPoll = 0; // Marks next touch sensor polling
-    // Polling would not be needed if the alert/interrupt pin from the CAP1206 was connected to the RP2040
+    bool touchUpdate = false; // Marks if the pads were updated this loop
+
+    // Collect completed touch reads, these are started on a previous loop (or by the ALERT pin) and finish in the background
+    if (touch.serviceAlert(&pads)) {
+        heldPads = pads;
+        touchUpdate = true;
+    }
+    if (touchInFlight && !touch.asyncBusy()) {
+        touchInFlight = false;
+        if (touch.asyncStatus() == CAP1206_TRANSFER_SUCCESS) {
+            pads = touchPads;
+            heldPads = pads;
+            touchUpdate = true;
+        }
+    }
 
-    if (millis() > nextTouchPoll) {
+    // With the ALERT pin touches start reads themselves, the sensor only needs polling while pads are held
+    // Otherwise it is polled all the time
+    // The idle updates are local (no bus), apart from the baseline sampling the deltas every few seconds
+    if (!touchInFlight && (millis() > nextTouchPoll)) {
         nextTouchPoll = millis() + TOUCH_CHECK_PERIOD;
+        if (!touch.alertEnabled() || (heldPads != 0)) 
+            touchInFlight = touch.readSensorsAsync(&touchPads) == CAP1206_TRANSFER_SUCCESS;
+        else touchUpdate = true; // Nothing touched, but gestures still need to see time pass
+    }
 
-        static unsigned long nextTouchRecalibration = 0;
-        touch.readSensors(&pads);
+    if (touchUpdate) {
+        gestures.update(pads);
+        touchBaseline.update(pads); // Occasionally samples the untouched pads
+    }
 
-        // Check if the periodic recalibration is needed if not catching touches
-        if (pads != 0) nextTouchRecalibration = millis() + TOUCH_RECALIBRATION_PERIOD;
-        if (millis() > nextTouchRecalibration) {
-            touch.setCalibrations(0x0F);
-            nextTouchRecalibration = millis() + TOUCH_RECALIBRATION_PERIOD;
+    // Turn a gesture into pad actions, one per loop
+    // Taps and held pads act as the pad, swipes move between states
+    // Double taps have no action of their own so they aren't enabled, taps then act as soon as the pad is released
+    GestureEvent gesture;
+    if (gestures.pop(&gesture)) {
+        switch (gesture.type) {
+        case GestureType::SWIPE:
+            if (gesture.direction > 0) buttons = 0b0010; // Advance
+            else buttons = 0b0100; // Return
+            break;
+        default:
+            buttons = 1 << gesture.pad;
+            break;
         }
     }
 
     // Audio sampling if needed
     readAudio(left, right, &leftRMS, &rightRMS, sampleAudio);
 
-    // LED FSMs usually take about 40 to 160 us to execute, peak at about 250
-    sampleAudio = LEDfsm(pads, left, right, leftRMS, rightRMS); //, ledFSMstates::AUD_UNI, true);
+    // Timings of the FSM and each effect are kept by the render profiler when built with it (testing environment)
+    PROFILE_START(fsm);
+    sampleAudio = LEDfsm(buttons, left, right, leftRMS, rightRMS); //, ledFSMstates::AUD_UNI, true);
+    PROFILE_END(fsm, PROFILE_FSM);
+
+    // Updating entire PWM buffer takes about 1 ms per chip at 400 kHz (0.4 ms at 1 MHz), this is done in the background
+    // If the previous frame is still going this one is skipped, changes carry over to the next frame
+    // Frames are only converted when they can be sent since the dithering expects every one of them to be shown
+    // Both chips are latched together once uploaded so there's no tearing between them
+    if (!driverGroup.asyncBusy()) {
+        PROFILE_START(remap);
+        remapLED(drivers); // Gamma levels straight into the driver duties
+        PROFILE_END(remap, PROFILE_REMAP);
+
+        PROFILE_START(queue);
+        driverGroup.updateDutiesAsync();
+        PROFILE_END(queue, PROFILE_QUEUE_DUTIES);
+    }
 
-    // Updating entire PWM buffer takes about 1 ms per chip updated
-    remapLED(drivers);
-    drivers[0].updateDuties();
-    drivers[1].updateDuties();
+    // Bring back any driver that stopped responding (bus glitch, brown out) without rebooting
+    static unsigned long nextDriverRecovery = 0;
+    bool driverFault = false;
+    for (int i = 0; i < 2; i++) {
+        if (!drivers[i].needsReinitialize()) continue;
+        driverFault = true;
+
+        if (millis() > nextDriverRecovery) {
+            nextDriverRecovery = millis() + DRIVER_RECOVERY_PERIOD;
+            SerialUSB.print("LED DRIVER ");
+            SerialUSB.print(i);
+            if (drivers[i].reinitialize() == IS31_TRANSFER_SUCCESS) SerialUSB.println(" REINITIALIZED");
+            else SerialUSB.println(" REINITIALIZE ERROR");
+        }
+    }
+    digitalWrite(statusLED[2], driverFault ? HIGH : LOW); // Red LED shows a driver fault
+
+#ifdef DEBUG
+    // Report the average bus usage of each effect's frames when leaving it
+    static ledFSMstates lastState = LEDstate;
+    if (lastState != LEDstate) {
+        SerialUSB.print("STATE ");
+        SerialUSB.print(lastState);
+        SerialUSB.print(" BYTES PER FRAME:\t");
+        SerialUSB.print(drivers[0].getAverageFrameBytes());
+        SerialUSB.print("\t");
+        SerialUSB.println(drivers[1].getAverageFrameBytes());
+
+        drivers[0].resetBusStatistics();
+        drivers[1].resetBusStatistics();
+        lastState = LEDstate;
+    }
+
+    // Periodically report how the bus is shared between the devices
+    // The LED frame rate sets how quickly dithered levels average out, too low and they flicker
+    static unsigned long nextBusReport = BUS_REPORT_PERIOD;
+    static unsigned long lastCommits = 0;
+    if (millis() > nextBusReport) {
+        unsigned long commits = driverGroup.getCommitCount();
+        SerialUSB.print("LED FRAMES PER SECOND:\t");
+        SerialUSB.println((commits - lastCommits) * 1000.0 / BUS_REPORT_PERIOD);
+        lastCommits = commits;
+
+        i2cBus.printStatistics();
+        i2cBus.resetStatistics();
+        gestures.printLatency();
+        gestures.resetLatency();
+        touchBaseline.printStatistics();
+        nextBusReport = millis() + BUS_REPORT_PERIOD;
+    }
+#endif
+
+#if defined(DEBUG) || defined(RENDER_PROFILER)
+    // Commands over serial
+    // Render timings are dumped on request, 'p' to print them and 'r' to start them afresh (profiler builds)
+    // The LED benchmarks are run with 'b' (DEBUG builds), rather than holding up every boot
+    while (SerialUSB.available() > 0) {
+        int command = SerialUSB.read();
+#ifdef RENDER_PROFILER
+        if (command == 'p') printProfile();
+        else if (command == 'r') resetProfile();
+#endif
+#ifdef DEBUG
+        if (command == 'b') benchmarkLED();
+#endif
+    }
+#endif
 
     // A little heartbeat
     if (((millis() / 500) % 2) == 1) digitalWrite(statusLED[0], HIGH);
@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Encodes LED frame sequences into the compressed animation format played by `led_animation`
+
+Frames are read from a text file, one frame per line as its duration in
+milliseconds, a colon, then the gamma level (0 to 63) of each LED in
+perimeter order. Blank lines and anything after a `#` are
+ignored, so frames can be commented. For example:
+
+    # duration: levels of LEDs 0 to 71
+    40: 10 10 63 50 ...
+
+The first frame is always a keyframe (coded on its own), the others are
+coded against the frame before them unless `--key-interval` asks for
+regular keyframes. Each frame is coded in runs: LEDs left as they were,
+LEDs set to the same level and LEDs given their own levels.
+
+Writes either the raw animation (for storing as a file) or a C header
+declaring it along with a source file (the header's name ending in .cpp)
+defining it as a constant array, which the firmware keeps in flash. The
+header can be included anywhere without making another copy, the size
+is given as `<name>_SIZE`.
+
+    python3 led_animation_encoder.py animations/comet.txt --header comet.hpp --name COMET
+"""
+
+import argparse
+import sys
+
+NUM_LED = 72
+NUM_GAMMA = 64  # Gamma levels the firmware has, levels go up to one less
+
+FORMAT_MAGIC = b"LA"
+FORMAT_VERSION = 1
+FLAG_LOOP = 0x01
+FRAME_KEY = 0x01
+
+MAX_RUN = 64  # LEDs a single code can cover
+CODE_SKIP = 0x00  # LEDs left as they were in the previous frame
+CODE_RUN = 0x40  # LEDs all set to the level that follows
+CODE_LITERAL = 0x80  # LEDs each set to one of the levels that follow
+
+
+def read_frames(path):
+    """Reads (duration, levels) frames from a text file"""
+    frames = []
+    with open(path) as source:
+        for number, line in enumerate(source, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+
+            try:
+                duration, levels = line.split(":", 1)
+                duration = int(duration)
+                levels = [int(level) for level in levels.split()]
+            except ValueError:
+                sys.exit(f"{path}:{number}: expected 'duration: level level ...'")
+
+            if not 0 <= duration <= 0xFFFF:
+                sys.exit(f"{path}:{number}: duration must be 0 to 65535 ms")
+            if len(levels) != NUM_LED:
+                sys.exit(f"{path}:{number}: expected {NUM_LED} levels, found {len(levels)}")
+            if any(not 0 <= level < NUM_GAMMA for level in levels):
+                sys.exit(f"{path}:{number}: levels must be 0 to {NUM_GAMMA - 1}")
+
+            frames.append((duration, levels))
+
+    if not frames:
+        sys.exit(f"{path}: no frames")
+    if len(frames) > 0xFFFF:
+        sys.exit(f"{path}: at most 65535 frames")
+    return frames
+
+
+def run_length(levels, start, limit):
+    """Number of LEDs from `start` sharing its level, up to `limit`"""
+    end = start + 1
+    while (end < limit) and (levels[end] == levels[start]):
+        end += 1
+    return end - start
+
+
+def encode_frame(levels, previous):
+    """Codes one frame, against the previous frame's levels or on its own if there are none"""
+    codes = bytearray()
+    literal = []
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:MAX_RUN]
+            del literal[:MAX_RUN]
+            codes.append(CODE_LITERAL | (len(chunk) - 1))
+            codes.extend(chunk)
+
+    i = 0
+    while i < NUM_LED:
+        # LEDs that haven't changed are skipped
+        if previous is not None:
+            unchanged = 0
+            while ((i + unchanged) < NUM_LED) and (levels[i + unchanged] == previous[i + unchanged]):
+                unchanged += 1
+            if (unchanged >= 2) or ((unchanged == 1) and not literal):
+                flush_literal()
+                i += unchanged
+                while unchanged > 0:
+                    count = min(unchanged, MAX_RUN)
+                    codes.append(CODE_SKIP | (count - 1))
+                    unchanged -= count
+                continue
+
+        # Runs of three or more cost less than giving their levels
+        count = run_length(levels, i, min(NUM_LED, i + MAX_RUN))
+        if count >= 3:
+            flush_literal()
+            codes.append(CODE_RUN | (count - 1))
+            codes.append(levels[i])
+            i += count
+            continue
+
+        literal.append(levels[i])
+        i += 1
+
+    flush_literal()
+    return bytes(codes)
+
+
+def encode_animation(frames, loop, key_interval):
+    """Codes all the frames, with the header in front"""
+    data = bytearray(FORMAT_MAGIC)
+    data.append(FORMAT_VERSION)
+    data.append(NUM_LED)
+    data.extend(len(frames).to_bytes(2, "little"))
+    data.append(FLAG_LOOP if loop else 0)
+    data.append(0)
+
+    previous = None
+    for index, (duration, levels) in enumerate(frames):
+        key = (previous is None) or ((key_interval > 0) and ((index % key_interval) == 0))
+        data.append(FRAME_KEY if key else 0)
+        data.extend(duration.to_bytes(2, "little"))
+        data.extend(encode_frame(levels, None if key else previous))
+        previous = levels
+
+    return bytes(data)
+
+
+def write_header(path, name, data, source):
+    """Writes a C header declaring the animation and a source file defining it as a constant array"""
+    guard = f"{name}_HEADER"
+    note = f"// Generated by led_animation_encoder.py from {source}, edit that and regenerate instead\n"
+    with open(path, "w") as header:
+        header.write(f"#ifndef {guard}\n#define {guard}\n\n#include <Arduino.h>\n\n")
+        header.write(note)
+        header.write(f"extern const uint8_t {name}[];\n")
+        header.write(f"extern const uint32_t {name}_SIZE;\n\n#endif\n")
+
+    # Defined once here, the declarations in the header give it external linkage
+    with open(path.rsplit(".", 1)[0] + ".cpp", "w") as definition:
+        definition.write(f"#include <Arduino.h>\n\n#include \"{path.replace(chr(92), '/').split('/')[-1]}\"\n\n")
+        definition.write(note)
+        definition.write(f"const uint8_t {name}[] = {{\n")
+        for start in range(0, len(data), 16):
+            row = ", ".join(f"0x{byte:02X}" for byte in data[start:start + 16])
+            definition.write(f"    {row},\n")
+        definition.write(f"}};\n\nconst uint32_t {name}_SIZE = sizeof({name});\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n", 1)[0])
+    parser.add_argument("frames", help="text file of frames to encode")
+    parser.add_argument("--output", help="raw animation file to write")
+    parser.add_argument("--header", help="C header to declare the animation in, defined in a .cpp of the same name")
+    parser.add_argument("--name", default="ANIMATION", help="name of the array in the header")
+    parser.add_argument("--once", action="store_true", help="play once and hold the last frame rather than loop")
+    parser.add_argument("--key-interval", type=int, default=0,
+                        help="frames between keyframes, 0 for only the first")
+    args = parser.parse_args()
+
+    if not (args.output or args.header):
+        parser.error("give --output and/or --header")
+
+    frames = read_frames(args.frames)
+    data = encode_animation(frames, not args.once, args.key_interval)
+
+    if args.output:
+        with open(args.output, "wb") as output:
+            output.write(data)
+    if args.header:
+        write_header(args.header, args.name, data, args.frames.replace("\\", "/").split("/")[-1])
+
+    raw = len(frames) * (NUM_LED + 2)
+    print(f"{len(frames)} frames, {len(data)} bytes ({100.0 * len(data) / raw:.1f}% of uncompressed)")
+
+
+if __name__ == "__main__":
+    main()